@@ -0,0 +1,319 @@
+#ifndef BLOCK_POOL_H
+#define BLOCK_POOL_H
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Blocks are carved from chunks of this many bytes
+#define POOL_CHUNK_SIZE (256 * 1024)
+// Smallest block, every block is a power of two at least this large
+#define POOL_MIN_BLOCK 16
+// Blocks larger than this go straight to operator new
+#define POOL_MAX_BLOCK (16 * 1024)
+// Bytes of one size class a thread takes from or gives back to the
+// shared pool at once, it keeps at most twice as many
+#define POOL_CACHE_BYTES (8 * 1024)
+
+// Power of two size classes bump allocated from large chunks. Freed
+// blocks are kept on a free list per class and reused by the next
+// allocation of that class, memory goes back only when the pool dies.
+// The pool allocator reaches the shared pool through a cache per
+// thread, which locks it once per batch of blocks.
+class BlockPool
+{
+private:
+    static constexpr int CLASS_COUNT = 16;
+
+    // Freed block, the link is stored in the block itself
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+
+    // Free lists of one thread, left to the shared pool when the thread
+    // ends (trivially destructible, still readable after that)
+    struct ThreadCache
+    {
+        FreeBlock *freeLists[CLASS_COUNT];
+        size_t freeBytes[CLASS_COUNT];
+        bool isClosed;
+    };
+
+    struct ThreadCacheCloser
+    {
+        ~ThreadCacheCloser();
+    };
+
+    std::mutex mutex;
+    FreeBlock *freeLists[CLASS_COUNT];
+    std::vector<char *> chunks;
+    char *chunkCursor;
+    size_t chunkRemaining;
+
+    static int SizeClass(size_t bytes);
+    // Next block of the class, the lock is held
+    void *TakeBlock(int sizeClass);
+    static ThreadCache &LocalCache();
+
+public:
+    BlockPool();
+    ~BlockPool();
+    BlockPool(const BlockPool &) = delete;
+    BlockPool &operator=(const BlockPool &) = delete;
+
+    void *Allocate(size_t bytes);
+    void Deallocate(void *block, size_t bytes);
+    // Bytes taken from operator new for the chunks
+    size_t ReservedBytes();
+    // Bytes an allocation of the given size actually occupies
+    static size_t BlockBytes(size_t bytes);
+
+    // Pool of the graph topology, shared by every graph
+    static BlockPool &Shared();
+    // Allocation from the shared pool through the cache of the calling
+    // thread, a block may be freed by another thread
+    static void *AllocateLocal(size_t bytes);
+    static void DeallocateLocal(void *block, size_t bytes);
+};
+
+inline BlockPool::BlockPool()
+    : chunkCursor(NULL), chunkRemaining(0)
+{
+    for (int i = 0; i < CLASS_COUNT; i++)
+        freeLists[i] = NULL;
+}
+
+inline BlockPool::~BlockPool()
+{
+    for (size_t i = 0; i < chunks.size(); i++)
+        ::operator delete(chunks[i]);
+}
+
+inline int BlockPool::SizeClass(size_t bytes)
+{
+    int sizeClass = 0;
+    size_t blockSize = POOL_MIN_BLOCK;
+    while (blockSize < bytes)
+    {
+        blockSize <<= 1;
+        sizeClass++;
+    }
+    return sizeClass;
+}
+
+inline void *BlockPool::Allocate(size_t bytes)
+{
+    if (bytes > POOL_MAX_BLOCK)
+        return ::operator new(bytes);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return TakeBlock(SizeClass(bytes));
+}
+
+inline void *BlockPool::TakeBlock(int sizeClass)
+{
+    size_t blockSize = static_cast<size_t>(POOL_MIN_BLOCK) << sizeClass;
+    if (freeLists[sizeClass])
+    {
+        FreeBlock *block = freeLists[sizeClass];
+        freeLists[sizeClass] = block->next;
+        return block;
+    }
+
+    // The rest of a chunk is dropped, at most POOL_MAX_BLOCK bytes
+    if (chunkRemaining < blockSize)
+    {
+        chunkCursor = static_cast<char *>(::operator new(POOL_CHUNK_SIZE));
+        chunkRemaining = POOL_CHUNK_SIZE;
+        chunks.push_back(chunkCursor);
+    }
+
+    void *block = chunkCursor;
+    chunkCursor += blockSize;
+    chunkRemaining -= blockSize;
+    return block;
+}
+
+inline void BlockPool::Deallocate(void *block, size_t bytes)
+{
+    if (bytes > POOL_MAX_BLOCK)
+    {
+        ::operator delete(block);
+        return;
+    }
+
+    int sizeClass = SizeClass(bytes);
+    FreeBlock *freeBlock = static_cast<FreeBlock *>(block);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    freeBlock->next = freeLists[sizeClass];
+    freeLists[sizeClass] = freeBlock;
+}
+
+inline size_t BlockPool::ReservedBytes()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return chunks.size() * POOL_CHUNK_SIZE;
+}
+
+inline size_t BlockPool::BlockBytes(size_t bytes)
+{
+    if (bytes > POOL_MAX_BLOCK)
+        return bytes;
+    return static_cast<size_t>(POOL_MIN_BLOCK) << SizeClass(bytes);
+}
+
+inline BlockPool &BlockPool::Shared()
+{
+    // Never destroyed, containers of static graphs may outlive it
+    static BlockPool *pool = new BlockPool();
+    return *pool;
+}
+
+inline BlockPool::ThreadCache &BlockPool::LocalCache()
+{
+    static thread_local ThreadCache cache = {};
+    static thread_local ThreadCacheCloser closer;
+    (void)closer;
+    return cache;
+}
+
+inline BlockPool::ThreadCacheCloser::~ThreadCacheCloser()
+{
+    ThreadCache &cache = LocalCache();
+    BlockPool &pool = Shared();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    for (int c = 0; c < CLASS_COUNT; c++)
+    {
+        while (cache.freeLists[c])
+        {
+            FreeBlock *block = cache.freeLists[c];
+            cache.freeLists[c] = block->next;
+            block->next = pool.freeLists[c];
+            pool.freeLists[c] = block;
+        }
+        cache.freeBytes[c] = 0;
+    }
+    // Containers freed later by this thread (static graphs) go to the
+    // shared pool directly
+    cache.isClosed = true;
+}
+
+inline void *BlockPool::AllocateLocal(size_t bytes)
+{
+    if (bytes > POOL_MAX_BLOCK)
+        return ::operator new(bytes);
+
+    ThreadCache &cache = LocalCache();
+    if (cache.isClosed)
+        return Shared().Allocate(bytes);
+
+    int sizeClass = SizeClass(bytes);
+    size_t blockSize = static_cast<size_t>(POOL_MIN_BLOCK) << sizeClass;
+    if (!cache.freeLists[sizeClass])
+    {
+        // One batch under one lock, the last block taken is returned
+        BlockPool &pool = Shared();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        for (size_t taken = blockSize; taken < POOL_CACHE_BYTES; taken += blockSize)
+        {
+            FreeBlock *block = static_cast<FreeBlock *>(pool.TakeBlock(sizeClass));
+            block->next = cache.freeLists[sizeClass];
+            cache.freeLists[sizeClass] = block;
+            cache.freeBytes[sizeClass] += blockSize;
+        }
+        return pool.TakeBlock(sizeClass);
+    }
+
+    FreeBlock *block = cache.freeLists[sizeClass];
+    cache.freeLists[sizeClass] = block->next;
+    cache.freeBytes[sizeClass] -= blockSize;
+    return block;
+}
+
+inline void BlockPool::DeallocateLocal(void *block, size_t bytes)
+{
+    if (bytes > POOL_MAX_BLOCK)
+    {
+        ::operator delete(block);
+        return;
+    }
+
+    ThreadCache &cache = LocalCache();
+    if (cache.isClosed)
+    {
+        Shared().Deallocate(block, bytes);
+        return;
+    }
+
+    int sizeClass = SizeClass(bytes);
+    size_t blockSize = static_cast<size_t>(POOL_MIN_BLOCK) << sizeClass;
+    FreeBlock *freeBlock = static_cast<FreeBlock *>(block);
+    freeBlock->next = cache.freeLists[sizeClass];
+    cache.freeLists[sizeClass] = freeBlock;
+    cache.freeBytes[sizeClass] += blockSize;
+    if (cache.freeBytes[sizeClass] <= 2 * POOL_CACHE_BYTES)
+        return;
+
+    // Half of the cached blocks back under one lock
+    BlockPool &pool = Shared();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    while (cache.freeBytes[sizeClass] > POOL_CACHE_BYTES)
+    {
+        freeBlock = cache.freeLists[sizeClass];
+        cache.freeLists[sizeClass] = freeBlock->next;
+        cache.freeBytes[sizeClass] -= blockSize;
+        freeBlock->next = pool.freeLists[sizeClass];
+        pool.freeLists[sizeClass] = freeBlock;
+    }
+}
+
+// Standard allocator over the shared pool, for the small per vertex
+// arrays of the topology. -DNO_BLOCK_POOL sends them to operator new,
+// to compare the two.
+template <class T>
+struct PoolAllocator
+{
+    typedef T value_type;
+
+    PoolAllocator()
+    {
+    }
+    template <class U>
+    PoolAllocator(const PoolAllocator<U> &)
+    {
+    }
+
+    T *allocate(size_t count)
+    {
+#ifdef NO_BLOCK_POOL
+        return static_cast<T *>(::operator new(count * sizeof(T)));
+#else
+        return static_cast<T *>(BlockPool::AllocateLocal(count * sizeof(T)));
+#endif
+    }
+    void deallocate(T *block, size_t count)
+    {
+#ifdef NO_BLOCK_POOL
+        ::operator delete(block);
+#else
+        BlockPool::DeallocateLocal(block, count * sizeof(T));
+#endif
+    }
+};
+
+template <class T, class U>
+inline bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &)
+{
+    return true;
+}
+
+template <class T, class U>
+inline bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &)
+{
+    return false;
+}
+
+#endif // BLOCK_POOL_H
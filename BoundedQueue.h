@@ -0,0 +1,81 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// FIFO between two pipeline stages. Push blocks while capacity items
+// are waiting, so a fast producer can not run ahead of its consumer.
+template <class T>
+class BoundedQueue
+{
+private:
+    std::mutex mutex;
+    std::condition_variable hasItems;
+    std::condition_variable hasRoom;
+    std::deque<T> items;
+    size_t capacity;
+    bool isClosed;
+
+public:
+    BoundedQueue(size_t capacity);
+
+    // Moves the item in, false when the queue is closed
+    bool Push(T &item);
+    // Blocks for the next item, false once closed and drained
+    bool Pop(T &item);
+    // No more pushes, waiting consumers drain what is left
+    void Close();
+};
+
+template <class T>
+BoundedQueue<T>::BoundedQueue(size_t capacity)
+    : capacity(capacity > 0 ? capacity : 1), isClosed(false)
+{
+}
+
+template <class T>
+bool BoundedQueue<T>::Push(T &item)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    hasRoom.wait(lock, [this]
+                 { return items.size() < capacity || isClosed; });
+    if (isClosed)
+        return false;
+
+    items.push_back(std::move(item));
+    lock.unlock();
+    hasItems.notify_one();
+    return true;
+}
+
+template <class T>
+bool BoundedQueue<T>::Pop(T &item)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    hasItems.wait(lock, [this]
+                  { return !items.empty() || isClosed; });
+    if (items.empty())
+        return false;
+
+    item = std::move(items.front());
+    items.pop_front();
+    lock.unlock();
+    hasRoom.notify_one();
+    return true;
+}
+
+template <class T>
+void BoundedQueue<T>::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isClosed = true;
+    }
+    hasItems.notify_all();
+    hasRoom.notify_all();
+}
+
+#endif // BOUNDED_QUEUE_H
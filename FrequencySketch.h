@@ -0,0 +1,105 @@
+#ifndef FREQUENCY_SKETCH_H
+#define FREQUENCY_SKETCH_H
+
+#include <vector>
+
+#define SKETCH_DEPTH 4
+#define SKETCH_MAX_COUNT 15
+// Counters are halved after this many increments per cache entry
+#define SKETCH_SAMPLE_FACTOR 10
+
+// Count-min sketch of recent access frequencies (TinyLFU). Counters
+// saturate at SKETCH_MAX_COUNT and are all halved periodically, so old
+// popularity fades out.
+class FrequencySketch
+{
+private:
+    static constexpr unsigned int SEEDS[SKETCH_DEPTH] =
+        {0x97CB3127u, 0x9E3779B1u, 0x85EBCA77u, 0xC2B2AE3Du};
+
+    std::vector<unsigned char> counters;
+    unsigned int widthMask;
+    int sampleSize;
+    int additionCount;
+
+    int CounterIndex(unsigned int hash, int row) const;
+    void Age();
+
+public:
+    FrequencySketch(int capacity);
+
+    void Increment(unsigned int hash);
+    int Frequency(unsigned int hash) const;
+    void Clear();
+    size_t MemoryBytes() const;
+};
+
+inline FrequencySketch::FrequencySketch(int capacity)
+{
+    // Power of two width, a few counters per cached entry
+    unsigned int width = 16;
+    while (width < static_cast<unsigned int>(capacity) * 4)
+        width <<= 1;
+
+    counters.assign(width * SKETCH_DEPTH, 0);
+    widthMask = width - 1;
+    sampleSize = (capacity > 0 ? capacity : 1) * SKETCH_SAMPLE_FACTOR;
+    additionCount = 0;
+}
+
+inline int FrequencySketch::CounterIndex(unsigned int hash, int row) const
+{
+    unsigned int h = (hash ^ (hash >> 16)) * SEEDS[row];
+    h ^= h >> 15;
+    return static_cast<int>(row * (widthMask + 1) + (h & widthMask));
+}
+
+inline void FrequencySketch::Increment(unsigned int hash)
+{
+    int frequency = Frequency(hash);
+    if (frequency == SKETCH_MAX_COUNT)
+        return;
+
+    // Conservative update, only the minimal counters grow
+    for (int row = 0; row < SKETCH_DEPTH; row++)
+    {
+        unsigned char &counter = counters[CounterIndex(hash, row)];
+        if (counter == frequency)
+            counter++;
+    }
+
+    if (++additionCount >= sampleSize)
+        Age();
+}
+
+inline int FrequencySketch::Frequency(unsigned int hash) const
+{
+    int frequency = SKETCH_MAX_COUNT;
+    for (int row = 0; row < SKETCH_DEPTH; row++)
+    {
+        int counter = counters[CounterIndex(hash, row)];
+        if (counter < frequency)
+            frequency = counter;
+    }
+    return frequency;
+}
+
+inline void FrequencySketch::Age()
+{
+    for (size_t i = 0; i < counters.size(); i++)
+        counters[i] >>= 1;
+    additionCount /= 2;
+}
+
+inline void FrequencySketch::Clear()
+{
+    counters.assign(counters.size(), 0);
+    additionCount = 0;
+}
+
+inline size_t FrequencySketch::MemoryBytes() const
+{
+    return counters.capacity();
+}
+
+#endif // FREQUENCY_SKETCH_H
@@ -2,57 +2,168 @@
 #define HASH_TABLE_H
 
 #include <vector>
-#include <cstdio>
 #include "IntPair.h"
 #include "Exceptions.h"
+#include "FrequencySketch.h"
+#include "output_writer.h"
 
+// Control byte of a slot: the tag (7 bits of the key hash) of an
+// occupied slot, or a mark with the high bit set. Lookups compare the
+// keys of the slots whose tag matches only.
+#define EMPTY_MARK 0x80
 // Sentinel for probing
-#define SENTINEL_MARK 0xFFFFFFFF
-#define EMPTY_MARK 0xFFFFFFFE
-#define OCCUPIED_MARK 0x00000000
+#define SENTINEL_MARK 0xFE
+#define TAG_MASK 0x7F
+// Control bytes compared at once, tables up to CONTROL_SCAN_SIZE slots
+// match every tag in one pass instead of walking the probe sequence
+#define CONTROL_GROUP 16
+#define CONTROL_SCAN_SIZE 64
 #define CAPACITY_THRESHOLD 2
+// Lookup alpha that accepts the route of any alpha of the bucket
+#define ANY_ALPHA -1.0f
+
+// Segments of the W-TinyLFU policy. New entries enter the window, its
+// LRU entry is admitted to probation only if the sketch rates it more
+// frequent than the probation LRU entry. A hit in probation promotes to
+// protected.
+#define WINDOW_SEGMENT 0
+#define PROBATION_SEGMENT 1
+#define PROTECTED_SEGMENT 2
+#define SEGMENT_COUNT 3
+#define WINDOW_PERCENT 1
+#define PROTECTED_PERCENT 80
 
 struct HashData
 {
     // Data
     std::vector<int> intArray;
-    unsigned int sentinel;
     // Key
-    bool isCostWeighted;
     int startInt;
     int endInt;
+    // Quantized alpha of the search
+    int alphaBucket;
+    // Fingerprint of the excluded edge names (0 when nothing excluded)
+    unsigned int filterFingerprint;
+    // Alphas the route is known to be shortest for, lookups of other
+    // alphas of the bucket miss it
+    float alphaFrom;
+    float alphaTo;
 
 
     int lruCounter;
+
+    // Recency list of the segment (slot indices, -1 at the ends)
+    int segment;
+    int prevSlot;
+    int nextSlot;
+};
+
+struct HashKey
+{
+    int startInt;
+    int endInt;
+    int alphaBucket;
+    unsigned int filterFingerprint;
+    // Alpha of the lookup within the bucket (ANY_ALPHA)
+    float alpha;
 };
 
 template <int MAX_SIZE>
 class HashTable
 {
 private:
-    static int PRIMES[3];
+    static unsigned int PRIMES[4];
+    static const int CONTROL_SIZE = (MAX_SIZE + CONTROL_GROUP - 1) / CONTROL_GROUP * CONTROL_GROUP;
 
+    // Padding after MAX_SIZE stays EMPTY_MARK
+    unsigned char control[CONTROL_SIZE];
     HashData table[MAX_SIZE];
     int elementCount;
 
-    static int Hash(int startInt, int endInt, bool isCostWeighted);
+    // Most recently used first (head) in every segment
+    int segmentHead[SEGMENT_COUNT];
+    int segmentTail[SEGMENT_COUNT];
+    int segmentSize[SEGMENT_COUNT];
+    int segmentCapacity[SEGMENT_COUNT];
+
+    FrequencySketch sketch;
+    int hitCount;
+    int missCount;
+    int evictionCount;
+    int rejectionCount;
+
+    static unsigned int KeyHash(int startInt, int endInt,
+                                int alphaBucket, unsigned int filterFingerprint);
+    static unsigned char Tag(unsigned int keyHash);
+    bool IsOccupied(int tableIndex) const;
+    static bool IsShortestFor(const HashData &data, float alpha);
+    // Bit i set when control byte i equals tag (first CONTROL_SCAN_SIZE)
+    unsigned long long MatchTag(unsigned char tag) const;
+    int FindIndex(int startInt, int endInt,
+                  int alphaBucket, unsigned int filterFingerprint) const;
+    int FindIndex(unsigned int keyHash, int startInt, int endInt,
+                  int alphaBucket, unsigned int filterFingerprint) const;
+
+    int Occupy(const std::vector<int> &intArray,
+               int alphaBucket, unsigned int filterFingerprint,
+               float alphaFrom, float alphaTo);
+    void Release(int tableIndex);
+    void Link(int tableIndex, int segment);
+    void Unlink(int tableIndex);
+    void Touch(int tableIndex);
+    void Rebalance();
+    int VictimSlot() const;
 
     void PrintLine(int tableIndex) const;
 
 public:
     HashTable();
-    int Insert(const std::vector<int> &intArray, bool isCostWeighted);
+    // The route is shortest for the alphas from alphaFrom to alphaTo. A
+    // key that is already present keeps its route and widens its range
+    // when the route is the same (costs are linear in alpha), and takes
+    // the new route and range otherwise.
+    int Insert(const std::vector<int> &intArray,
+               int alphaBucket, unsigned int filterFingerprint = 0,
+               float alphaFrom = 0, float alphaTo = 1);
+    // Only routes shortest for alpha are found
     bool Find(std::vector<int> &intArray,
-              int startInt, int endInt, bool isCostWeighted,
-              bool incLRU = false);
+              int startInt, int endInt,
+              int alphaBucket, unsigned int filterFingerprint = 0,
+              bool incLRU = false, float alpha = ANY_ALPHA);
+    // Find of every key, same results, statistics and recency as calling
+    // Find for them in order. Hashes and probes all keys first and
+    // prefetches the cached paths before copying them out.
+    int FindBatch(std::vector<std::vector<int>> &intArrays,
+                  std::vector<char> &isFound,
+                  const std::vector<HashKey> &keys,
+                  bool incLRU = false);
+    bool FindPrefix(std::vector<int> &intArray,
+                    int startInt, int endInt,
+                    int alphaBucket, unsigned int filterFingerprint = 0,
+                    float alpha = ANY_ALPHA) const;
     void Remove(std::vector<int> &intArray,
-                int startInt, int endInt, bool isCostWeighted);
+                int startInt, int endInt,
+                int alphaBucket, unsigned int filterFingerprint = 0);
     void RemoveLRU(int lruElementCount);
 
     void InvalidateTable();
+    void InvalidateVertices(const std::vector<int> &vertexIndices);
+    void InvalidateEdge(int vertexIndex, int edgeIndex);
+    // Removes every entry isStale(const HashData &) rates stale
+    template <class Predicate>
+    void InvalidateIf(Predicate isStale);
+    void RemapVertices(const std::vector<int> &oldToNewIndex);
+    // Path of the entry inserted and found most often, scans the slots
     void GetMostInserted(std::vector<int> &intArray) const;
     void PrintSortedLRUEntries() const;
 
+    int HitCount() const;
+    int MissCount() const;
+    float HitRate() const;
+    void PrintStatistics() const;
+    // Bytes of the slots, the cached paths and the sketch
+    size_t MemoryBytes() const;
+
     void PrintTable() const;
 };
 
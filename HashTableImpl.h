@@ -1,145 +1,488 @@
 #ifndef HASH_TABLE_HPP
 #define HASH_TABLE_HPP
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 template <int MAX_SIZE>
-int HashTable<MAX_SIZE>::PRIMES[3] = {102523, 100907, 104659};
+unsigned int HashTable<MAX_SIZE>::PRIMES[4] = {102523, 100907, 104659, 101363};
 
 template <int MAX_SIZE>
 void HashTable<MAX_SIZE>::PrintLine(int tableIndex) const
 {
     const HashData &data = table[tableIndex];
+    OutputBuffer &out = ThreadOutput();
 
-    if (data.sentinel == SENTINEL_MARK)
+    if (control[tableIndex] == SENTINEL_MARK)
     {
-        printf("[%03d]         : SENTINEL\n", tableIndex);
+        out.AppendFormat("[%03d]         : SENTINEL\n", tableIndex);
     }
-    else if (data.sentinel == EMPTY_MARK)
+    else if (control[tableIndex] == EMPTY_MARK)
     {
-        printf("[%03d]         : EMPTY\n", tableIndex);
+        out.AppendFormat("[%03d]         : EMPTY\n", tableIndex);
     }
     else
     {
-        printf("[%03d] - [%03d] : ", tableIndex, data.lruCounter);
-        printf("(%-5s) ", data.isCostWeighted ? "True" : "False");
+        out.AppendFormat("[%03d] - [%03d] : ", tableIndex, data.lruCounter);
+        // Unfiltered routes of alpha 0 or 1 only say which one, others
+        // give their whole key and alpha range
+        bool isTimeRoute = data.alphaFrom == 0 && data.alphaTo == 0;
+        bool isPriceRoute = data.alphaFrom == 1 && data.alphaTo == 1;
+        if (data.filterFingerprint == 0 && (isTimeRoute || isPriceRoute))
+            out.AppendFormat("(%-5s) ", isTimeRoute ? "True" : "False");
+        else
+            out.AppendFormat("(bucket %d, alpha %g-%g, filter %08x) ", data.alphaBucket,
+                             data.alphaFrom, data.alphaTo, data.filterFingerprint);
         size_t sz = data.intArray.size();
         for (size_t i = 0; i < sz; i++)
         {
             if (i % 2 == 0)
-                printf("[%03d]", data.intArray[i]);
+                out.AppendFormat("[%03d]", data.intArray[i]);
             else
-                printf("/%03d/", data.intArray[i]);
+                out.AppendFormat("/%03d/", data.intArray[i]);
 
             if (i != sz - 1)
-                printf("-->");
+                out.Append("-->");
         }
-        printf("\n");
+        out.Append("\n");
     }
 }
 
 template <int MAX_SIZE>
 void HashTable<MAX_SIZE>::PrintTable() const
 {
-    printf("____________________\n");
-    printf("Elements %d\n", elementCount);
-    printf("[IDX] - [LRU] | DATA\n");
-    printf("____________________\n");
+    OutputBuffer &out = ThreadOutput();
+    out.Append("____________________\n");
+    out.AppendFormat("Elements %d\n", elementCount);
+    out.Append("[IDX] - [LRU] | DATA\n");
+    out.Append("____________________\n");
     for (int i = 0; i < MAX_SIZE; i++)
     {
         PrintLine(i);
     }
+    FlushOutput();
+}
+
+template <int MAX_SIZE>
+unsigned int HashTable<MAX_SIZE>::KeyHash(int startInt, int endInt,
+                                          int alphaBucket, unsigned int filterFingerprint)
+{
+    // Unsigned arithmetic wraps instead of overflowing
+    return static_cast<unsigned int>(startInt) * PRIMES[0] +
+           static_cast<unsigned int>(endInt) * PRIMES[1] +
+           static_cast<unsigned int>(alphaBucket) * PRIMES[2] +
+           filterFingerprint * PRIMES[3];
+}
+
+template <int MAX_SIZE>
+unsigned char HashTable<MAX_SIZE>::Tag(unsigned int keyHash)
+{
+    // High bits, the slot comes from the low ones
+    return static_cast<unsigned char>((keyHash >> 25) & TAG_MASK);
+}
+
+template <int MAX_SIZE>
+bool HashTable<MAX_SIZE>::IsOccupied(int tableIndex) const
+{
+    return control[tableIndex] <= TAG_MASK;
+}
+
+template <int MAX_SIZE>
+bool HashTable<MAX_SIZE>::IsShortestFor(const HashData &data, float alpha)
+{
+    return alpha == ANY_ALPHA || (data.alphaFrom <= alpha && alpha <= data.alphaTo);
+}
+
+template <int MAX_SIZE>
+unsigned long long HashTable<MAX_SIZE>::MatchTag(unsigned char tag) const
+{
+    unsigned long long matches = 0;
+    int size = (CONTROL_SIZE < CONTROL_SCAN_SIZE) ? CONTROL_SIZE : CONTROL_SCAN_SIZE;
+#if defined(__SSE2__)
+    const __m128i tags = _mm_set1_epi8(static_cast<char>(tag));
+    for (int i = 0; i < size; i += CONTROL_GROUP)
+    {
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(control + i));
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, tags)));
+        matches |= static_cast<unsigned long long>(mask) << i;
+    }
+#else
+    for (int i = 0; i < size; i++)
+    {
+        if (control[i] == tag)
+            matches |= 1ULL << i;
+    }
+#endif
+    return matches;
 }
 
 template <int MAX_SIZE>
-int HashTable<MAX_SIZE>::Hash(int startInt, int endInt, bool isCostWeighted)
+int HashTable<MAX_SIZE>::FindIndex(int startInt, int endInt,
+                                   int alphaBucket, unsigned int filterFingerprint) const
 {
-    return startInt * PRIMES[0] + endInt * PRIMES[1] + (int)isCostWeighted * PRIMES[2];
+    return FindIndex(KeyHash(startInt, endInt, alphaBucket, filterFingerprint),
+                     startInt, endInt, alphaBucket, filterFingerprint);
+}
+
+template <int MAX_SIZE>
+int HashTable<MAX_SIZE>::FindIndex(unsigned int keyHash, int startInt, int endInt,
+                                   int alphaBucket, unsigned int filterFingerprint) const
+{
+    unsigned char tag = Tag(keyHash);
+
+    if (MAX_SIZE <= CONTROL_SCAN_SIZE)
+    {
+        // Keys are unique, the slot with the key is the one probing
+        // would reach
+        unsigned long long matches = MatchTag(tag);
+        while (matches != 0)
+        {
+#if defined(__GNUC__)
+            int new_index = __builtin_ctzll(matches);
+#else
+            int new_index = 0;
+            while (((matches >> new_index) & 1) == 0)
+                new_index++;
+#endif
+            matches &= matches - 1;
+
+            const HashData &data = table[new_index];
+            if (data.startInt == startInt && data.endInt == endInt && data.alphaBucket == alphaBucket && data.filterFingerprint == filterFingerprint)
+                return new_index;
+        }
+        return -1;
+    }
+
+    int index = static_cast<int>(keyHash % MAX_SIZE);
+    for (int i = 0; i < MAX_SIZE; i++)
+    {
+        int new_index = (index + i * i) % MAX_SIZE;
+
+        if (control[new_index] == EMPTY_MARK)
+            return -1;
+
+        if (control[new_index] == tag && table[new_index].startInt == startInt && table[new_index].endInt == endInt && table[new_index].alphaBucket == alphaBucket && table[new_index].filterFingerprint == filterFingerprint)
+            return new_index;
+    }
+
+    return -1;
 }
 
 template <int MAX_SIZE>
 HashTable<MAX_SIZE>::HashTable()
+    : sketch(MAX_SIZE / CAPACITY_THRESHOLD)
 {
-    elementCount = 0;
+    // Same element limit as before, split over the segments
+    int capacity = MAX_SIZE / CAPACITY_THRESHOLD;
+    segmentCapacity[WINDOW_SEGMENT] = capacity * WINDOW_PERCENT / 100;
+    if (segmentCapacity[WINDOW_SEGMENT] < 1)
+        segmentCapacity[WINDOW_SEGMENT] = 1;
+    int mainCapacity = capacity - segmentCapacity[WINDOW_SEGMENT];
+    segmentCapacity[PROTECTED_SEGMENT] = mainCapacity * PROTECTED_PERCENT / 100;
+    segmentCapacity[PROBATION_SEGMENT] = mainCapacity - segmentCapacity[PROTECTED_SEGMENT];
+
+    hitCount = 0;
+    missCount = 0;
+    evictionCount = 0;
+    rejectionCount = 0;
+
+    InvalidateTable();
+}
+
+template <int MAX_SIZE>
+int HashTable<MAX_SIZE>::Occupy(const std::vector<int> &intArray,
+                                int alphaBucket, unsigned int filterFingerprint,
+                                float alphaFrom, float alphaTo)
+{
+    int startInt = intArray[0];
+    int endInt = intArray[intArray.size() - 1];
+    unsigned int keyHash = KeyHash(startInt, endInt, alphaBucket, filterFingerprint);
+    int index = static_cast<int>(keyHash % MAX_SIZE);
+
     for (int i = 0; i < MAX_SIZE; i++)
     {
-        table[i].lruCounter = 0;
-        table[i].sentinel = EMPTY_MARK;
+        int new_index = (index + i * i) % MAX_SIZE;
+        if (!IsOccupied(new_index))
+        {
+            // vector deep copy (slot may hold a removed entry's path)
+            table[new_index].intArray.assign(intArray.begin(), intArray.end());
+
+            table[new_index].lruCounter = 1;
+            table[new_index].startInt = startInt;
+            table[new_index].endInt = endInt;
+            control[new_index] = Tag(keyHash);
+            table[new_index].alphaBucket = alphaBucket;
+            table[new_index].filterFingerprint = filterFingerprint;
+            table[new_index].alphaFrom = alphaFrom;
+            table[new_index].alphaTo = alphaTo;
+
+            elementCount++;
+            return new_index;
+        }
     }
+
+    throw TableCapFullException(elementCount);
 }
 
 template <int MAX_SIZE>
-int HashTable<MAX_SIZE>::Insert(const std::vector<int> &intArray, bool isCostWeighted)
+void HashTable<MAX_SIZE>::Release(int tableIndex)
 {
-    if (intArray.size() < 1)
-        throw InvalidTableArgException();
+    Unlink(tableIndex);
+
+    table[tableIndex].lruCounter = 0;
+    table[tableIndex].startInt = -1;
+    table[tableIndex].endInt = -1;
+    control[tableIndex] = SENTINEL_MARK;
+    elementCount--;
+}
+
+template <int MAX_SIZE>
+void HashTable<MAX_SIZE>::Link(int tableIndex, int segment)
+{
+    HashData &data = table[tableIndex];
+    data.segment = segment;
+    data.prevSlot = -1;
+    data.nextSlot = segmentHead[segment];
+
+    if (segmentHead[segment] != -1)
+        table[segmentHead[segment]].prevSlot = tableIndex;
+    else
+        segmentTail[segment] = tableIndex;
+    segmentHead[segment] = tableIndex;
+    segmentSize[segment]++;
+}
 
-    if (elementCount > MAX_SIZE / CAPACITY_THRESHOLD)
-        throw TableCapFullException(elementCount);
+template <int MAX_SIZE>
+void HashTable<MAX_SIZE>::Unlink(int tableIndex)
+{
+    HashData &data = table[tableIndex];
+    if (data.prevSlot != -1)
+        table[data.prevSlot].nextSlot = data.nextSlot;
+    else
+        segmentHead[data.segment] = data.nextSlot;
 
-    int index = Hash(intArray[0], intArray[intArray.size() - 1], isCostWeighted);
+    if (data.nextSlot != -1)
+        table[data.nextSlot].prevSlot = data.prevSlot;
+    else
+        segmentTail[data.segment] = data.prevSlot;
 
-    for (int i = 0;; i++)
+    data.prevSlot = -1;
+    data.nextSlot = -1;
+    segmentSize[data.segment]--;
+}
+
+template <int MAX_SIZE>
+void HashTable<MAX_SIZE>::Touch(int tableIndex)
+{
+    HashData &data = table[tableIndex];
+    data.lruCounter++;
+
+    // Second use of a probation entry proves it worth protecting
+    int segment = (data.segment == PROBATION_SEGMENT) ? PROTECTED_SEGMENT : data.segment;
+    Unlink(tableIndex);
+    Link(tableIndex, segment);
+
+    while (segmentSize[PROTECTED_SEGMENT] > segmentCapacity[PROTECTED_SEGMENT])
     {
+        int demoted = segmentTail[PROTECTED_SEGMENT];
+        Unlink(demoted);
+        Link(demoted, PROBATION_SEGMENT);
+    }
+}
+
+template <int MAX_SIZE>
+void HashTable<MAX_SIZE>::Rebalance()
+{
+    int mainCapacity = segmentCapacity[PROBATION_SEGMENT] + segmentCapacity[PROTECTED_SEGMENT];
 
-        int new_index = (index + i * i) % MAX_SIZE; 
-        if (table[new_index].sentinel == EMPTY_MARK || table[new_index].sentinel == SENTINEL_MARK)
+    while (segmentSize[WINDOW_SEGMENT] > segmentCapacity[WINDOW_SEGMENT])
+    {
+        int candidate = segmentTail[WINDOW_SEGMENT];
+        int victim = VictimSlot();
+
+        if (segmentSize[PROBATION_SEGMENT] + segmentSize[PROTECTED_SEGMENT] >= mainCapacity)
         {
+            // TinyLFU admission, the more frequent one of the two stays
+            const HashData &c = table[candidate];
+            const HashData &v = table[victim];
+            int candidateFrequency = sketch.Frequency(KeyHash(c.startInt, c.endInt, c.alphaBucket, c.filterFingerprint));
+            int victimFrequency = sketch.Frequency(KeyHash(v.startInt, v.endInt, v.alphaBucket, v.filterFingerprint));
 
-            for (int k = 0; k < intArray.size(); k++)
+            if (victim == candidate || candidateFrequency <= victimFrequency)
             {
-                table[new_index].intArray.push_back(intArray[k]);
-            } // vector deep copy
+                Release(candidate);
+                rejectionCount++;
+                continue;
+            }
 
-            table[new_index].lruCounter++;
+            Release(victim);
+            evictionCount++;
+        }
 
-            table[new_index].startInt = intArray[0];
-            table[new_index].endInt = intArray[intArray.size() - 1];
-            table[new_index].sentinel = OCCUPIED_MARK;
-            table[new_index].isCostWeighted = isCostWeighted;
+        Unlink(candidate);
+        Link(candidate, PROBATION_SEGMENT);
+    }
+}
 
-            elementCount++;
-            return 0;
+template <int MAX_SIZE>
+int HashTable<MAX_SIZE>::VictimSlot() const
+{
+    if (segmentTail[PROBATION_SEGMENT] != -1)
+        return segmentTail[PROBATION_SEGMENT];
+    if (segmentTail[PROTECTED_SEGMENT] != -1)
+        return segmentTail[PROTECTED_SEGMENT];
+    return segmentTail[WINDOW_SEGMENT];
+}
 
-        } // it is not present in the hashtable->reaches an empty spot.
+template <int MAX_SIZE>
+int HashTable<MAX_SIZE>::Insert(const std::vector<int> &intArray,
+                                int alphaBucket, unsigned int filterFingerprint,
+                                float alphaFrom, float alphaTo)
+{
+    if (intArray.size() < 1)
+        throw InvalidTableArgException();
 
-        if (table[new_index].sentinel == OCCUPIED_MARK && table[new_index].startInt == intArray[0] && table[new_index].endInt == intArray[intArray.size() - 1] && table[new_index].isCostWeighted == isCostWeighted)
+    // Already present, counts the insertion. A route shortest at two
+    // alphas is shortest for the ones in between.
+    int existing = FindIndex(intArray[0], intArray[intArray.size() - 1],
+                             alphaBucket, filterFingerprint);
+    if (existing != -1)
+    {
+        HashData &data = table[existing];
+        if (data.intArray == intArray)
         {
-            table[new_index].lruCounter++;
-            return table[new_index].lruCounter - 1;
+            if (alphaFrom < data.alphaFrom)
+                data.alphaFrom = alphaFrom;
+            if (alphaTo > data.alphaTo)
+                data.alphaTo = alphaTo;
         }
+        else
+        {
+            data.intArray.assign(intArray.begin(), intArray.end());
+            data.alphaFrom = alphaFrom;
+            data.alphaTo = alphaTo;
+        }
+        Touch(existing);
+        return data.lruCounter - 1;
     }
 
-    return -1;
+    // New entries start in the window, full segments evict in O(1)
+    int index = Occupy(intArray, alphaBucket, filterFingerprint, alphaFrom, alphaTo);
+    Link(index, WINDOW_SEGMENT);
+    Rebalance();
+
+    return 0;
 }
 
 template <int MAX_SIZE>
 bool HashTable<MAX_SIZE>::Find(std::vector<int> &intArray,
-                               int startInt, int endInt, bool isCostWeighted,
-                               bool incLRU)
+                               int startInt, int endInt,
+                               int alphaBucket, unsigned int filterFingerprint,
+                               bool incLRU, float alpha)
 {
-    int index = Hash(startInt, endInt, isCostWeighted);
+    int new_index = FindIndex(startInt, endInt, alphaBucket, filterFingerprint);
+    if (new_index != -1 && !IsShortestFor(table[new_index], alpha))
+        new_index = -1;
 
-    for (int i = 0;; i++)
+    // Only counted lookups feed the sketch and the statistics
+    if (incLRU)
     {
+        sketch.Increment(KeyHash(startInt, endInt, alphaBucket, filterFingerprint));
+        if (new_index == -1)
+            missCount++;
+        else
+            hitCount++;
+    }
 
-        int new_index = (index + i * i) % MAX_SIZE;
+    if (new_index == -1)
+        return false;
 
-        if (table[new_index].sentinel == EMPTY_MARK)
-            return false;
+    if (incLRU)
+        Touch(new_index);
 
-        if (table[new_index].sentinel == OCCUPIED_MARK && table[new_index].startInt == startInt && table[new_index].endInt == endInt && table[new_index].isCostWeighted == isCostWeighted)
+    intArray = table[new_index].intArray;
+    return true;
+}
+
+template <int MAX_SIZE>
+int HashTable<MAX_SIZE>::FindBatch(std::vector<std::vector<int>> &intArrays,
+                                   std::vector<char> &isFound,
+                                   const std::vector<HashKey> &keys,
+                                   bool incLRU)
+{
+    size_t keyCount = keys.size();
+    std::vector<unsigned int> keyHashes(keyCount);
+    std::vector<int> indices(keyCount);
+    intArrays.resize(keyCount);
+    isFound.assign(keyCount, 0);
+
+    for (size_t i = 0; i < keyCount; i++)
+        keyHashes[i] = KeyHash(keys[i].startInt, keys[i].endInt,
+                               keys[i].alphaBucket, keys[i].filterFingerprint);
+
+    // Probes touch the control bytes and the keys of matching tags only,
+    // the paths they find are loaded while the other keys are probed
+    for (size_t i = 0; i < keyCount; i++)
+    {
+        indices[i] = FindIndex(keyHashes[i], keys[i].startInt, keys[i].endInt,
+                               keys[i].alphaBucket, keys[i].filterFingerprint);
+        if (indices[i] != -1 && !IsShortestFor(table[indices[i]], keys[i].alpha))
+            indices[i] = -1;
+#if defined(__GNUC__)
+        if (indices[i] != -1)
+            __builtin_prefetch(table[indices[i]].intArray.data());
+#endif
+    }
+
+    // Touching only relinks the recency lists, the slots stay valid
+    int foundCount = 0;
+    for (size_t i = 0; i < keyCount; i++)
+    {
+        if (incLRU)
         {
-            if (incLRU)
-            {
-                table[new_index].lruCounter++;
-            }
+            sketch.Increment(keyHashes[i]);
+            if (indices[i] == -1)
+                missCount++;
+            else
+                hitCount++;
+        }
+
+        if (indices[i] == -1)
+            continue;
 
-            intArray.clear();
+        if (incLRU)
+            Touch(indices[i]);
 
-            for (int k = 0; k < table[new_index].intArray.size(); k++)
+        intArrays[i] = table[indices[i]].intArray;
+        isFound[i] = 1;
+        foundCount++;
+    }
+    return foundCount;
+}
+
+template <int MAX_SIZE>
+bool HashTable<MAX_SIZE>::FindPrefix(std::vector<int> &intArray,
+                                     int startInt, int endInt,
+                                     int alphaBucket, unsigned int filterFingerprint,
+                                     float alpha) const
+{
+    // Any part of a shortest path starting at its start is a shortest path
+    for (int i = 0; i < MAX_SIZE; i++)
+    {
+        const HashData &data = table[i];
+        if (!IsOccupied(i) || data.startInt != startInt ||
+            data.alphaBucket != alphaBucket || data.filterFingerprint != filterFingerprint ||
+            !IsShortestFor(data, alpha))
+            continue;
+
+        for (size_t k = 2; k < data.intArray.size(); k += 2)
+        {
+            if (data.intArray[k] == endInt)
             {
-                intArray.push_back(table[new_index].intArray[k]);
+                intArray.assign(data.intArray.begin(), data.intArray.begin() + k + 1);
+                return true;
             }
-            return true;
         }
     }
 
@@ -149,94 +492,222 @@ bool HashTable<MAX_SIZE>::Find(std::vector<int> &intArray,
 template <int MAX_SIZE>
 void HashTable<MAX_SIZE>::InvalidateTable()
 {
+    for (int i = 0; i < CONTROL_SIZE; i++)
+        control[i] = EMPTY_MARK;
+
     for (int i = 0; i < MAX_SIZE; i++)
     {
         table[i].lruCounter = 0;
-        table[i].sentinel = EMPTY_MARK;
+        table[i].prevSlot = -1;
+        table[i].nextSlot = -1;
+    }
+
+    for (int k = 0; k < SEGMENT_COUNT; k++)
+    {
+        segmentHead[k] = -1;
+        segmentTail[k] = -1;
+        segmentSize[k] = 0;
     }
 
     elementCount = 0;
 }
 
 template <int MAX_SIZE>
-void HashTable<MAX_SIZE>::GetMostInserted(std::vector<int> &intArray) const
+void HashTable<MAX_SIZE>::InvalidateVertices(const std::vector<int> &vertexIndices)
 {
-    int maximum = -1;
+    std::vector<int> v;
 
     for (int i = 0; i < MAX_SIZE; i++)
     {
+        if (!IsOccupied(i))
+            continue;
 
-        if (table[i].lruCounter > maximum)
+        // Vertices are on the even positions of the path
+        const std::vector<int> &path = table[i].intArray;
+        bool found = false;
+        for (size_t k = 0; k < path.size() && !found; k += 2)
         {
-
-            maximum = table[i].lruCounter;
-            intArray.clear();
-
-            for (int k = 0; k < table[i].intArray.size(); k++)
+            for (size_t j = 0; j < vertexIndices.size(); j++)
             {
-                intArray.push_back(table[i].intArray[k]);
+                if (path[k] == vertexIndices[j])
+                {
+                    found = true;
+                    break;
+                }
             }
         }
+
+        if (found)
+            Remove(v, table[i].startInt, table[i].endInt,
+                   table[i].alphaBucket, table[i].filterFingerprint);
     }
 }
 
 template <int MAX_SIZE>
-void HashTable<MAX_SIZE>::Remove(std::vector<int> &intArray,
-                                 int startInt, int endInt, bool isCostWeighted)
+void HashTable<MAX_SIZE>::InvalidateEdge(int vertexIndex, int edgeIndex)
 {
-    int index = Hash(startInt, endInt, isCostWeighted);
+    std::vector<int> v;
 
-    for (int i = 0;; i++)
+    for (int i = 0; i < MAX_SIZE; i++)
     {
+        if (!IsOccupied(i))
+            continue;
 
-        int new_index = (index + i * i) % MAX_SIZE;
-
-        if (table[new_index].sentinel == EMPTY_MARK)
-            return;
-
-        if (table[new_index].sentinel == OCCUPIED_MARK && table[new_index].startInt == startInt && table[new_index].endInt == endInt && table[new_index].isCostWeighted == isCostWeighted)
+        // Edge follows its source vertex in the path
+        const std::vector<int> &path = table[i].intArray;
+        for (size_t k = 0; k + 1 < path.size(); k += 2)
         {
-
-            table[new_index].lruCounter = 0;
-            table[new_index].startInt = -1;
-            table[new_index].endInt = -1;
-            table[new_index].sentinel = SENTINEL_MARK;
-            elementCount--;
-
-            intArray.clear();
-            for (int k = 0; k < table[new_index].intArray.size(); k++)
+            if (path[k] == vertexIndex && path[k + 1] == edgeIndex)
             {
-                intArray.push_back(table[new_index].intArray[k]);
+                Remove(v, table[i].startInt, table[i].endInt,
+                       table[i].alphaBucket, table[i].filterFingerprint);
+                break;
             }
-            return;
         }
     }
 }
 
 template <int MAX_SIZE>
-void HashTable<MAX_SIZE>::RemoveLRU(int lruElementCount)
+template <class Predicate>
+void HashTable<MAX_SIZE>::InvalidateIf(Predicate isStale)
 {
     std::vector<int> v;
 
-    HashData x;
+    for (int i = 0; i < MAX_SIZE; i++)
+    {
+        if (!IsOccupied(i))
+            continue;
 
-    for (int i = 0; i < lruElementCount; i++)
+        const HashData &entry = table[i];
+        if (isStale(entry))
+            Remove(v, entry.startInt, entry.endInt,
+                   entry.alphaBucket, entry.filterFingerprint);
+    }
+}
+
+template <int MAX_SIZE>
+void HashTable<MAX_SIZE>::RemapVertices(const std::vector<int> &oldToNewIndex)
+{
+    // Keys change with the indices, so entries are placed again, least
+    // recent first to keep the order of every segment
+    std::vector<HashData> entries;
+    for (int k = 0; k < SEGMENT_COUNT; k++)
     {
-        // remove 1 element in 1 loop
-        int minimum = 50000;
-        for (int k = 0; k < MAX_SIZE; k++)
+        for (int i = segmentTail[k]; i != -1; i = table[i].prevSlot)
+            entries.push_back(table[i]);
+    }
+    for (int i = 0; i < MAX_SIZE; i++)
+        table[i].intArray.clear();
+
+    InvalidateTable();
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        std::vector<int> &path = entries[i].intArray;
+        bool isValid = true;
+        for (size_t k = 0; k < path.size(); k += 2)
         {
-            if (table[k].sentinel == OCCUPIED_MARK && table[k].lruCounter < minimum)
+            int newIndex = (path[k] < static_cast<int>(oldToNewIndex.size()))
+                               ? oldToNewIndex[path[k]]
+                               : -1;
+            if (newIndex == -1)
             {
-                minimum = table[k].lruCounter;
-                x = table[k];
+                isValid = false;
+                break;
             }
+            path[k] = newIndex;
         }
 
-        Remove(v, x.startInt, x.endInt, x.isCostWeighted);
+        if (!isValid)
+            continue;
+
+        int index = Occupy(path, entries[i].alphaBucket, entries[i].filterFingerprint,
+                           entries[i].alphaFrom, entries[i].alphaTo);
+        Link(index, entries[i].segment);
+        table[index].lruCounter = entries[i].lruCounter;
+    }
+}
+
+template <int MAX_SIZE>
+void HashTable<MAX_SIZE>::GetMostInserted(std::vector<int> &intArray) const
+{
+    // Scanned on demand, inserts and evictions do not track it
+    int mostUsedSlot = -1;
+    for (int i = 0; i < MAX_SIZE; i++)
+    {
+        if (IsOccupied(i) &&
+            (mostUsedSlot == -1 || table[i].lruCounter > table[mostUsedSlot].lruCounter))
+            mostUsedSlot = i;
+    }
+
+    if (mostUsedSlot != -1)
+        intArray = table[mostUsedSlot].intArray;
+}
+
+template <int MAX_SIZE>
+void HashTable<MAX_SIZE>::Remove(std::vector<int> &intArray,
+                                 int startInt, int endInt,
+                                 int alphaBucket, unsigned int filterFingerprint)
+{
+    int new_index = FindIndex(startInt, endInt, alphaBucket, filterFingerprint);
+    if (new_index == -1)
+        return;
+
+    intArray = table[new_index].intArray;
+    Release(new_index);
+}
+
+template <int MAX_SIZE>
+void HashTable<MAX_SIZE>::RemoveLRU(int lruElementCount)
+{
+    // Same victims the admission policy would pick
+    for (int i = 0; i < lruElementCount; i++)
+    {
+        int victim = VictimSlot();
+        if (victim == -1)
+            return;
+
+        Release(victim);
+        evictionCount++;
     }
 }
 
+template <int MAX_SIZE>
+int HashTable<MAX_SIZE>::HitCount() const
+{
+    return hitCount;
+}
+
+template <int MAX_SIZE>
+int HashTable<MAX_SIZE>::MissCount() const
+{
+    return missCount;
+}
+
+template <int MAX_SIZE>
+float HashTable<MAX_SIZE>::HitRate() const
+{
+    int lookupCount = hitCount + missCount;
+    return (lookupCount == 0) ? 0 : static_cast<float>(hitCount) / lookupCount;
+}
+
+template <int MAX_SIZE>
+size_t HashTable<MAX_SIZE>::MemoryBytes() const
+{
+    size_t bytes = sizeof(*this) + sketch.MemoryBytes();
+    for (int i = 0; i < MAX_SIZE; i++)
+        bytes += table[i].intArray.capacity() * sizeof(int);
+    return bytes;
+}
+
+template <int MAX_SIZE>
+void HashTable<MAX_SIZE>::PrintStatistics() const
+{
+    OutputBuffer &out = ThreadOutput();
+    out.AppendFormat("Hits %d Misses %d Hit rate %.3f Evictions %d Rejections %d\n",
+           hitCount, missCount, HitRate(), evictionCount, rejectionCount);
+    FlushOutput();
+}
 
 template <int MAX_SIZE>
 void HashTable<MAX_SIZE>::PrintSortedLRUEntries() const
@@ -259,6 +730,7 @@ void HashTable<MAX_SIZE>::PrintSortedLRUEntries() const
         PrintLine(name.top().value);
         name.pop();
     }
+    FlushOutput();
 }
 
 #endif // HASH_TABLE_HPP
\ No newline at end of file
@@ -0,0 +1,180 @@
+#ifndef QUERY_TASK_H
+#define QUERY_TASK_H
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+
+// Status of a QueryTask
+#define QUERY_RUNNING -1
+#define QUERY_FOUND 0
+#define QUERY_NO_ROUTE 1
+#define QUERY_CANCELLED 2
+#define QUERY_TIMED_OUT 3
+
+typedef std::chrono::steady_clock::time_point QueryDeadline;
+
+// Copies share the flag, any of them cancels the query. Cancelling is
+// safe from other threads, the query notices it between its slices.
+class CancellationToken
+{
+private:
+    std::shared_ptr<std::atomic<bool>> isCancelled;
+
+public:
+    CancellationToken()
+        : isCancelled(std::make_shared<std::atomic<bool>>(false))
+    {
+    }
+
+    void Cancel()
+    {
+        isCancelled->store(true, std::memory_order_relaxed);
+    }
+
+    bool IsCancelled() const
+    {
+        return isCancelled->load(std::memory_order_relaxed);
+    }
+};
+
+// Query that runs in slices, suspended with co_await std::suspend_always()
+// between them. Finishes with one of the QUERY_* statuses.
+class QueryTask
+{
+public:
+    struct promise_type
+    {
+        int status = QUERY_RUNNING;
+        std::exception_ptr exception;
+
+        QueryTask get_return_object()
+        {
+            return QueryTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept
+        {
+            return std::suspend_always();
+        }
+        std::suspend_always final_suspend() noexcept
+        {
+            return std::suspend_always();
+        }
+        void return_value(int value) noexcept
+        {
+            status = value;
+        }
+        void unhandled_exception() noexcept
+        {
+            exception = std::current_exception();
+        }
+    };
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit QueryTask(std::coroutine_handle<promise_type> handle)
+        : handle(handle)
+    {
+    }
+
+public:
+    QueryTask()
+        : handle(NULL)
+    {
+    }
+    QueryTask(QueryTask &&other) noexcept
+        : handle(other.handle)
+    {
+        other.handle = NULL;
+    }
+    QueryTask &operator=(QueryTask &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle)
+                handle.destroy();
+            handle = other.handle;
+            other.handle = NULL;
+        }
+        return *this;
+    }
+    QueryTask(const QueryTask &) = delete;
+    QueryTask &operator=(const QueryTask &) = delete;
+    ~QueryTask()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    // Runs the next slice, false once the query is done
+    bool Resume()
+    {
+        if (!handle || handle.done())
+            return false;
+
+        handle.resume();
+        if (handle.promise().exception)
+            std::rethrow_exception(handle.promise().exception);
+        return !handle.done();
+    }
+
+    bool IsDone() const
+    {
+        return !handle || handle.done();
+    }
+
+    int Status() const
+    {
+        return handle ? handle.promise().status : QUERY_RUNNING;
+    }
+};
+
+// Runs the submitted queries a slice at a time in submission order, so
+// a long search delays the short ones by one slice instead of its whole
+// run. Single threaded like the flight_app the queries run on.
+class QueryExecutor
+{
+private:
+    std::deque<QueryTask *> pending;
+
+public:
+    // The task must outlive its run
+    void Submit(QueryTask &task)
+    {
+        if (!task.IsDone())
+            pending.push_back(&task);
+    }
+
+    // Resumes the oldest pending query once, false when none is left
+    bool RunSlice()
+    {
+        if (pending.empty())
+            return false;
+
+        QueryTask *task = pending.front();
+        pending.pop_front();
+        if (task->Resume())
+            pending.push_back(task);
+        return !pending.empty();
+    }
+
+    // Until every submitted query is done
+    void Run()
+    {
+        while (RunSlice())
+        {
+        }
+    }
+
+    size_t PendingCount() const
+    {
+        return pending.size();
+    }
+};
+
+#endif // QUERY_TASK_H
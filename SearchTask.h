@@ -0,0 +1,112 @@
+#ifndef SEARCH_TASK_H
+#define SEARCH_TASK_H
+
+#include "BlockPool.h"
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+
+// Search that runs in slices. Nothing runs until the first Resume,
+// every Resume continues until the search suspends at a checkpoint
+// (true) or finishes (false, then Result holds its outcome).
+class SearchTask
+{
+public:
+    struct promise_type
+    {
+        bool result = false;
+        std::exception_ptr exception;
+
+        // Frames come from the thread's block cache (BlockPool.h), every
+        // synchronous search creates and destroys one
+        static void *operator new(std::size_t bytes)
+        {
+            return BlockPool::AllocateLocal(bytes);
+        }
+        static void operator delete(void *frame, std::size_t bytes)
+        {
+            BlockPool::DeallocateLocal(frame, bytes);
+        }
+
+        SearchTask get_return_object()
+        {
+            return SearchTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept
+        {
+            return std::suspend_always();
+        }
+        std::suspend_always final_suspend() noexcept
+        {
+            return std::suspend_always();
+        }
+        // Checkpoint, the value is not used
+        std::suspend_always yield_value(int) noexcept
+        {
+            return std::suspend_always();
+        }
+        void return_value(bool value) noexcept
+        {
+            result = value;
+        }
+        void unhandled_exception() noexcept
+        {
+            exception = std::current_exception();
+        }
+    };
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit SearchTask(std::coroutine_handle<promise_type> handle)
+        : handle(handle)
+    {
+    }
+
+public:
+    SearchTask()
+        : handle(NULL)
+    {
+    }
+    SearchTask(SearchTask &&other) noexcept
+        : handle(other.handle)
+    {
+        other.handle = NULL;
+    }
+    SearchTask &operator=(SearchTask &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle)
+                handle.destroy();
+            handle = other.handle;
+            other.handle = NULL;
+        }
+        return *this;
+    }
+    SearchTask(const SearchTask &) = delete;
+    SearchTask &operator=(const SearchTask &) = delete;
+    ~SearchTask()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    bool Resume()
+    {
+        if (!handle || handle.done())
+            return false;
+
+        handle.resume();
+        if (handle.promise().exception)
+            std::rethrow_exception(handle.promise().exception);
+        return !handle.done();
+    }
+
+    bool Result() const
+    {
+        return handle && handle.promise().result;
+    }
+};
+
+#endif // SEARCH_TASK_H
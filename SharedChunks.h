@@ -0,0 +1,90 @@
+#ifndef SHARED_CHUNKS_H
+#define SHARED_CHUNKS_H
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Items per chunk (log2)
+#define SHARED_CHUNK_BITS 6
+
+// Vector stored in fixed size chunks that its copies share. Writing an
+// item through a copy that does not own its chunk alone copies that
+// chunk first, so a copy costs one pointer per chunk and every change
+// after it at most one chunk. Reads never copy; write access (the non
+// const operator[]) is meant for writes.
+template <class T>
+class SharedChunks
+{
+private:
+    static const size_t CHUNK_SIZE = static_cast<size_t>(1) << SHARED_CHUNK_BITS;
+    static const size_t CHUNK_MASK = CHUNK_SIZE - 1;
+    typedef std::vector<T> Chunk;
+
+    std::vector<std::shared_ptr<Chunk>> chunks;
+    size_t itemCount;
+
+    Chunk &WritableChunk(size_t chunkIndex)
+    {
+        std::shared_ptr<Chunk> &chunk = chunks[chunkIndex];
+        if (chunk.use_count() != 1)
+            chunk = std::make_shared<Chunk>(*chunk);
+        return *chunk;
+    }
+
+public:
+    SharedChunks()
+        : itemCount(0)
+    {
+    }
+
+    explicit SharedChunks(size_t count)
+        : itemCount(0)
+    {
+        for (size_t i = 0; i < count; i++)
+            push_back(T());
+    }
+
+    size_t size() const
+    {
+        return itemCount;
+    }
+
+    const T &operator[](size_t i) const
+    {
+        return (*chunks[i >> SHARED_CHUNK_BITS])[i & CHUNK_MASK];
+    }
+
+    T &operator[](size_t i)
+    {
+        return WritableChunk(i >> SHARED_CHUNK_BITS)[i & CHUNK_MASK];
+    }
+
+    void push_back(const T &item)
+    {
+        if ((itemCount & CHUNK_MASK) == 0)
+        {
+            chunks.push_back(std::make_shared<Chunk>());
+            chunks.back()->reserve(CHUNK_SIZE);
+        }
+        WritableChunk(chunks.size() - 1).push_back(item);
+        itemCount++;
+    }
+
+    void swap(SharedChunks &other)
+    {
+        chunks.swap(other.chunks);
+        std::swap(itemCount, other.itemCount);
+    }
+
+    // Bytes of the chunk arrays and the chunk list, not of what the
+    // items own
+    size_t Bytes() const
+    {
+        return chunks.capacity() * sizeof(std::shared_ptr<Chunk>) +
+               chunks.size() * (CHUNK_SIZE * sizeof(T) + sizeof(Chunk));
+    }
+};
+
+#endif // SHARED_CHUNKS_H
@@ -0,0 +1,95 @@
+#ifndef WEIGHT_POLICY_H
+#define WEIGHT_POLICY_H
+
+#include "multi_graph.h"
+#include <limits>
+
+// Edge weight policies the search kernels are specialized on.
+// IS_BLEND policies are a Lerp of the two weights with alpha Alpha(),
+// they can run on the flattened weight arrays (weight of (w0, w1)) and
+// use the landmark bounds. Others need the whole edge and report a
+// negative alpha. SINGLE_WEIGHT is the one weight a policy reads (0 or
+// 1), -1 when it reads both or the whole edge.
+
+// Pure weight[0] (alpha = 0)
+struct TimeWeightPolicy
+{
+    static constexpr bool IS_BLEND = true;
+    static constexpr int SINGLE_WEIGHT = 0;
+
+    inline float Alpha() const
+    {
+        return 0;
+    }
+    inline float operator()(const GraphEdge &edge) const
+    {
+        return edge.weight[0];
+    }
+    inline float operator()(float w0, float /*w1*/) const
+    {
+        return w0;
+    }
+};
+
+// Pure weight[1] (alpha = 1)
+struct PriceWeightPolicy
+{
+    static constexpr bool IS_BLEND = true;
+    static constexpr int SINGLE_WEIGHT = 1;
+
+    inline float Alpha() const
+    {
+        return 1;
+    }
+    inline float operator()(const GraphEdge &edge) const
+    {
+        return edge.weight[1];
+    }
+    inline float operator()(float /*w0*/, float w1) const
+    {
+        return w1;
+    }
+};
+
+// General linear interpolation of both weights
+struct BlendWeightPolicy
+{
+    static constexpr bool IS_BLEND = true;
+    static constexpr int SINGLE_WEIGHT = -1;
+
+    float alpha;
+
+    inline float Alpha() const
+    {
+        return alpha;
+    }
+    inline float operator()(const GraphEdge &edge) const
+    {
+        return edge.weight[0] * (1 - alpha) + edge.weight[1] * alpha;
+    }
+    inline float operator()(float w0, float w1) const
+    {
+        return w0 * (1 - alpha) + w1 * alpha;
+    }
+};
+
+// Hop count over the edges of a single name, others are not traversable
+struct UnitWeightPolicy
+{
+    static constexpr bool IS_BLEND = false;
+    static constexpr int SINGLE_WEIGHT = -1;
+
+    // Interned name, -1 matches no edge
+    int edgeNameId;
+
+    inline float Alpha() const
+    {
+        return -1;
+    }
+    inline float operator()(const GraphEdge &edge) const
+    {
+        return (edge.nameId == edgeNameId) ? 1.0f : std::numeric_limits<float>::infinity();
+    }
+};
+
+#endif // WEIGHT_POLICY_H
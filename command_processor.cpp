@@ -0,0 +1,357 @@
+#include "command_processor.h"
+#include "Exceptions.h"
+#include "output_writer.h"
+#include "trace.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+
+struct CommandSyntax
+{
+    const char *name;
+    int type;
+    int nameCount;
+    int numberCount;
+    // Any number of names after the numbers (the airline list)
+    bool hasTrailingNames;
+};
+
+static const CommandSyntax COMMAND_SYNTAX[] =
+    {
+        {"find", COMMAND_FIND, 2, 1, false},
+        {"find-specific", COMMAND_FIND_SPECIFIC, 2, 1, true},
+        {"halt", COMMAND_HALT, 3, 0, false},
+        {"continue", COMMAND_CONTINUE, 3, 0, false},
+        {"update", COMMAND_UPDATE, 3, 2, false},
+        {"decommission", COMMAND_DECOMMISSION, 1, 0, false},
+        {"furthest", COMMAND_FURTHEST, 2, 0, false},
+        {"sweep", COMMAND_SWEEP, 2, 0, false},
+        {"alternatives", COMMAND_ALTERNATIVES, 2, 2, false},
+        {"earliest", COMMAND_EARLIEST, 2, 1, false},
+        {"print-cache", COMMAND_PRINT_CACHE, 0, 0, false},
+        {"print-map", COMMAND_PRINT_MAP, 0, 0, false},
+        {"stats", COMMAND_STATS, 0, 0, false},
+        {"memory", COMMAND_MEMORY, 0, 0, false},
+        {"delta", COMMAND_DELTA, 1, 0, false},
+        {"trace", COMMAND_TRACE, 1, 0, false},
+};
+
+// Splits on spaces, tabs and carriage returns
+static void Tokenize(std::vector<std::string> &tokens, const std::string &line)
+{
+    tokens.clear();
+    size_t i = 0;
+    while (i < line.size())
+    {
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r'))
+            i++;
+        size_t start = i;
+        while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r')
+            i++;
+        if (i > start)
+            tokens.push_back(line.substr(start, i - start));
+    }
+}
+
+static bool ParseNumber(float &number, const std::string &token)
+{
+    char *end;
+    number = std::strtof(token.c_str(), &end);
+    return *end == '\0' && std::isfinite(number);
+}
+
+// Nothing to execute on the line
+bool CommandProcessor::IsSkippedLine(const std::string &line)
+{
+    size_t i = line.find_first_not_of(" \t\r");
+    return i == std::string::npos || line[i] == '#';
+}
+
+CommandProcessor::CommandProcessor(flight_app &app, std::mutex *appMutex)
+    : app(app), appMutex(appMutex), executedCount(0), invalidCount(0)
+{
+}
+
+bool CommandProcessor::ParseCommand(FlightCommand &command, const std::string &line)
+{
+    command.type = COMMAND_INVALID;
+    command.names.clear();
+    command.line = line;
+
+    std::vector<std::string> tokens;
+    Tokenize(tokens, line);
+    if (tokens.empty())
+        return false;
+
+    const CommandSyntax *syntax = NULL;
+    for (size_t i = 0; i < sizeof(COMMAND_SYNTAX) / sizeof(COMMAND_SYNTAX[0]); i++)
+    {
+        if (tokens[0] == COMMAND_SYNTAX[i].name)
+        {
+            syntax = &COMMAND_SYNTAX[i];
+            break;
+        }
+    }
+    if (!syntax)
+        return false;
+
+    size_t fixedCount = 1 + syntax->nameCount + syntax->numberCount;
+    if (tokens.size() < fixedCount || (tokens.size() > fixedCount && !syntax->hasTrailingNames))
+        return false;
+
+    for (int i = 0; i < syntax->numberCount; i++)
+    {
+        if (!ParseNumber(command.numbers[i], tokens[1 + syntax->nameCount + i]))
+            return false;
+    }
+
+    for (int i = 0; i < syntax->nameCount; i++)
+        command.names.push_back(tokens[1 + i]);
+    for (size_t i = fixedCount; i < tokens.size(); i++)
+        command.names.push_back(tokens[i]);
+
+    command.type = syntax->type;
+    return true;
+}
+
+void CommandProcessor::Execute(const FlightCommand &command)
+{
+    const std::vector<std::string> &names = command.names;
+    OutputBuffer &out = ThreadOutput();
+
+    try
+    {
+        switch (command.type)
+        {
+        case COMMAND_FIND:
+            app.FindFlight(names[0], names[1], command.numbers[0]);
+            break;
+        case COMMAND_FIND_SPECIFIC:
+        {
+            std::vector<std::string> airlineNames(names.begin() + 2, names.end());
+            app.FindSpecificFlight(names[0], names[1], command.numbers[0], airlineNames);
+            break;
+        }
+        case COMMAND_HALT:
+            app.HaltFlight(names[0], names[1], names[2]);
+            break;
+        case COMMAND_CONTINUE:
+            app.ContinueFlight(names[0], names[1], names[2]);
+            break;
+        case COMMAND_UPDATE:
+            app.UpdateFlightWeights(names[0], names[1], names[2],
+                                    command.numbers[0], command.numbers[1]);
+            break;
+        case COMMAND_DECOMMISSION:
+            app.DecommissionAirport(names[0]);
+            break;
+        case COMMAND_FURTHEST:
+            out.AppendInt(app.FurthestTransferViaAirline(names[0], names[1]));
+            out.Append('\n');
+            FlushOutput();
+            break;
+        case COMMAND_SWEEP:
+            app.FindFlightSweep(names[0], names[1]);
+            break;
+        case COMMAND_ALTERNATIVES:
+            app.FindAlternativeFlights(names[0], names[1], command.numbers[0],
+                                       static_cast<int>(command.numbers[1]));
+            break;
+        case COMMAND_EARLIEST:
+            app.FindEarliestFlight(names[0], names[1], command.numbers[0]);
+            break;
+        case COMMAND_PRINT_CACHE:
+            app.PrintCache();
+            break;
+        case COMMAND_PRINT_MAP:
+            app.PrintMap();
+            break;
+        case COMMAND_STATS:
+            app.PrintCacheStatistics();
+            break;
+        case COMMAND_MEMORY:
+            app.PrintMemoryUsage();
+            break;
+        case COMMAND_DELTA:
+            app.ApplyDelta(names[0]);
+            break;
+        case COMMAND_TRACE:
+            Trace(names[0]);
+            break;
+        default:
+            out.Append("Invalid command: ");
+            out.Append(command.line);
+            out.Append('\n');
+            FlushOutput();
+            invalidCount++;
+            return;
+        }
+    }
+    catch (struct VertexNotFoundException e)
+    {
+        out.Append(e.ToString());
+        out.Append('\n');
+        FlushOutput();
+    }
+    catch (struct EdgeNotFoundException e)
+    {
+        out.Append(e.ToString());
+        out.Append('\n');
+        FlushOutput();
+    }
+    catch (struct SameNamedEdgeException e)
+    {
+        out.Append(e.ToString());
+        out.Append('\n');
+        FlushOutput();
+    }
+    catch (struct DuplicateVertexException e)
+    {
+        out.Append(e.ToString());
+        out.Append('\n');
+        FlushOutput();
+    }
+    executedCount++;
+}
+
+void CommandProcessor::Trace(const std::string &argument)
+{
+    if (argument == "on")
+        SetTracing(true);
+    else if (argument == "off")
+        SetTracing(false);
+    else if (argument == "summary")
+        PrintTraceSummary();
+    else
+    {
+        OutputBuffer &out = ThreadOutput();
+        if (WriteChromeTrace(argument))
+            out.AppendFormat("Trace written to \"%s\"\n", argument.c_str());
+        else
+            out.AppendFormat("Can not write trace \"%s\"\n", argument.c_str());
+        FlushOutput();
+    }
+}
+
+void CommandProcessor::ExecuteLine(const std::string &line)
+{
+    if (IsSkippedLine(line))
+        return;
+
+    FlightCommand command;
+    ParseCommand(command, line);
+    Execute(command);
+}
+
+void CommandProcessor::ReadCommands(int fileDescriptor, CommandQueue &queue)
+{
+    std::vector<char> buffer(COMMAND_READ_SIZE);
+    std::string pending;
+    std::vector<FlightCommand> batch;
+
+    // Every read becomes one batch, its last partial line waits
+    // for the next read
+    while (true)
+    {
+        ssize_t count = read(fileDescriptor, buffer.data(), buffer.size());
+        if (count < 0 && errno == EINTR)
+            continue;
+        bool isEnd = count <= 0;
+        if (!isEnd)
+            pending.append(buffer.data(), static_cast<size_t>(count));
+        else if (!pending.empty())
+            pending.push_back('\n');
+
+        size_t start = 0;
+        size_t end;
+        while ((end = pending.find('\n', start)) != std::string::npos)
+        {
+            std::string line = pending.substr(start, end - start);
+            start = end + 1;
+            if (IsSkippedLine(line))
+                continue;
+
+            batch.push_back(FlightCommand());
+            ParseCommand(batch.back(), line);
+        }
+        pending.erase(0, start);
+
+        if (!batch.empty())
+        {
+            if (!queue.Push(batch))
+                return;
+            batch.clear();
+        }
+        if (isEnd)
+            return;
+    }
+}
+
+// False once the descriptor takes no more
+static bool WriteAll(int fileDescriptor, const std::string &text)
+{
+    size_t written = 0;
+    while (written < text.size())
+    {
+        ssize_t count = write(fileDescriptor, text.data() + written, text.size() - written);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        written += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+void CommandProcessor::ExecuteBatch(const std::vector<FlightCommand> &batch)
+{
+    std::unique_lock<std::mutex> lock;
+    if (appMutex)
+        lock = std::unique_lock<std::mutex>(*appMutex);
+    for (size_t i = 0; i < batch.size(); i++)
+        Execute(batch[i]);
+}
+
+void CommandProcessor::Run(int fileDescriptor, int outputDescriptor)
+{
+    CommandQueue queue(COMMAND_QUEUE_BATCHES);
+    std::thread reader([fileDescriptor, &queue]
+                       {
+                           ReadCommands(fileDescriptor, queue);
+                           queue.Close(); });
+
+    // Results of a batch are written after the app is released, a
+    // slow reader holds up only its own commands
+    std::string results;
+    bool isWritable = true;
+    if (outputDescriptor >= 0)
+        CaptureOutput(&results);
+
+    std::vector<FlightCommand> batch;
+    while (queue.Pop(batch))
+    {
+        ExecuteBatch(batch);
+        if (outputDescriptor >= 0)
+        {
+            if (isWritable)
+                isWritable = WriteAll(outputDescriptor, results);
+            results.clear();
+        }
+    }
+
+    if (outputDescriptor >= 0)
+        CaptureOutput(NULL);
+    reader.join();
+}
+
+long CommandProcessor::ExecutedCount() const
+{
+    return executedCount;
+}
+
+long CommandProcessor::InvalidCount() const
+{
+    return invalidCount;
+}
@@ -0,0 +1,97 @@
+#ifndef COMMAND_PROCESSOR_H
+#define COMMAND_PROCESSOR_H
+
+#include "flight_app.h"
+#include "BoundedQueue.h"
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Commands, one per line, tokens separated by whitespace:
+//   find FROM TO ALPHA
+//   find-specific FROM TO ALPHA [AIRLINE...]
+//   halt FROM TO AIRLINE
+//   continue FROM TO AIRLINE
+//   update FROM TO AIRLINE W0 W1
+//   decommission AIRPORT
+//   furthest AIRPORT AIRLINE
+//   sweep FROM TO
+//   alternatives FROM TO ALPHA COUNT
+//   earliest FROM TO DEPARTURE
+//   delta DELTA_FILE
+//   trace on|off|summary|TRACE_FILE (trace.h, a file gets the events as
+//   Chrome trace JSON)
+//   print-cache, print-map, stats, memory
+// Empty lines and lines starting with '#' are skipped.
+#define COMMAND_INVALID 0
+#define COMMAND_FIND 1
+#define COMMAND_FIND_SPECIFIC 2
+#define COMMAND_HALT 3
+#define COMMAND_CONTINUE 4
+#define COMMAND_UPDATE 5
+#define COMMAND_DECOMMISSION 6
+#define COMMAND_FURTHEST 7
+#define COMMAND_SWEEP 8
+#define COMMAND_ALTERNATIVES 9
+#define COMMAND_EARLIEST 10
+#define COMMAND_PRINT_CACHE 11
+#define COMMAND_PRINT_MAP 12
+#define COMMAND_STATS 13
+#define COMMAND_MEMORY 14
+#define COMMAND_DELTA 15
+#define COMMAND_TRACE 16
+
+// Bytes read from the input at once
+#define COMMAND_READ_SIZE (64 * 1024)
+// Parsed batches waiting for the executing stage
+#define COMMAND_QUEUE_BATCHES 64
+
+struct FlightCommand
+{
+    int type = COMMAND_INVALID;
+    // Airport and airline names in the order of the command
+    std::vector<std::string> names;
+    // ALPHA, W0 W1, COUNT or DEPARTURE
+    float numbers[2] = {0, 0};
+    // Original text, reported for invalid commands
+    std::string line;
+};
+
+typedef BoundedQueue<std::vector<FlightCommand>> CommandQueue;
+
+// Runs commands on a flight_app. Run pipelines the work: a reader
+// thread reads and parses, the calling thread executes, the output
+// writer (output_writer.h) writes the results. Processors of one app
+// on several threads share a mutex, each batch of commands holds it.
+class CommandProcessor
+{
+private:
+    flight_app &app;
+    std::mutex *appMutex;
+    long executedCount;
+    long invalidCount;
+
+    static void ReadCommands(int fileDescriptor, CommandQueue &queue);
+    static void Trace(const std::string &argument);
+    void ExecuteBatch(const std::vector<FlightCommand> &batch);
+
+public:
+    CommandProcessor(flight_app &app, std::mutex *appMutex = NULL);
+
+    // Empty and comment lines
+    static bool IsSkippedLine(const std::string &line);
+    // False (type COMMAND_INVALID) when the line is not a command
+    static bool ParseCommand(FlightCommand &command, const std::string &line);
+    void Execute(const FlightCommand &command);
+    void ExecuteLine(const std::string &line);
+
+    // Processes the commands of the descriptor until its end, the
+    // results go to outputDescriptor instead of the output writer when
+    // there is one
+    void Run(int fileDescriptor, int outputDescriptor = -1);
+
+    long ExecutedCount() const;
+    long InvalidCount() const;
+};
+
+#endif // COMMAND_PROCESSOR_H
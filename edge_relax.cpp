@@ -0,0 +1,335 @@
+#include "edge_relax.h"
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EDGE_RELAX_X86 1
+#include <immintrin.h>
+#else
+#define EDGE_RELAX_X86 0
+#endif
+
+typedef int (*RelaxFunction)(const float *, const float *, const int *, int,
+                             float, float, const float *, int *, float *);
+typedef int (*RelaxWeightFunction)(const float *, const int *, int,
+                                   float, const float *, int *, float *);
+
+// Implementation picked for the CPU
+struct RelaxKernels
+{
+    const char *name;
+    RelaxFunction blend;
+    RelaxWeightFunction single;
+};
+
+// Same arithmetic as multi_graph::Lerp, results match the scalar kernel
+static int RelaxEdgesScalar(const float *weight0, const float *weight1,
+                            const int *targets, int edgeCount,
+                            float alpha, float distance,
+                            const float *distances,
+                            int *improvedEdges, float *candidates)
+{
+    int count = 0;
+    for (int i = 0; i < edgeCount; i++)
+    {
+        float candidate = distance + (weight0[i] * (1 - alpha) + weight1[i] * alpha);
+        if (candidate < distances[targets[i]])
+        {
+            improvedEdges[count] = i;
+            candidates[count] = candidate;
+            count++;
+        }
+    }
+    return count;
+}
+
+static int RelaxEdgeWeightsScalar(const float *weight, const int *targets, int edgeCount,
+                                  float distance, const float *distances,
+                                  int *improvedEdges, float *candidates)
+{
+    int count = 0;
+    for (int i = 0; i < edgeCount; i++)
+    {
+        float candidate = distance + weight[i];
+        if (candidate < distances[targets[i]])
+        {
+            improvedEdges[count] = i;
+            candidates[count] = candidate;
+            count++;
+        }
+    }
+    return count;
+}
+
+#if EDGE_RELAX_X86
+
+// Remaining edges [begin, edgeCount) of a vectorized loop
+static int RelaxEdgesTail(const float *weight0, const float *weight1,
+                          const int *targets, int begin, int edgeCount,
+                          float alpha, float distance,
+                          const float *distances,
+                          int *improvedEdges, float *candidates)
+{
+    int count = RelaxEdgesScalar(weight0 + begin, weight1 + begin, targets + begin,
+                                 edgeCount - begin, alpha, distance, distances,
+                                 improvedEdges, candidates);
+    for (int k = 0; k < count; k++)
+        improvedEdges[k] += begin;
+    return count;
+}
+
+static int RelaxEdgeWeightsTail(const float *weight, const int *targets,
+                                int begin, int edgeCount,
+                                float distance, const float *distances,
+                                int *improvedEdges, float *candidates)
+{
+    int count = RelaxEdgeWeightsScalar(weight + begin, targets + begin, edgeCount - begin,
+                                       distance, distances, improvedEdges, candidates);
+    for (int k = 0; k < count; k++)
+        improvedEdges[k] += begin;
+    return count;
+}
+
+__attribute__((target("avx2"))) static int RelaxEdgesAvx2(const float *weight0, const float *weight1,
+                                                         const int *targets, int edgeCount,
+                                                         float alpha, float distance,
+                                                         const float *distances,
+                                                         int *improvedEdges, float *candidates)
+{
+    const __m256 oneMinusAlpha = _mm256_set1_ps(1 - alpha);
+    const __m256 alphas = _mm256_set1_ps(alpha);
+    const __m256 base = _mm256_set1_ps(distance);
+
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= edgeCount; i += 8)
+    {
+        __m256 w0 = _mm256_loadu_ps(weight0 + i);
+        __m256 w1 = _mm256_loadu_ps(weight1 + i);
+        __m256 candidate = _mm256_add_ps(base, _mm256_add_ps(_mm256_mul_ps(w0, oneMinusAlpha),
+                                                             _mm256_mul_ps(w1, alphas)));
+
+        __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(targets + i));
+        __m256 current = _mm256_i32gather_ps(distances, index, 4);
+
+        // Only the improving lanes are emitted
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(candidate, current, _CMP_LT_OQ));
+        if (mask == 0)
+            continue;
+
+        float lanes[8];
+        _mm256_storeu_ps(lanes, candidate);
+        while (mask)
+        {
+            int lane = __builtin_ctz(mask);
+            improvedEdges[count] = i + lane;
+            candidates[count] = lanes[lane];
+            count++;
+            mask &= mask - 1;
+        }
+    }
+
+    return count + RelaxEdgesTail(weight0, weight1, targets, i, edgeCount,
+                                  alpha, distance, distances,
+                                  improvedEdges + count, candidates + count);
+}
+
+__attribute__((target("avx2"))) static int RelaxEdgeWeightsAvx2(const float *weight, const int *targets,
+                                                               int edgeCount, float distance,
+                                                               const float *distances,
+                                                               int *improvedEdges, float *candidates)
+{
+    const __m256 base = _mm256_set1_ps(distance);
+
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= edgeCount; i += 8)
+    {
+        __m256 candidate = _mm256_add_ps(base, _mm256_loadu_ps(weight + i));
+
+        __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(targets + i));
+        __m256 current = _mm256_i32gather_ps(distances, index, 4);
+
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(candidate, current, _CMP_LT_OQ));
+        if (mask == 0)
+            continue;
+
+        float lanes[8];
+        _mm256_storeu_ps(lanes, candidate);
+        while (mask)
+        {
+            int lane = __builtin_ctz(mask);
+            improvedEdges[count] = i + lane;
+            candidates[count] = lanes[lane];
+            count++;
+            mask &= mask - 1;
+        }
+    }
+
+    return count + RelaxEdgeWeightsTail(weight, targets, i, edgeCount, distance, distances,
+                                        improvedEdges + count, candidates + count);
+}
+
+__attribute__((target("sse2"))) static int RelaxEdgesSse(const float *weight0, const float *weight1,
+                                                        const int *targets, int edgeCount,
+                                                        float alpha, float distance,
+                                                        const float *distances,
+                                                        int *improvedEdges, float *candidates)
+{
+    const __m128 oneMinusAlpha = _mm_set1_ps(1 - alpha);
+    const __m128 alphas = _mm_set1_ps(alpha);
+    const __m128 base = _mm_set1_ps(distance);
+
+    int count = 0;
+    int i = 0;
+    for (; i + 4 <= edgeCount; i += 4)
+    {
+        __m128 w0 = _mm_loadu_ps(weight0 + i);
+        __m128 w1 = _mm_loadu_ps(weight1 + i);
+        __m128 candidate = _mm_add_ps(base, _mm_add_ps(_mm_mul_ps(w0, oneMinusAlpha),
+                                                       _mm_mul_ps(w1, alphas)));
+
+        // No gather before AVX2
+        __m128 current = _mm_set_ps(distances[targets[i + 3]], distances[targets[i + 2]],
+                                    distances[targets[i + 1]], distances[targets[i]]);
+
+        int mask = _mm_movemask_ps(_mm_cmplt_ps(candidate, current));
+        if (mask == 0)
+            continue;
+
+        float lanes[4];
+        _mm_storeu_ps(lanes, candidate);
+        while (mask)
+        {
+            int lane = __builtin_ctz(mask);
+            improvedEdges[count] = i + lane;
+            candidates[count] = lanes[lane];
+            count++;
+            mask &= mask - 1;
+        }
+    }
+
+    return count + RelaxEdgesTail(weight0, weight1, targets, i, edgeCount,
+                                  alpha, distance, distances,
+                                  improvedEdges + count, candidates + count);
+}
+
+__attribute__((target("sse2"))) static int RelaxEdgeWeightsSse(const float *weight, const int *targets,
+                                                              int edgeCount, float distance,
+                                                              const float *distances,
+                                                              int *improvedEdges, float *candidates)
+{
+    const __m128 base = _mm_set1_ps(distance);
+
+    int count = 0;
+    int i = 0;
+    for (; i + 4 <= edgeCount; i += 4)
+    {
+        __m128 candidate = _mm_add_ps(base, _mm_loadu_ps(weight + i));
+
+        __m128 current = _mm_set_ps(distances[targets[i + 3]], distances[targets[i + 2]],
+                                    distances[targets[i + 1]], distances[targets[i]]);
+
+        int mask = _mm_movemask_ps(_mm_cmplt_ps(candidate, current));
+        if (mask == 0)
+            continue;
+
+        float lanes[4];
+        _mm_storeu_ps(lanes, candidate);
+        while (mask)
+        {
+            int lane = __builtin_ctz(mask);
+            improvedEdges[count] = i + lane;
+            candidates[count] = lanes[lane];
+            count++;
+            mask &= mask - 1;
+        }
+    }
+
+    return count + RelaxEdgeWeightsTail(weight, targets, i, edgeCount, distance, distances,
+                                        improvedEdges + count, candidates + count);
+}
+
+#endif // EDGE_RELAX_X86
+
+// Fastest last
+static std::vector<RelaxKernels> SupportedKernels()
+{
+    std::vector<RelaxKernels> kernels;
+    kernels.push_back({"scalar", RelaxEdgesScalar, RelaxEdgeWeightsScalar});
+#if EDGE_RELAX_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        kernels.push_back({"sse", RelaxEdgesSse, RelaxEdgeWeightsSse});
+    if (__builtin_cpu_supports("avx2"))
+        kernels.push_back({"avx2", RelaxEdgesAvx2, RelaxEdgeWeightsAvx2});
+#endif
+    return kernels;
+}
+
+static const std::vector<RelaxKernels> &AllKernels()
+{
+    // Detected once, thread safe static initialization
+    static const std::vector<RelaxKernels> kernels = SupportedKernels();
+    return kernels;
+}
+
+static const RelaxKernels &SelectedKernels()
+{
+    static const RelaxKernels &kernels = AllKernels().back();
+    return kernels;
+}
+
+int RelaxEdges(const float *weight0, const float *weight1,
+               const int *targets, int edgeCount,
+               float alpha, float distance,
+               const float *distances,
+               int *improvedEdges, float *candidates)
+{
+    return SelectedKernels().blend(weight0, weight1, targets, edgeCount,
+                                   alpha, distance, distances,
+                                   improvedEdges, candidates);
+}
+
+int RelaxEdgeWeights(const float *weight, const int *targets, int edgeCount,
+                     float distance, const float *distances,
+                     int *improvedEdges, float *candidates)
+{
+    return SelectedKernels().single(weight, targets, edgeCount, distance, distances,
+                                    improvedEdges, candidates);
+}
+
+const char *RelaxEdgesImplementation()
+{
+    return SelectedKernels().name;
+}
+
+int RelaxEdgesImplementationCount()
+{
+    return static_cast<int>(AllKernels().size());
+}
+
+const char *RelaxEdgesImplementationName(int implementation)
+{
+    return AllKernels()[implementation].name;
+}
+
+int RelaxEdgesUsing(int implementation,
+                    const float *weight0, const float *weight1,
+                    const int *targets, int edgeCount,
+                    float alpha, float distance,
+                    const float *distances,
+                    int *improvedEdges, float *candidates)
+{
+    return AllKernels()[implementation].blend(weight0, weight1, targets, edgeCount,
+                                              alpha, distance, distances,
+                                              improvedEdges, candidates);
+}
+
+int RelaxEdgeWeightsUsing(int implementation,
+                          const float *weight, const int *targets, int edgeCount,
+                          float distance, const float *distances,
+                          int *improvedEdges, float *candidates)
+{
+    return AllKernels()[implementation].single(weight, targets, edgeCount, distance, distances,
+                                               improvedEdges, candidates);
+}
@@ -0,0 +1,40 @@
+#ifndef EDGE_RELAX_H
+#define EDGE_RELAX_H
+
+// Relaxes the out edges of a single vertex, stored as structure of
+// arrays (weight0[], weight1[], targets[]). Candidate distance of an
+// edge is distance + Lerp(weight0, weight1, alpha). Writes the local
+// indices of the edges that improve their target's distance together
+// with the candidate distances and returns how many were written.
+// Edges are processed 8 (AVX2) or 4 (SSE) at a time when the CPU
+// supports it, the implementation is picked once at startup.
+int RelaxEdges(const float *weight0, const float *weight1,
+               const int *targets, int edgeCount,
+               float alpha, float distance,
+               const float *distances,
+               int *improvedEdges, float *candidates);
+// Same for a single weight (alpha 0 or 1), candidate distance of an
+// edge is distance + weight. Also picked at startup.
+int RelaxEdgeWeights(const float *weight, const int *targets, int edgeCount,
+                     float distance, const float *distances,
+                     int *improvedEdges, float *candidates);
+
+// Name of the selected implementation ("avx2", "sse" or "scalar")
+const char *RelaxEdgesImplementation();
+
+// Implementations the CPU supports, 0 is "scalar" and the last one is
+// the selected one. Run directly to check them against each other.
+int RelaxEdgesImplementationCount();
+const char *RelaxEdgesImplementationName(int implementation);
+int RelaxEdgesUsing(int implementation,
+                    const float *weight0, const float *weight1,
+                    const int *targets, int edgeCount,
+                    float alpha, float distance,
+                    const float *distances,
+                    int *improvedEdges, float *candidates);
+int RelaxEdgeWeightsUsing(int implementation,
+                          const float *weight, const int *targets, int edgeCount,
+                          float distance, const float *distances,
+                          int *improvedEdges, float *candidates);
+
+#endif // EDGE_RELAX_H
@@ -1,58 +1,119 @@
 #include "flight_app.h"
-#include <iostream>
+#include "output_writer.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+
+// Result lines go through the output pipeline. Lines that precede a
+// path are flushed together with it by PrintPath, the others flush.
+
+// "A flight path between "from" and "to" "
+static void AppendBetween(OutputBuffer &out,
+                          const std::string &airportFrom,
+                          const std::string &airportTo)
+{
+    out.Append("A flight path between \"");
+    out.Append(airportFrom);
+    out.Append("\" and \"");
+    out.Append(airportTo);
+    out.Append('"');
+}
 
 void flight_app::PrintCanNotHalt(const std::string &airportFrom,
                                  const std::string &airportTo,
                                  const std::string &airlineName)
 {
-    std::cout << "A flight path between \""
-              << airportFrom << "\" and \""
-              << airportTo << "\" via "
-              << airlineName
-              << " airlines is not found and cannot be halted"
-              << std::endl;
+    OutputBuffer &out = ThreadOutput();
+    AppendBetween(out, airportFrom, airportTo);
+    out.Append(" via ");
+    out.Append(airlineName);
+    out.Append(" airlines is not found and cannot be halted\n");
+    FlushOutput();
 }
 
 void flight_app::PrintCanNotResumeFlight(const std::string &airportFrom,
                                          const std::string &airportTo,
                                          const std::string &airlineName)
 {
-    std::cout << "A flight path between \""
-              << airportFrom << "\" and \""
-              << airportTo << "\" via "
-              << airlineName
-              << " airlines cannot be resumed"
-              << std::endl;
+    OutputBuffer &out = ThreadOutput();
+    AppendBetween(out, airportFrom, airportTo);
+    out.Append(" via ");
+    out.Append(airlineName);
+    out.Append(" airlines cannot be resumed\n");
+    FlushOutput();
+}
+
+void flight_app::PrintCanNotUpdate(const std::string &airportFrom,
+                                   const std::string &airportTo,
+                                   const std::string &airlineName)
+{
+    OutputBuffer &out = ThreadOutput();
+    AppendBetween(out, airportFrom, airportTo);
+    out.Append(" via ");
+    out.Append(airlineName);
+    out.Append(" airlines is not found and cannot be updated\n");
+    FlushOutput();
+}
+
+void flight_app::PrintDeltaApplied(const std::string &deltaPath,
+                                   int appliedCount, int changeCount)
+{
+    OutputBuffer &out = ThreadOutput();
+    out.Append("Delta \"");
+    out.Append(deltaPath);
+    out.Append("\": ");
+    out.AppendInt(appliedCount);
+    out.Append(" of ");
+    out.AppendInt(changeCount);
+    out.Append(" changes applied\n");
+    FlushOutput();
 }
 
 void flight_app::PrintFlightFoundInCache(const std::string &airportFrom,
                                          const std::string &airportTo,
                                          bool isCostWeighted)
 {
-    std::cout << "A flight path between \""
-              << airportFrom << "\" and \""
-              << airportTo << "\" using "
-              << ((isCostWeighted) ? "cost" : "price")
-              << " is found in cache." << std::endl;
+    OutputBuffer &out = ThreadOutput();
+    AppendBetween(out, airportFrom, airportTo);
+    out.Append(" using ");
+    out.Append((isCostWeighted) ? "cost" : "price");
+    out.Append(" is found in cache.\n");
 }
 
 void flight_app::PrintFlightCalculated(const std::string &airportFrom,
                                        const std::string &airportTo,
                                        bool isCostWeighted)
 {
-    std::cout << "A flight path is calculated between \""
-              << airportFrom << "\" and \""
-              << airportTo << "\" using "
-              << ((isCostWeighted) ? "cost" : "price")
-              << "." << std::endl;
+    OutputBuffer &out = ThreadOutput();
+    out.Append("A flight path is calculated between \"");
+    out.Append(airportFrom);
+    out.Append("\" and \"");
+    out.Append(airportTo);
+    out.Append("\" using ");
+    out.Append((isCostWeighted) ? "cost" : "price");
+    out.Append(".\n");
 }
 
 void flight_app::PrintPathDontExist(const std::string &airportFrom,
                                     const std::string &airportTo)
 {
-    std::cout << "A flight path does not exists between \""
-              << airportFrom << "\" and \""
-              << airportTo << "\"." << std::endl;
+    OutputBuffer &out = ThreadOutput();
+    out.Append("A flight path does not exists between \"");
+    out.Append(airportFrom);
+    out.Append("\" and \"");
+    out.Append(airportTo);
+    out.Append("\".\n");
+    FlushOutput();
+}
+
+void flight_app::PrintAlphaRange(float alphaFrom, float alphaTo)
+{
+    OutputBuffer &out = ThreadOutput();
+    out.Append("For alpha between ");
+    out.AppendFloat(alphaFrom);
+    out.Append(" and ");
+    out.AppendFloat(alphaTo);
+    out.Append(":\n");
 }
 
 void flight_app::PrintMap()
@@ -65,11 +126,181 @@ void flight_app::PrintCache()
     lruTable.PrintTable();
 }
 
+void flight_app::PrintCacheStatistics()
+{
+    lruTable.PrintStatistics();
+}
+
+void flight_app::PrintMemoryUsage()
+{
+    GraphMemoryUsage usage;
+    navigationMap.MemoryUsage(usage);
+
+    size_t sweepBytes = 0;
+    std::map<std::pair<int, int>, std::vector<ParametricPath>>::const_iterator it;
+    for (it = sweepCache.begin(); it != sweepCache.end(); ++it)
+    {
+        sweepBytes += it->second.capacity() * sizeof(ParametricPath);
+        for (size_t i = 0; i < it->second.size(); i++)
+            sweepBytes += it->second[i].orderedVertexEdgeIndexList.capacity() * sizeof(int);
+    }
+
+    size_t cacheBytes = lruTable.MemoryBytes();
+    size_t totalBytes = usage.totalBytes + cacheBytes + treeCacheBytes + sweepBytes;
+
+    OutputBuffer &out = ThreadOutput();
+    out.AppendFormat("Vertices %zu\n", usage.vertexBytes);
+    out.AppendFormat("Edges %zu\n", usage.edgeBytes);
+    out.AppendFormat("Edge names %zu\n", usage.edgeNameBytes);
+    out.AppendFormat("Search index %zu\n", usage.searchIndexBytes);
+    out.AppendFormat("Landmarks %zu\n", usage.landmarkBytes);
+    out.AppendFormat("Connections %zu\n", usage.connectionBytes);
+    out.AppendFormat("Hot trees %zu\n", usage.hotTreeBytes);
+    out.AppendFormat("Reachability %zu\n", usage.reachabilityBytes);
+    out.AppendFormat("Regions %zu\n", usage.regionBytes);
+    out.AppendFormat("Route cache %zu\n", cacheBytes);
+    out.AppendFormat("Search trees %zu\n", treeCacheBytes);
+    out.AppendFormat("Sweeps %zu\n", sweepBytes);
+    out.AppendFormat("Total %zu bytes\n", totalBytes);
+    FlushOutput();
+}
+
 flight_app::flight_app(const std::string &flightMapPath)
-    : navigationMap(flightMapPath)
+    : navigationMap(flightMapPath), alphaGranularity(ALPHA_GRANULARITY),
+      treeCacheBudget(TREE_CACHE_BUDGET), treeCacheBytes(0)
 {
 }
 
+flight_app::flight_app(const flight_app &base)
+    : lruTable(base.lruTable), navigationMap(base.navigationMap),
+      haltedFlights(base.haltedFlights), alphaGranularity(base.alphaGranularity),
+      sweepCache(base.sweepCache), sweepOrder(base.sweepOrder),
+      treeCacheBudget(base.treeCacheBudget), treeCacheBytes(0)
+{
+}
+
+int flight_app::AlphaBucket(float alpha) const
+{
+    return static_cast<int>(std::lround(alpha * alphaGranularity));
+}
+
+unsigned int flight_app::AirlineFingerprint(const std::vector<std::string> &airlineNames)
+{
+    if (airlineNames.empty())
+        return 0;
+
+    // Order and duplicates of the list do not change the filter
+    std::vector<std::string> names(airlineNames);
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    // FNV-1a over the names
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        for (size_t k = 0; k < names[i].size(); k++)
+        {
+            hash ^= static_cast<unsigned char>(names[i][k]);
+            hash *= 16777619u;
+        }
+        // Zero byte between the names (xor with 0 is a no-op)
+        hash *= 16777619u;
+    }
+
+    // 0 is reserved for the unfiltered searches
+    return (hash == 0) ? 1 : hash;
+}
+
+void flight_app::PartitionAirports(int regionSize)
+{
+    // Routes keep their cost, the cached ones stay valid
+    navigationMap.PartitionRegions(regionSize);
+}
+
+void flight_app::SetAlphaGranularity(int granularity)
+{
+    if (granularity < 1)
+        granularity = 1;
+    if (granularity == alphaGranularity)
+        return;
+
+    // Buckets of the cached routes mean something else now
+    alphaGranularity = granularity;
+    lruTable.InvalidateTable();
+    InvalidateTrees();
+}
+
+void flight_app::SetCompactWeights(float maxError)
+{
+    // Cached routes may be off by more than the new bound
+    navigationMap.SetCompactWeights(maxError);
+    lruTable.InvalidateTable();
+    InvalidateTrees();
+    InvalidateSweeps();
+}
+
+void flight_app::SetTreeCacheBudget(size_t byteCount)
+{
+    treeCacheBudget = byteCount;
+    TrimTrees();
+}
+
+size_t flight_app::TreeBytes(const SearchTree &tree)
+{
+    return (tree.prevVertices.capacity() + tree.prevEdges.capacity()) * sizeof(int);
+}
+
+bool flight_app::FindTreePath(std::vector<int> &path, int startIndex, int endIndex,
+                              int alphaBucket, float alpha)
+{
+    std::pair<int, int> key(startIndex, alphaBucket);
+    std::map<std::pair<int, int>, SearchTree>::const_iterator it = treeCache.find(key);
+    if (it == treeCache.end() || it->second.alpha != alpha ||
+        !navigationMap.SearchTreePath(path, it->second, endIndex))
+        return false;
+
+    treeOrder.erase(std::find(treeOrder.begin(), treeOrder.end(), key));
+    treeOrder.push_back(key);
+    return true;
+}
+
+void flight_app::TrimTrees()
+{
+    while (treeCacheBytes > treeCacheBudget && !treeOrder.empty())
+    {
+        treeCacheBytes -= TreeBytes(treeCache[treeOrder.front()]);
+        treeCache.erase(treeOrder.front());
+        treeOrder.pop_front();
+    }
+}
+
+void flight_app::InvalidateTrees()
+{
+    treeCache.clear();
+    treeOrder.clear();
+    treeCacheBytes = 0;
+}
+
+void flight_app::InvalidateTreesUsingEdge(int vertexIndex, int edgeIndex)
+{
+    for (size_t t = 0; t < treeOrder.size();)
+    {
+        const SearchTree &tree = treeCache[treeOrder[t]];
+        bool isUsed = false;
+        for (size_t i = 0; i < tree.prevEdges.size() && !isUsed; i++)
+            isUsed = tree.prevVertices[i] == vertexIndex && tree.prevEdges[i] == edgeIndex;
+
+        if (isUsed)
+        {
+            treeCacheBytes -= TreeBytes(tree);
+            treeCache.erase(treeOrder[t]);
+            treeOrder.erase(treeOrder.begin() + t);
+        }
+        else
+            t++;
+    }
+}
+
 
 void flight_app::HaltFlight(const std::string &airportFrom,
                             const std::string &airportTo,
@@ -82,12 +313,19 @@ void flight_app::HaltFlight(const std::string &airportFrom,
         removable.airline = airlineName;
         removable.airportFrom = airportFrom;
         removable.airportTo = airportTo;
-        removable.w0 = navigationMap.getEdge(airlineName, airportFrom, airportTo).weight[0];
-        removable.w1 = navigationMap.getEdge(airlineName, airportFrom, airportTo).weight[1];
+        GraphEdge edge = navigationMap.getEdge(airlineName, airportFrom, airportTo);
+        removable.w0 = edge.weight[0];
+        removable.w1 = edge.weight[1];
+        removable.departures = edge.departures;
 
         navigationMap.RemoveEdge(airlineName, airportFrom, airportTo);
 
         haltedFlights.push_back(removable);
+        InvalidateSweeps();
+        InvalidateTrees();
+
+        // Edge indices of the source airport shifted
+        lruTable.InvalidateVertices(std::vector<int>(1, navigationMap.getVertexIndex(airportFrom)));
     }
 
     catch (struct VertexNotFoundException)
@@ -113,8 +351,31 @@ void flight_app::ContinueFlight(const std::string &airportFrom,
 
             if (haltedFlights[i].airline == airlineName && haltedFlights[i].airportFrom == airportFrom && haltedFlights[i].airportTo == airportTo)
             {
-                navigationMap.AddEdge(airlineName, airportFrom, airportTo, haltedFlights[i].w0, haltedFlights[i].w1);
+                // A new flight for the caches, like an added one of a delta
+                std::vector<GraphChange> changes(1);
+                changes[0].type = GRAPH_CHANGE_ADD_EDGE;
+                changes[0].vertexFromName = airportFrom;
+                changes[0].vertexToName = airportTo;
+                changes[0].edgeName = airlineName;
+                changes[0].values[0] = haltedFlights[i].w0;
+                changes[0].values[1] = haltedFlights[i].w1;
+                GraphChangeResult result;
+                navigationMap.ApplyChanges(changes, result);
+                if (!result.isApplied[0])
+                    break;
+
+                const std::vector<FlightDeparture> &departures = haltedFlights[i].departures;
+                for (size_t d = 0; d < departures.size(); d++)
+                {
+                    navigationMap.AddDeparture(airlineName, airportFrom, airportTo,
+                                               departures[d].departureTime,
+                                               departures[d].arrivalTime);
+                }
+                // Back on the map, a later halt saves it again
+                haltedFlights.erase(haltedFlights.begin() + i);
                 flag = false;
+                InvalidateSweeps();
+                InvalidateStaleRoutes(result);
                 break;
             }
         }
@@ -134,55 +395,739 @@ void flight_app::ContinueFlight(const std::string &airportFrom,
     }
 }
 
+const std::vector<ParametricPath> *flight_app::FindSweep(int startIndex, int endIndex) const
+{
+    std::map<std::pair<int, int>, std::vector<ParametricPath>>::const_iterator it =
+        sweepCache.find(std::make_pair(startIndex, endIndex));
+    if (it == sweepCache.end())
+        return NULL;
+    return &it->second;
+}
+
+void flight_app::InvalidateSweeps()
+{
+    sweepCache.clear();
+    sweepOrder.clear();
+}
+
+void flight_app::UpdateFlightWeights(const std::string &airportFrom,
+                                     const std::string &airportTo,
+                                     const std::string &airlineName,
+                                     float w0, float w1)
+{
+    try
+    {
+        GraphEdge edge = navigationMap.getEdge(airlineName, airportFrom, airportTo);
+        int edgeIndex = navigationMap.UpdateEdgeWeights(airlineName, airportFrom, airportTo, w0, w1);
+        InvalidateSweeps();
+
+        if (w0 >= edge.weight[0] && w1 >= edge.weight[1])
+        {
+            // Costlier for every alpha, only routes over the flight suffer
+            int vertexIndex = navigationMap.getVertexIndex(airportFrom);
+            lruTable.InvalidateEdge(vertexIndex, edgeIndex);
+            InvalidateTreesUsingEdge(vertexIndex, edgeIndex);
+        }
+        else
+        {
+            // Any route may now be beaten through the flight
+            lruTable.InvalidateTable();
+            InvalidateTrees();
+        }
+        return;
+    }
+    catch (struct VertexNotFoundException)
+    {
+    }
+    catch (struct EdgeNotFoundException)
+    {
+    }
+
+    for (size_t i = 0; i < haltedFlights.size(); i++)
+    {
+        if (haltedFlights[i].airline == airlineName && haltedFlights[i].airportFrom == airportFrom && haltedFlights[i].airportTo == airportTo)
+        {
+            haltedFlights[i].w0 = w0;
+            haltedFlights[i].w1 = w1;
+            return;
+        }
+    }
+
+    PrintCanNotUpdate(airportFrom, airportTo, airlineName);
+}
+
+void flight_app::RegisterHotOrigin(const std::string &airportName, float alpha)
+{
+    try
+    {
+        navigationMap.RegisterHotOrigin(airportName, alpha);
+    }
+    catch (struct VertexNotFoundException)
+    {
+        // Unknown airports have no routes to keep
+    }
+}
+
+void flight_app::DecommissionAirport(const std::string &airportName)
+{
+    std::vector<int> affectedVertices;
+    navigationMap.RemoveVertex(airportName, affectedVertices);
+    InvalidateSweeps();
+    InvalidateTrees();
+
+    // Cached paths through the airport, or through an airport whose
+    // edge indices shifted, are no longer valid
+    lruTable.InvalidateVertices(affectedVertices);
+
+    // Halted flights of the airport can not be resumed anymore
+    for (size_t i = 0; i < haltedFlights.size();)
+    {
+        if (haltedFlights[i].airportFrom == airportName ||
+            haltedFlights[i].airportTo == airportName)
+            haltedFlights.erase(haltedFlights.begin() + i);
+        else
+            i++;
+    }
+
+    CompactAirports();
+}
+
+void flight_app::CompactAirports()
+{
+    // Periodic compaction, remaps the cached paths in the same pass
+    int removedCount = navigationMap.RemovedVertexCount();
+    if (removedCount * COMPACTION_RATIO > navigationMap.VertexCount() + removedCount)
+    {
+        std::vector<int> oldToNewIndex;
+        navigationMap.CompactVertices(oldToNewIndex);
+        lruTable.RemapVertices(oldToNewIndex);
+    }
+}
+
+bool flight_app::IsRouteStale(const HashData &entry, const GraphChangeResult &result,
+                              const std::vector<char> &isShifted,
+                              const std::vector<std::pair<int, int>> &costlierEdges) const
+{
+    // Vertices are on the even positions of the path, each followed by
+    // the local index of the edge taken
+    const std::vector<int> &path = entry.intArray;
+    for (size_t k = 0; k < path.size(); k += 2)
+    {
+        if (isShifted[path[k]])
+            return true;
+        if (k + 1 < path.size() &&
+            std::binary_search(costlierEdges.begin(), costlierEdges.end(),
+                               std::make_pair(path[k], path[k + 1])))
+            return true;
+    }
+
+    if (result.cheaperEdges.empty())
+        return false;
+
+    // A route that beats this one at an alpha of its range takes a
+    // cheaper flight, so it costs at least that flight there and its ends
+    // reach the flight's airports. Costs are linear in alpha, the ends of
+    // the range cover the alphas in between.
+    FlightItinerary fromItinerary;
+    FlightItinerary toItinerary;
+    navigationMap.MakeItinerary(fromItinerary, path, entry.alphaFrom);
+    navigationMap.MakeItinerary(toItinerary, path, entry.alphaTo);
+    for (size_t i = 0; i < result.cheaperEdges.size(); i++)
+    {
+        const GraphEdgeChange &edge = result.cheaperEdges[i];
+        float fromCost = edge.weight0 * (1 - entry.alphaFrom) + edge.weight1 * entry.alphaFrom;
+        float toCost = edge.weight0 * (1 - entry.alphaTo) + edge.weight1 * entry.alphaTo;
+        if ((fromCost < fromItinerary.totalCost || toCost < toItinerary.totalCost) &&
+            navigationMap.MayReach(entry.startInt, edge.vertexFromIndex) &&
+            navigationMap.MayReach(edge.vertexToIndex, entry.endInt))
+            return true;
+    }
+    return false;
+}
+
+int flight_app::ApplyChanges(const std::vector<GraphChange> &changes)
+{
+    GraphChangeResult result;
+    navigationMap.ApplyChanges(changes, result);
+
+    // Halted flights are not on the map, the changes of their airports
+    // and flights apply to them here
+    int appliedCount = result.appliedCount;
+    for (size_t c = 0; c < changes.size(); c++)
+    {
+        const GraphChange &change = changes[c];
+        if (change.type == GRAPH_CHANGE_REMOVE_VERTEX)
+        {
+            if (!result.isApplied[c])
+                continue;
+            for (size_t i = 0; i < haltedFlights.size();)
+            {
+                if (haltedFlights[i].airportFrom == change.vertexFromName ||
+                    haltedFlights[i].airportTo == change.vertexFromName)
+                    haltedFlights.erase(haltedFlights.begin() + i);
+                else
+                    i++;
+            }
+            continue;
+        }
+        // Added flights were applied to the map, the others were not
+        // found there
+        if (change.type == GRAPH_CHANGE_ADD_VERTEX ||
+            (change.type == GRAPH_CHANGE_ADD_EDGE) != static_cast<bool>(result.isApplied[c]))
+            continue;
+
+        bool isHalted = false;
+        for (size_t i = 0; i < haltedFlights.size();)
+        {
+            HaltedFlight &flight = haltedFlights[i];
+            if (flight.airline != change.edgeName || flight.airportFrom != change.vertexFromName ||
+                flight.airportTo != change.vertexToName)
+            {
+                i++;
+                continue;
+            }
+
+            // Added again or removed, the halted copy goes
+            isHalted = true;
+            if (change.type == GRAPH_CHANGE_ADD_EDGE || change.type == GRAPH_CHANGE_REMOVE_EDGE)
+            {
+                haltedFlights.erase(haltedFlights.begin() + i);
+                continue;
+            }
+            if (change.type == GRAPH_CHANGE_UPDATE_EDGE)
+            {
+                flight.w0 = change.values[0];
+                flight.w1 = change.values[1];
+            }
+            else
+            {
+                FlightDeparture departure;
+                departure.departureTime = change.values[0];
+                departure.arrivalTime = change.values[1];
+                flight.departures.push_back(departure);
+            }
+            i++;
+        }
+        if (isHalted && change.type != GRAPH_CHANGE_ADD_EDGE)
+            appliedCount++;
+    }
+
+    if (result.appliedCount == 0)
+        return appliedCount;
+
+    InvalidateSweeps();
+    InvalidateStaleRoutes(result);
+    CompactAirports();
+    return appliedCount;
+}
+
+void flight_app::InvalidateStaleRoutes(const GraphChangeResult &result)
+{
+    // One pass over the cached routes for the whole batch
+    std::vector<char> isShifted(navigationMap.VertexCount() + navigationMap.RemovedVertexCount(), 0);
+    for (size_t i = 0; i < result.shiftedVertices.size(); i++)
+        isShifted[result.shiftedVertices[i]] = 1;
+    std::vector<std::pair<int, int>> costlierEdges;
+    for (size_t i = 0; i < result.costlierEdges.size(); i++)
+        costlierEdges.push_back(std::make_pair(result.costlierEdges[i].vertexFromIndex,
+                                               result.costlierEdges[i].edgeIndex));
+    std::sort(costlierEdges.begin(), costlierEdges.end());
+
+    lruTable.InvalidateIf([&](const HashData &entry)
+                          { return IsRouteStale(entry, result, isShifted, costlierEdges); });
+
+    if (result.shiftedVertices.empty() && result.cheaperEdges.empty())
+    {
+        for (size_t i = 0; i < costlierEdges.size(); i++)
+            InvalidateTreesUsingEdge(costlierEdges[i].first, costlierEdges[i].second);
+    }
+    else
+        InvalidateTrees();
+}
+
+void flight_app::ApplyDelta(const std::string &deltaPath)
+{
+    TRACE_SCOPE("ApplyDelta");
+    std::vector<GraphChange> changes;
+    {
+        TRACE_SCOPE("read delta");
+        if (!multi_graph::ReadDelta(changes, deltaPath))
+            return;
+    }
+
+    int appliedCount = ApplyChanges(changes);
+    PrintDeltaApplied(deltaPath, appliedCount, static_cast<int>(changes.size()));
+}
+
+void flight_app::ReorderAirports()
+{
+    // Cached routes are remapped, trees and sweeps are keyed by index
+    std::vector<int> oldToNewIndex;
+    navigationMap.ReorderVertices(oldToNewIndex);
+    lruTable.RemapVertices(oldToNewIndex);
+    InvalidateTrees();
+    InvalidateSweeps();
+}
+
+void flight_app::PrepareLandmarks(int landmarkCount, const std::string &landmarkPath)
+{
+    // Reuse the tables stored next to the map when they still match it
+    if (navigationMap.LoadLandmarks(landmarkPath) &&
+        navigationMap.LandmarkCount() == landmarkCount)
+        return;
+
+    navigationMap.BuildLandmarks(landmarkCount);
+    navigationMap.SaveLandmarks(landmarkPath);
+}
+
+bool flight_app::CachedRoute(std::vector<int> &path,
+                             const std::string &startAirportName,
+                             const std::string &endAirportName,
+                             int startIndex, int endIndex, float alpha,
+                             bool isProbed)
+{
+    // Cached routes of the bucket answer the alphas they are known to
+    // be shortest for
+    int alphaBucket = AlphaBucket(alpha);
+    if (!isProbed && lruTable.Find(path, startIndex, endIndex, alphaBucket, 0, true, alpha))
+        return true;
+
+    // Prefix of a cached route, a retained tree of the airport or the
+    // maintained tree of a hot origin
+    if (lruTable.FindPrefix(path, startIndex, endIndex, alphaBucket, 0, alpha) ||
+        FindTreePath(path, startIndex, endIndex, alphaBucket, alpha) ||
+        navigationMap.HotOriginPath(path, startAirportName, endAirportName, alpha))
+    {
+        lruTable.Insert(path, alphaBucket, 0, alpha, alpha);
+        return true;
+    }
+
+    // A cached sweep answers any alpha without searching, its segment
+    // is shortest over the segment's whole range
+    const std::vector<ParametricPath> *sweep = FindSweep(startIndex, endIndex);
+    if (sweep)
+    {
+        size_t i = 0;
+        while (alpha > (*sweep)[i].alphaTo && i + 1 < sweep->size())
+            i++;
+        path = (*sweep)[i].orderedVertexEdgeIndexList;
+        lruTable.Insert(path, alphaBucket, 0, (*sweep)[i].alphaFrom, (*sweep)[i].alphaTo);
+        return true;
+    }
+    return false;
+}
+
+bool flight_app::CachedSpecificRoute(std::vector<int> &path, int startIndex, int endIndex,
+                                     float alpha, unsigned int fingerprint)
+{
+    int alphaBucket = AlphaBucket(alpha);
+    if (lruTable.Find(path, startIndex, endIndex, alphaBucket, fingerprint, true, alpha))
+        return true;
+
+    // Prefix of a cached route with the same exclusions
+    if (lruTable.FindPrefix(path, startIndex, endIndex, alphaBucket, fingerprint, alpha))
+    {
+        lruTable.Insert(path, alphaBucket, fingerprint, alpha, alpha);
+        return true;
+    }
+    return false;
+}
+
+bool flight_app::RouteFlight(std::vector<int> &path, bool &isCacheHit,
+                             const std::string &startAirportName,
+                             const std::string &endAirportName,
+                             int startIndex, int endIndex, float alpha,
+                             bool isProbed)
+{
+    {
+        TRACE_SCOPE("cache lookup");
+        isCacheHit = true;
+        if (CachedRoute(path, startAirportName, endAirportName, startIndex, endIndex, alpha, isProbed))
+            return true;
+    }
+
+    isCacheHit = false;
+    int alphaBucket = AlphaBucket(alpha);
+
+    // The search extends the airport's tree with what it settles (a
+    // tree of another alpha of the bucket starts over)
+    SearchTree *tree = NULL;
+    std::pair<int, int> treeKey(startIndex, alphaBucket);
+    if (treeCacheBudget > 0)
+    {
+        if (treeCache.find(treeKey) == treeCache.end())
+            treeOrder.push_back(treeKey);
+        tree = &treeCache[treeKey];
+        treeCacheBytes -= TreeBytes(*tree);
+    }
+
+    // Partitioned maps search over the region boundaries, a retained
+    // tree needs the whole search
+    TRACE_SCOPE("search");
+    bool indicator;
+    if (!tree && navigationMap.RegionCount() > 0)
+        indicator = navigationMap.RegionShortestPath(path, startAirportName, endAirportName, alpha);
+    else
+        indicator = navigationMap.HeuristicShortestPath(path, startAirportName, endAirportName,
+                                                        alpha, tree);
+    if (tree)
+    {
+        treeCacheBytes += TreeBytes(*tree);
+        TrimTrees();
+    }
+
+    if (indicator)
+        lruTable.Insert(path, alphaBucket, 0, alpha, alpha);
+    return indicator;
+}
+
 void flight_app::FindFlight(const std::string &startAirportName,
                             const std::string &endAirportName,
                             float alpha)
 {
+    TRACE_SCOPE("FindFlight");
+    int startIndex, endIndex;
+    try
+    {
+        TRACE_SCOPE("name lookup");
+        startIndex = navigationMap.getVertexIndex(startAirportName);
+        endIndex = navigationMap.getVertexIndex(endAirportName);
+    }
+    catch (struct VertexNotFoundException)
+    {
+        PrintPathDontExist(startAirportName, endAirportName);
+        return;
+    }
+
     std::vector<int> path;
-    bool indicator = navigationMap.HeuristicShortestPath(path, startAirportName, endAirportName, alpha);
+    bool isCacheHit;
+    if (!RouteFlight(path, isCacheHit, startAirportName, endAirportName,
+                     startIndex, endIndex, alpha))
+    {
+        PrintPathDontExist(startAirportName, endAirportName);
+        return;
+    }
 
+    // Only the cost and price routes say where they came from
     if (alpha == 0 || alpha == 1)
     {
-        if (lruTable.Find(path, navigationMap.getVertexIndex(startAirportName), navigationMap.getVertexIndex(endAirportName), 1 - alpha, true))
+        if (isCacheHit)
+            PrintFlightFoundInCache(startAirportName, endAirportName, alpha == 0);
+        else
+            PrintFlightCalculated(startAirportName, endAirportName, alpha == 0);
+    }
+    navigationMap.PrintPath(path, alpha, true);
+}
+
+bool flight_app::FindFlight(FlightItinerary &itinerary,
+                            const std::string &startAirportName,
+                            const std::string &endAirportName,
+                            float alpha)
+{
+    TRACE_SCOPE("FindFlight");
+    int startIndex, endIndex;
+    try
+    {
+        TRACE_SCOPE("name lookup");
+        startIndex = navigationMap.getVertexIndex(startAirportName);
+        endIndex = navigationMap.getVertexIndex(endAirportName);
+    }
+    catch (struct VertexNotFoundException)
+    {
+        return false;
+    }
+
+    std::vector<int> path;
+    bool isCacheHit;
+    if (!RouteFlight(path, isCacheHit, startAirportName, endAirportName,
+                     startIndex, endIndex, alpha))
+        return false;
+
+    navigationMap.MakeItinerary(itinerary, path, alpha);
+    itinerary.isCacheHit = isCacheHit;
+    return true;
+}
+
+int flight_app::FindFlights(std::vector<FlightItinerary> &itineraries,
+                            std::vector<char> &isFound,
+                            const std::vector<FlightQuery> &queries)
+{
+    TRACE_SCOPE("FindFlights");
+    itineraries.assign(queries.size(), FlightItinerary());
+    isFound.assign(queries.size(), 0);
+
+    // Unknown airports do not reach the cache, as in FindFlight
+    std::vector<HashKey> keys;
+    std::vector<size_t> queryIndices;
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        HashKey key;
+        try
         {
-            PrintFlightFoundInCache(startAirportName, endAirportName, 1 - alpha);
-            navigationMap.PrintPath(path, alpha, true);
-            return;
+            key.startInt = navigationMap.getVertexIndex(queries[i].startAirportName);
+            key.endInt = navigationMap.getVertexIndex(queries[i].endAirportName);
         }
-        if (indicator)
+        catch (struct VertexNotFoundException)
         {
-            lruTable.Insert(path, 1 - alpha);
+            continue;
+        }
+        key.alphaBucket = AlphaBucket(queries[i].alpha);
+        key.filterFingerprint = 0;
+        key.alpha = queries[i].alpha;
+        keys.push_back(key);
+        queryIndices.push_back(i);
+    }
 
-            PrintFlightCalculated(startAirportName, endAirportName, 1 - alpha);
-            navigationMap.PrintPath(path, alpha, true);
-            return;
+    std::vector<std::vector<int>> paths;
+    std::vector<char> isCached;
+    lruTable.FindBatch(paths, isCached, keys, true);
+
+    // A route the batch searched answers its repeats, the probe could
+    // not see it
+    std::map<std::pair<std::pair<int, int>, float>, size_t> searched;
+    int foundCount = 0;
+    for (size_t k = 0; k < keys.size(); k++)
+    {
+        size_t i = queryIndices[k];
+        const FlightQuery &query = queries[i];
+        bool isCacheHit = true;
+        if (!isCached[k])
+        {
+            std::pair<std::pair<int, int>, float> searchKey(std::make_pair(keys[k].startInt, keys[k].endInt),
+                                                            keys[k].alpha);
+            std::map<std::pair<std::pair<int, int>, float>, size_t>::iterator it = searched.find(searchKey);
+            if (it != searched.end())
+            {
+                size_t first = it->second;
+                if (!isFound[queryIndices[first]])
+                    continue;
+                paths[k] = paths[first];
+            }
+            else
+            {
+                searched[searchKey] = k;
+                if (!RouteFlight(paths[k], isCacheHit, query.startAirportName, query.endAirportName,
+                                 keys[k].startInt, keys[k].endInt, query.alpha, true))
+                    continue;
+            }
         }
+
+        navigationMap.MakeItinerary(itineraries[i], paths[k], query.alpha);
+        itineraries[i].isCacheHit = isCacheHit;
+        isFound[i] = 1;
+        foundCount++;
+    }
+    return foundCount;
+}
+
+void flight_app::FindFlightSweep(const std::string &startAirportName,
+                                 const std::string &endAirportName)
+{
+    std::vector<ParametricPath> paths;
+    if (!navigationMap.ParametricShortestPaths(paths, startAirportName, endAirportName))
+    {
+        PrintPathDontExist(startAirportName, endAirportName);
+        return;
+    }
+
+    // Cached as a unit, oldest pair goes first
+    std::pair<int, int> key(navigationMap.getVertexIndex(startAirportName),
+                            navigationMap.getVertexIndex(endAirportName));
+    if (sweepCache.find(key) == sweepCache.end())
+    {
+        if (sweepOrder.size() >= SWEEP_CACHE_SIZE)
+        {
+            sweepCache.erase(sweepOrder.front());
+            sweepOrder.pop_front();
+        }
+        sweepOrder.push_back(key);
+    }
+    sweepCache[key] = paths;
+
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        PrintAlphaRange(paths[i].alphaFrom, paths[i].alphaTo);
+        navigationMap.PrintPath(paths[i].orderedVertexEdgeIndexList,
+                                0.5f * (paths[i].alphaFrom + paths[i].alphaTo), true);
+    }
+}
+
+bool flight_app::RouteSpecificFlight(std::vector<int> &path, bool &isCacheHit,
+                                     const std::string &startAirportName,
+                                     const std::string &endAirportName,
+                                     int startIndex, int endIndex, float alpha,
+                                     const std::vector<std::string> &unwantedAirlineNames)
+{
+    unsigned int fingerprint = AirlineFingerprint(unwantedAirlineNames);
+    {
+        TRACE_SCOPE("cache lookup");
+        isCacheHit = true;
+        if (CachedSpecificRoute(path, startIndex, endIndex, alpha, fingerprint))
+            return true;
     }
 
+    isCacheHit = false;
+
+    TRACE_SCOPE("search");
+    bool indicator = navigationMap.FilteredShortestPath(path, startAirportName, endAirportName,
+                                                        alpha, unwantedAirlineNames);
     if (indicator)
+        lruTable.Insert(path, AlphaBucket(alpha), fingerprint, alpha, alpha);
+    return indicator;
+}
+
+void flight_app::FindSpecificFlight(const std::string &startAirportName,
+                                    const std::string &endAirportName,
+                                    float alpha,
+                                    const std::vector<std::string> &unwantedAirlineNames)
+{
+    TRACE_SCOPE("FindSpecificFlight");
+    int startIndex, endIndex;
+    try
     {
-        navigationMap.PrintPath(path, alpha, true);
+        TRACE_SCOPE("name lookup");
+        startIndex = navigationMap.getVertexIndex(startAirportName);
+        endIndex = navigationMap.getVertexIndex(endAirportName);
+    }
+    catch (struct VertexNotFoundException)
+    {
+        PrintPathDontExist(startAirportName, endAirportName);
+        return;
     }
 
-    else
+    std::vector<int> path;
+    bool isCacheHit;
+    if (!RouteSpecificFlight(path, isCacheHit, startAirportName, endAirportName,
+                             startIndex, endIndex, alpha, unwantedAirlineNames))
     {
         PrintPathDontExist(startAirportName, endAirportName);
+        return;
     }
+
+    navigationMap.PrintPath(path, alpha, true);
 }
 
-void flight_app::FindSpecificFlight(const std::string &startAirportName,
+bool flight_app::FindSpecificFlight(FlightItinerary &itinerary,
+                                    const std::string &startAirportName,
                                     const std::string &endAirportName,
                                     float alpha,
-                                    const std::vector<std::string> &unwantedAirlineNames) const
+                                    const std::vector<std::string> &unwantedAirlineNames)
+{
+    TRACE_SCOPE("FindSpecificFlight");
+    int startIndex, endIndex;
+    try
+    {
+        TRACE_SCOPE("name lookup");
+        startIndex = navigationMap.getVertexIndex(startAirportName);
+        endIndex = navigationMap.getVertexIndex(endAirportName);
+    }
+    catch (struct VertexNotFoundException)
+    {
+        return false;
+    }
+
+    std::vector<int> path;
+    bool isCacheHit;
+    if (!RouteSpecificFlight(path, isCacheHit, startAirportName, endAirportName,
+                             startIndex, endIndex, alpha, unwantedAirlineNames))
+        return false;
+
+    navigationMap.MakeItinerary(itinerary, path, alpha);
+    itinerary.isCacheHit = isCacheHit;
+    return true;
+}
+
+QueryTask flight_app::FindFlightAsync(FlightItinerary &itinerary,
+                                      std::string startAirportName,
+                                      std::string endAirportName,
+                                      float alpha,
+                                      std::vector<std::string> unwantedAirlineNames,
+                                      CancellationToken token,
+                                      QueryDeadline deadline)
+{
+    int startIndex, endIndex;
+    try
+    {
+        TRACE_SCOPE("name lookup");
+        startIndex = navigationMap.getVertexIndex(startAirportName);
+        endIndex = navigationMap.getVertexIndex(endAirportName);
+    }
+    catch (struct VertexNotFoundException)
+    {
+        startIndex = -1;
+    }
+    if (startIndex == -1)
+        co_return QUERY_NO_ROUTE;
+
+    int alphaBucket = AlphaBucket(alpha);
+    unsigned int fingerprint = AirlineFingerprint(unwantedAirlineNames);
+    std::vector<int> path;
+    bool isCacheHit = fingerprint == 0
+                          ? CachedRoute(path, startAirportName, endAirportName, startIndex, endIndex, alpha)
+                          : CachedSpecificRoute(path, startIndex, endIndex, alpha, fingerprint);
+
+    if (!isCacheHit)
+    {
+        // Retained trees are left out, two suspended searches from the
+        // same airport would extend one tree at once
+        SearchTask search = navigationMap.ResumableShortestPath(path, startAirportName, endAirportName,
+                                                                alpha, unwantedAirlineNames,
+                                                                ASYNC_YIELD_INTERVAL);
+        while (true)
+        {
+            if (token.IsCancelled())
+                co_return QUERY_CANCELLED;
+            if (std::chrono::steady_clock::now() >= deadline)
+                co_return QUERY_TIMED_OUT;
+
+            if (!search.Resume())
+                break;
+            co_await std::suspend_always();
+        }
+
+        if (!search.Result())
+            co_return QUERY_NO_ROUTE;
+        lruTable.Insert(path, alphaBucket, fingerprint, alpha, alpha);
+    }
+
+    navigationMap.MakeItinerary(itinerary, path, alpha);
+    itinerary.isCacheHit = isCacheHit;
+    co_return QUERY_FOUND;
+}
+
+void flight_app::FindAlternativeFlights(const std::string &startAirportName,
+                                        const std::string &endAirportName,
+                                        float alpha, int count) const
 {
- 
+    std::vector<std::vector<int>> paths;
+    bool indicator = navigationMap.KShortestPaths(paths, startAirportName, endAirportName,
+                                                  alpha, count);
 
+    if (indicator)
+    {
+        for (size_t i = 0; i < paths.size(); i++)
+            navigationMap.PrintPath(paths[i], alpha, true);
+    }
+
+    else
+    {
+        PrintPathDontExist(startAirportName, endAirportName);
+    }
+}
+
+void flight_app::FindEarliestFlight(const std::string &startAirportName,
+                                    const std::string &endAirportName,
+                                    float departureTime) const
+{
     std::vector<int> path;
-    bool indicator = navigationMap.FilteredShortestPath(path, startAirportName, endAirportName, alpha, unwantedAirlineNames);
+    std::vector<FlightDeparture> legTimes;
+    bool indicator = navigationMap.EarliestArrivalPath(path, legTimes,
+                                                       startAirportName, endAirportName,
+                                                       departureTime);
 
     if (indicator)
     {
-        navigationMap.PrintPath(path, alpha, true);
+        navigationMap.PrintTimedPath(path, legTimes);
     }
 
     else
@@ -3,8 +3,21 @@
 
 #include "HashTable.h"
 #include "multi_graph.h"
+#include "QueryTask.h"
+#include <map>
+#include <deque>
 
 #define FLIGHT_TABLE_SIZE 29
+// Compact the map once this fraction (1/N) of the airports are removed
+#define COMPACTION_RATIO 4
+// Number of origin/destination pairs with a cached alpha sweep
+#define SWEEP_CACHE_SIZE 64
+// Cached routes are shared by the alphas within 1/N of each other
+#define ALPHA_GRANULARITY 100
+// Bytes of retained search trees, 0 disables them
+#define TREE_CACHE_BUDGET 0
+// Vertices an async search settles between its suspensions
+#define ASYNC_YIELD_INTERVAL 1024
 
 struct HaltedFlight
 {
@@ -13,6 +26,14 @@ struct HaltedFlight
     std::string airline;
     float w0;
     float w1;
+    std::vector<FlightDeparture> departures;
+};
+
+struct FlightQuery
+{
+    std::string startAirportName;
+    std::string endAirportName;
+    float alpha;
 };
 
 class flight_app
@@ -34,19 +55,94 @@ private:
     static void PrintFlightCalculated(const std::string &airportFrom,
                                       const std::string &airportTo,
                                       bool isCostWeighted);
+    static void PrintCanNotUpdate(const std::string &airportFrom,
+                                  const std::string &airportTo,
+                                  const std::string &airlineName);
     static void PrintPathDontExist(const std::string &airportFrom,
                                    const std::string &airportTo);
 
+    static void PrintDeltaApplied(const std::string &deltaPath,
+                                  int appliedCount, int changeCount);
     static void PrintSisterAirlinesDontCover(const std::string &airportFrom);
+    static void PrintAlphaRange(float alphaFrom, float alphaTo);
 
 
     std::vector<HaltedFlight> haltedFlights;
-    
+
+    // Route cache key is (start, end, alpha bucket, airline fingerprint),
+    // a cached route answers the alphas of its bucket it is known to be
+    // shortest for and routes are searched at the exact alpha
+    int alphaGranularity;
+
+    int AlphaBucket(float alpha) const;
+    static unsigned int AirlineFingerprint(const std::vector<std::string> &airlineNames);
+
+    // Piecewise optimal paths over alpha of an (start, end) pair,
+    // answers any alpha. Dropped whenever the map changes.
+    std::map<std::pair<int, int>, std::vector<ParametricPath>> sweepCache;
+    std::deque<std::pair<int, int>> sweepOrder;
+
+    const std::vector<ParametricPath> *FindSweep(int startIndex, int endIndex) const;
+    void InvalidateSweeps();
+
+    // Settled search trees of (start, alpha bucket) at the alpha of the
+    // last search, answer every destination they reached at that alpha. Least recently used goes first once
+    // the trees exceed treeCacheBudget bytes.
+    std::map<std::pair<int, int>, SearchTree> treeCache;
+    std::deque<std::pair<int, int>> treeOrder;
+    size_t treeCacheBudget;
+    size_t treeCacheBytes;
+
+    // Routes that need no search: the route cache, and for unfiltered
+    // routes also the trees, hot origins and sweeps
+    // isProbed skips the route cache (already probed for the route)
+    bool CachedRoute(std::vector<int> &path,
+                     const std::string &startAirportName,
+                     const std::string &endAirportName,
+                     int startIndex, int endIndex, float alpha,
+                     bool isProbed = false);
+    bool CachedSpecificRoute(std::vector<int> &path, int startIndex, int endIndex,
+                             float alpha, unsigned int fingerprint);
+
+    // Shared by the printing and the itinerary variants, isCacheHit is
+    // set when the route came without a search
+    bool RouteFlight(std::vector<int> &path, bool &isCacheHit,
+                     const std::string &startAirportName,
+                     const std::string &endAirportName,
+                     int startIndex, int endIndex, float alpha,
+                     bool isProbed = false);
+    bool RouteSpecificFlight(std::vector<int> &path, bool &isCacheHit,
+                             const std::string &startAirportName,
+                             const std::string &endAirportName,
+                             int startIndex, int endIndex, float alpha,
+                             const std::vector<std::string> &unwantedAirlineNames);
+
+    static size_t TreeBytes(const SearchTree &tree);
+    bool FindTreePath(std::vector<int> &path, int startIndex, int endIndex,
+                      int alphaBucket, float alpha);
+    void TrimTrees();
+    void InvalidateTrees();
+    void InvalidateTreesUsingEdge(int vertexIndex, int edgeIndex);
+
+    void CompactAirports();
+    // Whether a batch of changes may have made the cached route invalid
+    // or no longer the cheapest (costlier edges sorted)
+    bool IsRouteStale(const HashData &entry, const GraphChangeResult &result,
+                      const std::vector<char> &isShifted,
+                      const std::vector<std::pair<int, int>> &costlierEdges) const;
+    // Drops the cached routes and retained trees the changes may have
+    // made invalid or beaten
+    void InvalidateStaleRoutes(const GraphChangeResult &result);
 
 protected:
 public:
     flight_app
     (const std::string &flightMapPath);
+    // What-if session: the copy starts with the map (a snapshot, see
+    // multi_graph), halted flights and cached routes of base, and its
+    // changes leave base as it was. Retained search trees are not copied.
+    flight_app(const flight_app &base);
+    flight_app &operator=(const flight_app &) = delete;
 
     
     void HaltFlight(const std::string &airportFrom,
@@ -58,20 +154,92 @@ public:
                         const std::string &airportTo,
                         const std::string &airlineName);
 
+    void DecommissionAirport(const std::string &airportName);
+    // Changes of a delta file (multi_graph::ReadDelta) in one batch,
+    // halted flights and the cached routes the changes can not affect
+    // are kept
+    void ApplyDelta(const std::string &deltaPath);
+    // Returns the number of changes applied
+    int ApplyChanges(const std::vector<GraphChange> &changes);
+    // Renumbers the airports for search locality, route costs stay the
+    // same (ties may pick another route of equal cost)
+    void ReorderAirports();
+
+    // New duration/price of a flight, halted flights keep the new ones
+    void UpdateFlightWeights(const std::string &airportFrom,
+                             const std::string &airportTo,
+                             const std::string &airlineName,
+                             float w0, float w1);
+    // Keeps every route from the airport at this alpha up to date
+    void RegisterHotOrigin(const std::string &airportName, float alpha);
+
+    // Partitioned mode for the airports without a REGION line of the
+    // map, regions of about regionSize airports
+    void PartitionAirports(int regionSize);
+
+    void SetAlphaGranularity(int granularity);
+    // Routes on 16 bit weights within maxError of the real ones (0 off)
+    void SetCompactWeights(float maxError);
+    void SetTreeCacheBudget(size_t byteCount);
+
+    void PrepareLandmarks(int landmarkCount, const std::string &landmarkPath);
+
     void FindFlight(const std::string &startAirportName,
                     const std::string &endAirportName,
                     float alpha);
+    // Same lookup without printing, false when there is no route
+    bool FindFlight(FlightItinerary &itinerary,
+                    const std::string &startAirportName,
+                    const std::string &endAirportName,
+                    float alpha);
+    // FindFlight of every query, the route cache is probed for the whole
+    // batch before the misses are searched (in order). Returns the
+    // number of routes found, isFound tells which.
+    int FindFlights(std::vector<FlightItinerary> &itineraries,
+                    std::vector<char> &isFound,
+                    const std::vector<FlightQuery> &queries);
+
+    void FindFlightSweep(const std::string &startAirportName,
+                         const std::string &endAirportName);
 
     void FindSpecificFlight(const std::string &startAirportName,
                             const std::string &endAirportName,
                             float alpha,
-                            const std::vector<std::string> &unwantedAirlineNames) const;
+                            const std::vector<std::string> &unwantedAirlineNames);
+    bool FindSpecificFlight(FlightItinerary &itinerary,
+                            const std::string &startAirportName,
+                            const std::string &endAirportName,
+                            float alpha,
+                            const std::vector<std::string> &unwantedAirlineNames);
+
+    // FindFlight (no airlines) or FindSpecificFlight as a query that
+    // suspends every ASYNC_YIELD_INTERVAL settled airports, to be run by
+    // a QueryExecutor. Gives up at the deadline or once the token is
+    // cancelled; a map change while it is suspended restarts the search.
+    // The itinerary must outlive the task.
+    QueryTask FindFlightAsync(FlightItinerary &itinerary,
+                              std::string startAirportName,
+                              std::string endAirportName,
+                              float alpha,
+                              std::vector<std::string> unwantedAirlineNames,
+                              CancellationToken token,
+                              QueryDeadline deadline = QueryDeadline::max());
+
+    void FindAlternativeFlights(const std::string &startAirportName,
+                                const std::string &endAirportName,
+                                float alpha, int count) const;
+
+    void FindEarliestFlight(const std::string &startAirportName,
+                            const std::string &endAirportName,
+                            float departureTime) const;
 
     int FurthestTransferViaAirline(const std::string &airportName,
                                    const std::string &airlineName) const;
 
     void PrintMap();
     void PrintCache();
+    void PrintCacheStatistics();
+    void PrintMemoryUsage();
 };
 
 #endif // CENG_FLIGHT_H
\ No newline at end of file
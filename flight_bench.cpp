@@ -0,0 +1,229 @@
+#include "multi_graph.h"
+#include "edge_relax.h"
+#include "output_writer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// flight_bench reorder MAP_FILE [-q QUERIES] [-n RUNS]
+//   Layout locality of the map (multi_graph::LayoutLocality) and the
+//   mean latency of random point-to-point queries, in file order and
+//   after multi_graph::ReorderVertices. Every query must cost the same
+//   in both orders.
+// flight_bench policy MAP_FILE [-q QUERIES] [-n RUNS]
+//   Mean latency of random queries at alpha 0, 1 and 0.5 and the sum of
+//   their costs. Built once as is and once with
+//   -DNO_WEIGHT_SPECIALIZATION, it compares the single weight kernels of
+//   alpha 0 and 1 with the blend kernel; the sums must match.
+// Latencies are the fastest of RUNS runs over the same queries. Exits
+// with 1 when a result differs.
+
+struct BenchOptions
+{
+    int queryCount = 200;
+    int runCount = 3;
+};
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: flight_bench reorder MAP_FILE [-q QUERIES] [-n RUNS]\n"
+                    "       flight_bench policy MAP_FILE [-q QUERIES] [-n RUNS]\n");
+}
+
+static bool ParseOptions(BenchOptions &options, int argc, char **argv, int first)
+{
+    for (int i = first; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            return false;
+        if (strcmp(argv[i], "-q") == 0)
+            options.queryCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0)
+            options.runCount = atoi(argv[++i]);
+        else
+            return false;
+    }
+    return options.queryCount > 0 && options.runCount > 0;
+}
+
+// Airports of the map file (lines of a single token)
+static void ReadAirportNames(std::vector<std::string> &names, const std::string &mapPath)
+{
+    std::ifstream mapFile(mapPath.c_str());
+    std::string line;
+    std::string name;
+    std::string extra;
+    while (std::getline(mapFile, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream tokens(line);
+        if (tokens >> name && !(tokens >> extra))
+            names.push_back(name);
+    }
+}
+
+struct BenchQuery
+{
+    const std::string *from;
+    const std::string *to;
+    float alpha;
+};
+
+// Same queries on every run (fixed seed), alphas 0, 0.25 ... 1
+static void MakeQueries(std::vector<BenchQuery> &queries, const std::vector<std::string> &names,
+                        int queryCount)
+{
+    unsigned int seed = 3;
+    for (int q = 0; q < queryCount; q++)
+    {
+        BenchQuery query;
+        seed = seed * 1103515245u + 12345u;
+        query.from = &names[(seed >> 8) % names.size()];
+        seed = seed * 1103515245u + 12345u;
+        query.to = &names[(seed >> 8) % names.size()];
+        query.alpha = (q % 5) / 4.0f;
+        queries.push_back(query);
+    }
+}
+
+// Milliseconds per query of the fastest run, the route costs (-1
+// without a route) go to costs
+static double TimeQueries(std::vector<float> &costs, const multi_graph &graph,
+                          const std::vector<BenchQuery> &queries, int runCount)
+{
+    double bestMilliseconds = 0;
+    std::vector<int> path;
+    FlightItinerary itinerary;
+    for (int r = 0; r < runCount; r++)
+    {
+        costs.clear();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t q = 0; q < queries.size(); q++)
+        {
+            const BenchQuery &query = queries[q];
+            if (!graph.HeuristicShortestPath(path, *query.from, *query.to, query.alpha))
+            {
+                costs.push_back(-1);
+                continue;
+            }
+            graph.MakeItinerary(itinerary, path, query.alpha);
+            costs.push_back(itinerary.totalCost);
+        }
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (r == 0 || milliseconds < bestMilliseconds)
+            bestMilliseconds = milliseconds;
+    }
+    return bestMilliseconds / queries.size();
+}
+
+static void PrintLayout(const char *order, const multi_graph &graph, double queryMilliseconds)
+{
+    GraphLayoutLocality locality;
+    graph.LayoutLocality(locality);
+    printf("%-11s gap %10.0f, same line %6.2f%%, same page %6.2f%%, %9.3f ms/query\n",
+           order, locality.meanIndexGap, locality.sameLinePercent, locality.samePagePercent,
+           queryMilliseconds);
+}
+
+// Equal within float rounding of the summed legs
+static int CountEqualCosts(const std::vector<float> &left, const std::vector<float> &right)
+{
+    int equalCount = 0;
+    for (size_t q = 0; q < left.size(); q++)
+        equalCount += (std::fabs(left[q] - right[q]) <= 1e-3f * (1 + std::fabs(left[q])));
+    return equalCount;
+}
+
+// False (with a message) for a map without airports
+static bool LoadMap(std::vector<std::string> &names, multi_graph &graph,
+                    const std::string &mapPath)
+{
+    ReadAirportNames(names, mapPath);
+    WaitOutput();
+    if (names.empty() || graph.VertexCount() == 0)
+    {
+        fprintf(stderr, "No airports in %s\n", mapPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+static int BenchReorder(const std::string &mapPath, const BenchOptions &options)
+{
+    std::vector<std::string> names;
+    multi_graph graph(mapPath);
+    if (!LoadMap(names, graph, mapPath))
+        return 1;
+
+    std::vector<BenchQuery> queries;
+    MakeQueries(queries, names, options.queryCount);
+
+    std::vector<float> fileCosts;
+    double fileMilliseconds = TimeQueries(fileCosts, graph, queries, options.runCount);
+    PrintLayout("file order", graph, fileMilliseconds);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<int> oldToNewIndex;
+    graph.ReorderVertices(oldToNewIndex);
+    printf("reordered in %.0f ms\n",
+           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+    std::vector<float> reorderedCosts;
+    double reorderedMilliseconds = TimeQueries(reorderedCosts, graph, queries, options.runCount);
+    PrintLayout("reordered", graph, reorderedMilliseconds);
+
+    int equalCount = CountEqualCosts(fileCosts, reorderedCosts);
+    printf("%d of %d route costs equal\n", equalCount, static_cast<int>(queries.size()));
+    return (equalCount == static_cast<int>(queries.size())) ? 0 : 1;
+}
+
+static int BenchPolicy(const std::string &mapPath, const BenchOptions &options)
+{
+    std::vector<std::string> names;
+    multi_graph graph(mapPath);
+    if (!LoadMap(names, graph, mapPath))
+        return 1;
+
+#ifdef NO_WEIGHT_SPECIALIZATION
+    printf("blend kernel for every alpha, %s relaxation\n", RelaxEdgesImplementation());
+#else
+    printf("single weight kernels for alpha 0 and 1, %s relaxation\n", RelaxEdgesImplementation());
+#endif
+    const float alphas[] = {0, 1, 0.5f};
+    for (int a = 0; a < 3; a++)
+    {
+        std::vector<BenchQuery> queries;
+        MakeQueries(queries, names, options.queryCount);
+        for (size_t q = 0; q < queries.size(); q++)
+            queries[q].alpha = alphas[a];
+
+        std::vector<float> costs;
+        double milliseconds = TimeQueries(costs, graph, queries, options.runCount);
+        double costSum = 0;
+        for (size_t q = 0; q < costs.size(); q++)
+            costSum += costs[q];
+        printf("alpha %-4g %9.3f ms/query, cost sum %.1f\n", alphas[a], milliseconds, costSum);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    SetAsyncOutput(false);
+    BenchOptions options;
+    if (argc >= 3 && strcmp(argv[1], "reorder") == 0 && ParseOptions(options, argc, argv, 3))
+        return BenchReorder(argv[2], options);
+    if (argc >= 3 && strcmp(argv[1], "policy") == 0 && ParseOptions(options, argc, argv, 3))
+        return BenchPolicy(argv[2], options);
+
+    PrintUsage();
+    return 1;
+}
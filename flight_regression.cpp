@@ -0,0 +1,746 @@
+#include "flight_app.h"
+#include "edge_relax.h"
+#include "output_writer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+// flight_regression
+//   Checks the behaviour of flight_app and multi_graph on small maps and
+//   runs sequences that once broke them, exits with 1 when one of the
+//   checks fails. Maps and deltas are written to the temporary
+//   directory.
+
+static std::string WriteFile(const std::string &fileName, const std::string &content)
+{
+    std::string filePath = (std::filesystem::temp_directory_path() / fileName).string();
+    std::ofstream file(filePath.c_str());
+    file << content;
+    return filePath;
+}
+
+static bool Expect(bool isTrue, const char *what)
+{
+    if (!isTrue)
+        fprintf(stderr, "  failed: %s\n", what);
+    return isTrue;
+}
+
+// Airport count and cost of the route, "none" without one
+static std::string RouteSummary(flight_app &app, const std::string &from,
+                                const std::string &to, float alpha)
+{
+    FlightItinerary itinerary;
+    if (!app.FindFlight(itinerary, from, to, alpha))
+        return "none";
+    return std::to_string(itinerary.vertexIndices.size()) + " airports, cost " +
+           std::to_string(itinerary.totalCost);
+}
+
+// ADD_AIRPORT grows the map past the landmark tables and hot trees
+static bool AddAirportWithLandmarks()
+{
+    std::string mapPath = WriteFile("flight_regression_map.txt",
+                                    "A\nB\nC\nD\n"
+                                    "A B X 10 10\n"
+                                    "B C X 10 10\n"
+                                    "C D X 10 10\n"
+                                    "D A X 10 10\n");
+    std::string airportDeltaPath = WriteFile("flight_regression_delta1.txt",
+                                             "ADD_AIRPORT Z\n");
+    std::string flightDeltaPath = WriteFile("flight_regression_delta2.txt",
+                                            "ADD A Z X 1 1\n"
+                                            "ADD Z D X 1 1\n");
+    flight_app app(mapPath);
+    app.PrepareLandmarks(2, "");
+    app.RegisterHotOrigin("A", 0.5f);
+    app.FindFlight("A", "D", 0.5f);
+
+    bool isPassed = true;
+    app.ApplyDelta(airportDeltaPath);
+    isPassed &= Expect(RouteSummary(app, "A", "Z", 0.5f) == "none",
+                       "no route to the added airport");
+    isPassed &= Expect(RouteSummary(app, "B", "Z", 0.5f) == "none",
+                       "no route to the added airport from elsewhere");
+    isPassed &= Expect(RouteSummary(app, "A", "D", 0.5f) == "4 airports, cost 30.000000",
+                       "route around the added airport");
+
+    app.ApplyDelta(flightDeltaPath);
+    isPassed &= Expect(RouteSummary(app, "A", "Z", 0.5f) == "2 airports, cost 1.000000",
+                       "route to the added airport");
+    isPassed &= Expect(RouteSummary(app, "A", "D", 0.5f) == "3 airports, cost 2.000000",
+                       "route through the added airport");
+    isPassed &= Expect(RouteSummary(app, "B", "Z", 0.5f) == "5 airports, cost 31.000000",
+                       "route to the added airport from elsewhere");
+    return isPassed;
+}
+
+// A resumed flight must not leave its halted copy behind, the next
+// continue would bring back the weights of the first halt
+static bool HaltContinueUpdate()
+{
+    std::string mapPath = WriteFile("flight_regression_map.txt",
+                                    "A\nB\n"
+                                    "A B THY 10 100\n");
+    std::string deltaPath = WriteFile("flight_regression_delta1.txt",
+                                      "UPDATE A B THY 3 3\n");
+    flight_app app(mapPath);
+
+    bool isPassed = true;
+    app.HaltFlight("A", "B", "THY");
+    app.ContinueFlight("A", "B", "THY");
+    app.UpdateFlightWeights("A", "B", "THY", 1, 1);
+    app.HaltFlight("A", "B", "THY");
+    app.ContinueFlight("A", "B", "THY");
+    isPassed &= Expect(RouteSummary(app, "A", "B", 0.5f) == "2 airports, cost 1.000000",
+                       "weights updated between two halts");
+
+    // Weights of a halted flight, set directly and by a delta
+    app.HaltFlight("A", "B", "THY");
+    app.UpdateFlightWeights("A", "B", "THY", 2, 2);
+    app.ContinueFlight("A", "B", "THY");
+    isPassed &= Expect(RouteSummary(app, "A", "B", 0.5f) == "2 airports, cost 2.000000",
+                       "weights updated while halted");
+
+    app.HaltFlight("A", "B", "THY");
+    app.ApplyDelta(deltaPath);
+    app.ContinueFlight("A", "B", "THY");
+    isPassed &= Expect(RouteSummary(app, "A", "B", 0.5f) == "2 airports, cost 3.000000",
+                       "weights updated by a delta while halted");
+
+    // Nothing is left to resume
+    app.ContinueFlight("A", "B", "THY");
+    app.HaltFlight("A", "B", "THY");
+    app.ContinueFlight("A", "B", "THY");
+    isPassed &= Expect(RouteSummary(app, "A", "B", 0.5f) == "2 airports, cost 3.000000",
+                       "weights after a repeated continue");
+    return isPassed;
+}
+
+// Cost of the route, -1 without one
+static float RouteCost(flight_app &app, const std::string &from,
+                       const std::string &to, float alpha, bool *isCacheHit = NULL)
+{
+    FlightItinerary itinerary;
+    if (!app.FindFlight(itinerary, from, to, alpha))
+        return -1;
+    if (isCacheHit)
+        *isCacheHit = itinerary.isCacheHit;
+    return itinerary.totalCost;
+}
+
+static bool IsCost(float cost, float expected)
+{
+    return std::fabs(cost - expected) < 1e-3f;
+}
+
+// A resumed flight is a new cheaper edge for the caches: routes it can
+// not be on stay cached, the others and the hot origin take it
+static bool ResumedFlightKeepsCache()
+{
+    std::string mapPath = WriteFile("flight_regression_map.txt",
+                                    "A\nB\nC\nD\n"
+                                    "A B X 10 10\n"
+                                    "B C X 10 10\n"
+                                    "C D X 10 10\n"
+                                    "A C Y 1 1\n");
+    flight_app app(mapPath);
+    app.HaltFlight("A", "C", "Y");
+    app.RegisterHotOrigin("A", 0.5f);
+
+    bool isPassed = true;
+    bool isCacheHit = false;
+    isPassed &= Expect(IsCost(RouteCost(app, "C", "D", 0.5f), 10) &&
+                           IsCost(RouteCost(app, "A", "C", 0.5f), 20) &&
+                           IsCost(RouteCost(app, "B", "D", 0.5f), 20),
+                       "routes while halted");
+
+    app.ContinueFlight("A", "C", "Y");
+    isPassed &= Expect(IsCost(RouteCost(app, "C", "D", 0.5f, &isCacheHit), 10) && isCacheHit,
+                       "route the resumed flight can not be on");
+    isPassed &= Expect(IsCost(RouteCost(app, "B", "D", 0.5f, &isCacheHit), 20) && isCacheHit,
+                       "route from an airport the flight is not reached from");
+    isPassed &= Expect(IsCost(RouteCost(app, "A", "C", 0.5f), 1),
+                       "route over the resumed flight");
+    isPassed &= Expect(IsCost(RouteCost(app, "A", "D", 0.5f), 11),
+                       "hot origin route over the resumed flight");
+    return isPassed;
+}
+
+// Every alpha of a bucket gets its shortest route, from a sweep, a
+// search or the cache. 0.495 is in the bucket of 0.5 but on the other
+// side of the break at 0.497: flight Y costs 248.985 there, X 250.985.
+static bool SweepAlphaBucket()
+{
+    std::string mapPath = WriteFile("flight_regression_map.txt",
+                                    "A\nB\n"
+                                    "A B X 497 0\n"
+                                    "A B Y 0 503\n");
+    flight_app sweptApp(mapPath);
+    flight_app searchedApp(mapPath);
+    sweptApp.FindFlightSweep("A", "B");
+
+    bool isPassed = true;
+    bool isCacheHit = false;
+    isPassed &= Expect(IsCost(RouteCost(sweptApp, "A", "B", 0.495f), 248.985f),
+                       "route from the sweep");
+    isPassed &= Expect(IsCost(RouteCost(sweptApp, "A", "B", 0.5f), 248.5f),
+                       "route from the sweep in the same bucket");
+
+    isPassed &= Expect(IsCost(RouteCost(searchedApp, "A", "B", 0.5f), 248.5f),
+                       "searched route");
+    // X at 0.498 as at 0.5, the cached X is then known for 0.498 to 0.5
+    isPassed &= Expect(IsCost(RouteCost(searchedApp, "A", "B", 0.498f, &isCacheHit), 249.494f) &&
+                           !isCacheHit,
+                       "searched route in the same bucket");
+    isPassed &= Expect(IsCost(RouteCost(searchedApp, "A", "B", 0.499f, &isCacheHit), 248.997f) &&
+                           isCacheHit,
+                       "cached route within its range");
+    isPassed &= Expect(IsCost(RouteCost(searchedApp, "A", "B", 0.495f, &isCacheHit), 248.985f) &&
+                           !isCacheHit,
+                       "searched route past the break");
+    return isPassed;
+}
+
+// Earliest arrival over timetables: a connection needs the minimum
+// connection time of the airport it is made at, not of the origin
+static bool EarliestArrivalWindows()
+{
+    const std::string timetable = "A\nB\nC\n"
+                                  "A B X 1 1\n"
+                                  "B C Y 1 1\n"
+                                  "B C Z 1 1\n"
+                                  "DEP A B X 10 20\n"
+                                  "DEP B C Y 25 30\n"
+                                  "DEP B C Z 40 45\n";
+    multi_graph tight(WriteFile("flight_regression_map.txt", timetable));
+    multi_graph windowed(WriteFile("flight_regression_map.txt",
+                                   timetable + "MCT B 10\nMCT A 100\n"));
+
+    bool isPassed = true;
+    std::vector<int> path;
+    std::vector<FlightDeparture> legTimes;
+    isPassed &= Expect(tight.EarliestArrivalPath(path, legTimes, "A", "C", 0) &&
+                           legTimes.size() == 2 && legTimes[1].arrivalTime == 30,
+                       "connection without a window");
+    isPassed &= Expect(windowed.EarliestArrivalPath(path, legTimes, "A", "C", 0) &&
+                           legTimes.size() == 2 && legTimes[0].departureTime == 10 &&
+                           legTimes[1].departureTime == 40 && legTimes[1].arrivalTime == 45,
+                       "connection window of the transfer airport");
+    isPassed &= Expect(!windowed.EarliestArrivalPath(path, legTimes, "A", "C", 15),
+                       "no departure after the requested time");
+    isPassed &= Expect(windowed.EarliestArrivalPath(path, legTimes, "B", "C", 25) &&
+                           legTimes.size() == 1 && legTimes[0].arrivalTime == 30,
+                       "no window at the origin");
+    return isPassed;
+}
+
+// Every path is loopless, no two are equal and costs do not decrease
+static bool IsValidPathSet(const multi_graph &graph,
+                           const std::vector<std::vector<int>> &paths, float alpha)
+{
+    float lastCost = 0;
+    for (size_t p = 0; p < paths.size(); p++)
+    {
+        FlightItinerary itinerary;
+        graph.MakeItinerary(itinerary, paths[p], alpha);
+        const std::vector<int> &vertices = itinerary.vertexIndices;
+        std::vector<int> sorted(vertices);
+        std::sort(sorted.begin(), sorted.end());
+        if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+            return Expect(false, "loopless paths");
+        if (p > 0 && itinerary.totalCost < lastCost)
+            return Expect(false, "costs do not decrease");
+        lastCost = itinerary.totalCost;
+        for (size_t q = 0; q < p; q++)
+        {
+            if (paths[q] == paths[p])
+                return Expect(false, "distinct paths");
+        }
+    }
+    return true;
+}
+
+// Yen's k shortest loopless paths, with parallel flights of the same
+// route counted as different paths and k above the number of paths
+static bool KShortestLooplessPaths()
+{
+    multi_graph graph(WriteFile("flight_regression_map.txt",
+                                "A\nB\nC\nD\n"
+                                "A B X 1 1\n"
+                                "A B Y 1 1\n"
+                                "B D X 1 1\n"
+                                "A C X 2 2\n"
+                                "C D X 2 2\n"
+                                "B C X 1 1\n"
+                                "C B X 1 1\n"
+                                "D A X 1 1\n"));
+    // A-B-D twice (X and Y to B), A-B-C-D twice, A-C-D, A-C-B-D
+    const float expectedCosts[] = {2, 2, 4, 4, 4, 4};
+    const size_t pathCount = sizeof(expectedCosts) / sizeof(expectedCosts[0]);
+
+    bool isPassed = true;
+    std::vector<std::vector<int>> paths;
+    isPassed &= Expect(graph.KShortestPaths(paths, "A", "D", 0.5f, 10), "paths found");
+    isPassed &= Expect(paths.size() == pathCount, "every loopless path, no more");
+    isPassed &= IsValidPathSet(graph, paths, 0.5f);
+    for (size_t p = 0; p < paths.size() && p < pathCount; p++)
+    {
+        FlightItinerary itinerary;
+        graph.MakeItinerary(itinerary, paths[p], 0.5f);
+        isPassed &= Expect(itinerary.totalCost == expectedCosts[p], "path costs");
+    }
+
+    isPassed &= Expect(graph.KShortestPaths(paths, "A", "D", 0.5f, 3) && paths.size() == 3,
+                       "k paths when there are more");
+    isPassed &= IsValidPathSet(graph, paths, 0.5f);
+    isPassed &= Expect(graph.KShortestPaths(paths, "A", "A", 0.5f, 3) && paths.size() == 1,
+                       "the empty path to the origin");
+    return isPassed;
+}
+
+// A what-if copy of flight_app and its base share the map until one
+// of them changes it, a change on either side leaves the other as it was
+static bool SnapshotIsolation()
+{
+    std::string mapPath = WriteFile("flight_regression_map.txt",
+                                    "A\nB\nC\nD\n"
+                                    "A B X 1 1\n"
+                                    "B D X 1 1\n"
+                                    "A C X 5 5\n"
+                                    "C D X 5 5\n");
+    std::string deltaPath = WriteFile("flight_regression_delta1.txt",
+                                      "UPDATE A C X 2 2\n");
+    flight_app base(mapPath);
+    base.FindFlight("A", "D", 0.5f);
+    flight_app session(base);
+
+    bool isPassed = true;
+    isPassed &= Expect(RouteSummary(session, "A", "D", 0.5f) == "3 airports, cost 2.000000",
+                       "route of the base in the copy");
+
+    // Copy to base: a halted flight
+    session.HaltFlight("A", "B", "X");
+    isPassed &= Expect(RouteSummary(session, "A", "D", 0.5f) == "3 airports, cost 10.000000",
+                       "halt in the copy");
+    isPassed &= Expect(RouteSummary(base, "A", "D", 0.5f) == "3 airports, cost 2.000000",
+                       "halt in the copy, base");
+
+    // Base to copy: new weights
+    base.UpdateFlightWeights("B", "D", "X", 20, 20);
+    isPassed &= Expect(RouteSummary(base, "B", "D", 0.5f) == "2 airports, cost 20.000000",
+                       "update in the base");
+    isPassed &= Expect(RouteSummary(session, "B", "D", 0.5f) == "2 airports, cost 1.000000",
+                       "update in the base, copy");
+
+    // Copy to base: a decommissioned airport and a delta
+    session.DecommissionAirport("C");
+    isPassed &= Expect(RouteSummary(session, "A", "D", 0.5f) == "none",
+                       "decommission in the copy");
+    isPassed &= Expect(RouteSummary(base, "A", "D", 0.5f) == "3 airports, cost 10.000000",
+                       "decommission in the copy, base");
+    session.ApplyDelta(deltaPath);
+    isPassed &= Expect(RouteSummary(base, "A", "C", 0.5f) == "2 airports, cost 5.000000",
+                       "delta in the copy, base");
+
+    // The halted flight resumes with the weights of the copy
+    session.ContinueFlight("A", "B", "X");
+    isPassed &= Expect(RouteSummary(session, "A", "D", 0.5f) == "3 airports, cost 2.000000",
+                       "continue in the copy");
+    isPassed &= Expect(RouteSummary(base, "A", "D", 0.5f) == "3 airports, cost 10.000000",
+                       "continue in the copy, base");
+    return isPassed;
+}
+
+// Printed table, to compare slots, recency and counts of two tables
+template <int MAX_SIZE>
+static std::string TableText(const HashTable<MAX_SIZE> &table)
+{
+    std::string text;
+    CaptureOutput(&text);
+    table.PrintTable();
+    table.PrintStatistics();
+    CaptureOutput(NULL);
+    return text;
+}
+
+// Drives one table with Find and a copy with FindBatch over the same
+// random keys, some of them cached, with inserts in between that
+// evict by recency and frequency
+template <int MAX_SIZE>
+static bool FindBatchMatchesFind(int vertexCount)
+{
+    HashTable<MAX_SIZE> single;
+    HashTable<MAX_SIZE> batched;
+    unsigned int seed = 7;
+    bool isPassed = true;
+    for (int round = 0; round < 20; round++)
+    {
+        for (int i = 0; i < MAX_SIZE / 2; i++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            std::vector<int> path;
+            path.push_back((seed >> 8) % vertexCount);
+            path.push_back(i);
+            path.push_back((seed >> 20) % vertexCount);
+            int alphaBucket = (seed >> 4) % 3;
+            single.Insert(path, alphaBucket, seed % 2);
+            batched.Insert(path, alphaBucket, seed % 2);
+        }
+
+        std::vector<HashKey> keys;
+        for (int i = 0; i < MAX_SIZE; i++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            HashKey key = {static_cast<int>((seed >> 8) % vertexCount),
+                           static_cast<int>((seed >> 20) % vertexCount),
+                           static_cast<int>((seed >> 4) % 3), seed % 2, ANY_ALPHA};
+            keys.push_back(key);
+        }
+        bool isIncLRU = (round % 4 != 3);
+        std::vector<std::vector<int>> batchPaths;
+        std::vector<char> isFound;
+        int foundCount = batched.FindBatch(batchPaths, isFound, keys, isIncLRU);
+
+        int singleFoundCount = 0;
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            std::vector<int> path;
+            bool isSingleFound = single.Find(path, keys[i].startInt, keys[i].endInt,
+                                             keys[i].alphaBucket, keys[i].filterFingerprint,
+                                             isIncLRU);
+            singleFoundCount += isSingleFound;
+            if (isSingleFound != (isFound[i] != 0) || (isSingleFound && path != batchPaths[i]))
+                isPassed = false;
+        }
+        isPassed &= (foundCount == singleFoundCount);
+        isPassed &= (single.HitCount() == batched.HitCount() &&
+                     single.MissCount() == batched.MissCount());
+        isPassed &= (TableText(single) == TableText(batched));
+    }
+    return isPassed && single.HitCount() > MAX_SIZE / 2;
+}
+
+// FindBatch gives the results, statistics and recency of Find, in the
+// scanned control bytes of a small table and the probes of a large one
+static bool FindBatchOfRouteCache()
+{
+    bool isPassed = true;
+    isPassed &= Expect(FindBatchMatchesFind<CONTROL_SCAN_SIZE>(5), "scanned table");
+    isPassed &= Expect(FindBatchMatchesFind<1021>(40), "probed table");
+    return isPassed;
+}
+
+// A landmark file that is missing, cut short or of another map leaves
+// the tables in use as they were
+static bool RejectedLandmarkFile()
+{
+    std::string mapPath = WriteFile("flight_regression_map.txt",
+                                    "A\nB\nC\n"
+                                    "A B X 1 1\n"
+                                    "B C X 1 1\n"
+                                    "C A X 1 1\n");
+    std::string otherMapPath = WriteFile("flight_regression_map2.txt",
+                                         "A\nB\n"
+                                         "A B X 1 1\n");
+    std::string landmarkPath = (std::filesystem::temp_directory_path() /
+                                "flight_regression_landmarks.bin").string();
+    std::string otherLandmarkPath = (std::filesystem::temp_directory_path() /
+                                     "flight_regression_landmarks2.bin").string();
+    multi_graph otherGraph(otherMapPath);
+    otherGraph.BuildLandmarks(1);
+    otherGraph.SaveLandmarks(otherLandmarkPath);
+    multi_graph graph(mapPath);
+    graph.BuildLandmarks(2);
+    graph.SaveLandmarks(landmarkPath);
+    std::filesystem::resize_file(landmarkPath, std::filesystem::file_size(landmarkPath) - 4);
+    graph.BuildLandmarks(3);
+
+    bool isPassed = true;
+    std::vector<int> path;
+    isPassed &= Expect(!graph.LoadLandmarks(landmarkPath + ".missing") && graph.LandmarkCount() == 3,
+                       "missing file");
+    isPassed &= Expect(!graph.LoadLandmarks(landmarkPath) && graph.LandmarkCount() == 3,
+                       "file cut short");
+    isPassed &= Expect(!graph.LoadLandmarks(otherLandmarkPath) && graph.LandmarkCount() == 3,
+                       "file of another map");
+    isPassed &= Expect(graph.HeuristicShortestPath(path, "A", "C", 0.5f) && path.size() == 5,
+                       "route on the kept tables");
+    return isPassed;
+}
+
+// Region bytes of a map of two regions of REGION_AIRPORTS airports,
+// after a search from the first to the last airport: a chain of flights
+// (one crossing the regions), and every flight inside a region when
+// isDense
+static size_t RegionBytes(bool isDense)
+{
+    const int REGION_AIRPORTS = 8;
+    std::string mapText;
+    for (int i = 0; i < 2 * REGION_AIRPORTS; i++)
+    {
+        mapText += "A" + std::to_string(i) + "\n";
+        mapText += "REGION A" + std::to_string(i) + " R" + std::to_string(i / REGION_AIRPORTS) + "\n";
+    }
+    for (int i = 0; i < 2 * REGION_AIRPORTS; i++)
+    {
+        for (int j = 0; j < 2 * REGION_AIRPORTS; j++)
+        {
+            bool isChain = (j == i + 1);
+            bool isInside = (i != j && i / REGION_AIRPORTS == j / REGION_AIRPORTS);
+            if (isChain || (isDense && isInside))
+                mapText += "A" + std::to_string(i) + " A" + std::to_string(j) + " X 1 1\n";
+        }
+    }
+    multi_graph graph(WriteFile("flight_regression_map.txt", mapText));
+    std::vector<int> path;
+    graph.RegionShortestPath(path, "A0", "A" + std::to_string(2 * REGION_AIRPORTS - 1), 0.5f);
+    GraphMemoryUsage usage;
+    graph.MemoryUsage(usage);
+    return usage.regionBytes;
+}
+
+// Flights inside the regions are counted with the regions: forward and
+// reverse target, edge index and two weights each
+static bool RegionMemoryUsage()
+{
+    // 2 * 8 * 7 flights inside the regions against 14 of the chain
+    const size_t addedFlightCount = 2 * 8 * 7 - 14;
+    size_t chainBytes = RegionBytes(false);
+    size_t denseBytes = RegionBytes(true);
+    return Expect(denseBytes >= chainBytes + addedFlightCount * 2 * (2 * sizeof(int) + 2 * sizeof(float)),
+                  "flights inside the regions");
+}
+
+// Airports reached from every airport over the flights, without the
+// flights of one airline (-1 for none)
+static void ReachedAirports(std::vector<std::vector<char>> &reached,
+                            const std::vector<std::vector<std::pair<int, int>>> &flights,
+                            int excludedAirline)
+{
+    int airportCount = static_cast<int>(flights.size());
+    reached.assign(airportCount, std::vector<char>(airportCount, 0));
+    std::vector<int> stack;
+    for (int from = 0; from < airportCount; from++)
+    {
+        reached[from][from] = 1;
+        stack.push_back(from);
+        while (!stack.empty())
+        {
+            int airport = stack.back();
+            stack.pop_back();
+            for (size_t f = 0; f < flights[airport].size(); f++)
+            {
+                int next = flights[airport][f].first;
+                if (flights[airport][f].second != excludedAirline && !reached[from][next])
+                {
+                    reached[from][next] = 1;
+                    stack.push_back(next);
+                }
+            }
+        }
+    }
+}
+
+// Random flights of short hops both ways split the map into many
+// components on sibling branches, where the component ranges alone pass
+// unconnected pairs. MayReach must answer every pair exactly, also after
+// added flights, and the labels without an airline (more airlines than
+// labels are kept) must never rule out a route.
+static bool ExactReachability()
+{
+    const int AIRPORT_COUNT = 60;
+    const int AIRLINE_COUNT = REACHABILITY_FILTERED_LABELS + 4;
+    const int ADDED_COUNT = 10;
+    unsigned int seed = 11;
+    std::string mapText;
+    for (int i = 0; i < AIRPORT_COUNT; i++)
+        mapText += "A" + std::to_string(i) + "\n";
+
+    // (to, airline) per airport, the last ADDED_COUNT flights are added
+    // to the loaded map
+    std::vector<std::vector<std::pair<int, int>>> flights(AIRPORT_COUNT);
+    std::vector<std::pair<int, std::pair<int, int>>> addedFlights;
+    for (int f = 0; f < AIRPORT_COUNT + ADDED_COUNT; f++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        int from = (seed >> 8) % AIRPORT_COUNT;
+        seed = seed * 1103515245u + 12345u;
+        int to = (from + AIRPORT_COUNT + (seed >> 8) % 7 - 3) % AIRPORT_COUNT;
+        seed = seed * 1103515245u + 12345u;
+        std::pair<int, int> flight(to, (seed >> 8) % AIRLINE_COUNT);
+        if (to == from || std::find(flights[from].begin(), flights[from].end(), flight) != flights[from].end())
+            continue;
+        if (f >= AIRPORT_COUNT)
+        {
+            addedFlights.push_back(std::make_pair(from, flight));
+            continue;
+        }
+        flights[from].push_back(flight);
+        mapText += "A" + std::to_string(from) + " A" + std::to_string(to) + " L" +
+                   std::to_string(flight.second) + " 1 1\n";
+    }
+    multi_graph graph(WriteFile("flight_regression_map.txt", mapText));
+
+    bool isPassed = true;
+    std::vector<std::vector<char>> reached;
+    ReachedAirports(reached, flights, -1);
+    int wrongCount = 0;
+    for (int from = 0; from < AIRPORT_COUNT; from++)
+    {
+        for (int to = 0; to < AIRPORT_COUNT; to++)
+            wrongCount += (graph.MayReach(from, to) != static_cast<bool>(reached[from][to]));
+    }
+    isPassed &= Expect(wrongCount == 0, "reachability of every pair");
+
+    std::vector<int> path;
+    wrongCount = 0;
+    for (int airline = 0; airline < AIRLINE_COUNT; airline++)
+    {
+        ReachedAirports(reached, flights, airline);
+        std::vector<std::string> excluded(1, "L" + std::to_string(airline));
+        for (int from = 0; from < AIRPORT_COUNT; from += 7)
+        {
+            for (int to = 0; to < AIRPORT_COUNT; to++)
+            {
+                bool isFound = graph.FilteredShortestPath(path, "A" + std::to_string(from),
+                                                          "A" + std::to_string(to), 0.5f, excluded);
+                wrongCount += (isFound != static_cast<bool>(reached[from][to]));
+            }
+        }
+    }
+    isPassed &= Expect(wrongCount == 0, "routes without each airline");
+
+    for (size_t f = 0; f < addedFlights.size(); f++)
+    {
+        int from = addedFlights[f].first;
+        std::pair<int, int> flight = addedFlights[f].second;
+        if (std::find(flights[from].begin(), flights[from].end(), flight) != flights[from].end())
+            continue;
+        flights[from].push_back(flight);
+        graph.AddEdge("L" + std::to_string(flight.second), "A" + std::to_string(from),
+                      "A" + std::to_string(flight.first), 1, 1);
+    }
+    ReachedAirports(reached, flights, -1);
+    wrongCount = 0;
+    for (int from = 0; from < AIRPORT_COUNT; from++)
+    {
+        for (int to = 0; to < AIRPORT_COUNT; to++)
+            wrongCount += (graph.MayReach(from, to) != static_cast<bool>(reached[from][to]));
+    }
+    isPassed &= Expect(wrongCount == 0, "reachability after added flights");
+    return isPassed;
+}
+
+// Improved edges and candidate distances of every relaxation kernel the
+// CPU supports against the scalar one, on random vertices of 0 to 40
+// edges (tails that are no multiple of 8 or 4), with repeated targets,
+// unreached targets and ties
+static bool RelaxKernelsAgree()
+{
+    const int DISTANCE_COUNT = 64;
+    const int MAX_EDGE_COUNT = 40;
+    const float INF = std::numeric_limits<float>::infinity();
+    unsigned int seed = 11;
+    std::vector<float> weight0(MAX_EDGE_COUNT), weight1(MAX_EDGE_COUNT);
+    std::vector<int> targets(MAX_EDGE_COUNT);
+    std::vector<float> distances(DISTANCE_COUNT);
+    // Blend results, then the single weight ones
+    std::vector<int> expectedEdges(2 * MAX_EDGE_COUNT), improvedEdges(2 * MAX_EDGE_COUNT);
+    std::vector<float> expectedCandidates(2 * MAX_EDGE_COUNT), candidates(2 * MAX_EDGE_COUNT);
+
+    bool isPassed = true;
+    for (int trial = 0; trial < 2000; trial++)
+    {
+        int edgeCount = trial % (MAX_EDGE_COUNT + 1);
+        float distance = (trial % 7) * 3.5f;
+        for (int i = 0; i < edgeCount; i++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            weight0[i] = ((seed >> 8) % 400) / 4.0f;
+            weight1[i] = ((seed >> 16) % 400) / 4.0f;
+            targets[i] = (seed >> 24) % DISTANCE_COUNT;
+        }
+        for (int v = 0; v < DISTANCE_COUNT; v++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            distances[v] = ((seed >> 8) % 8 == 0) ? INF : ((seed >> 12) % 600) / 4.0f;
+        }
+        // Ties at alpha 0 are not improvements
+        if (edgeCount > 0)
+            distances[targets[0]] = distance + weight0[0];
+
+        seed = seed * 1103515245u + 12345u;
+        float alpha = (trial % 3 == 2) ? ((seed >> 8) % 1000) / 1000.0f : static_cast<float>(trial % 3);
+        int expectedCount = RelaxEdgesUsing(0, weight0.data(), weight1.data(), targets.data(),
+                                            edgeCount, alpha, distance, distances.data(),
+                                            expectedEdges.data(), expectedCandidates.data());
+        int expectedSingleCount = RelaxEdgeWeightsUsing(0, weight0.data(), targets.data(), edgeCount,
+                                                        distance, distances.data(),
+                                                        expectedEdges.data() + expectedCount,
+                                                        expectedCandidates.data() + expectedCount);
+        for (int k = 1; k < RelaxEdgesImplementationCount(); k++)
+        {
+            int count = RelaxEdgesUsing(k, weight0.data(), weight1.data(), targets.data(),
+                                        edgeCount, alpha, distance, distances.data(),
+                                        improvedEdges.data(), candidates.data());
+            count += RelaxEdgeWeightsUsing(k, weight0.data(), targets.data(), edgeCount,
+                                           distance, distances.data(),
+                                           improvedEdges.data() + count, candidates.data() + count);
+            bool isSame = (count == expectedCount + expectedSingleCount);
+            for (int i = 0; isSame && i < count; i++)
+                isSame = (improvedEdges[i] == expectedEdges[i] && candidates[i] == expectedCandidates[i]);
+            // First difference only
+            if (!isSame && isPassed)
+                fprintf(stderr, "  %s kernel, %d edges, alpha %g\n",
+                        RelaxEdgesImplementationName(k), edgeCount, alpha);
+            isPassed &= isSame;
+        }
+    }
+    fprintf(stderr, "  %d kernels checked against %s\n", RelaxEdgesImplementationCount() - 1,
+            RelaxEdgesImplementationName(0));
+    return Expect(isPassed, "same improved edges as the scalar kernel");
+}
+
+struct RegressionTest
+{
+    const char *name;
+    bool (*run)();
+};
+
+int main()
+{
+    const RegressionTest tests[] =
+    {
+        {"add airport with landmarks and hot origins", AddAirportWithLandmarks},
+        {"halt, continue and update a flight", HaltContinueUpdate},
+        {"resumed flight keeps unaffected routes", ResumedFlightKeepsCache},
+        {"sweep routes of an alpha bucket", SweepAlphaBucket},
+        {"earliest arrival with connection windows", EarliestArrivalWindows},
+        {"k shortest loopless paths", KShortestLooplessPaths},
+        {"snapshot isolation of a what-if copy", SnapshotIsolation},
+        {"batched route cache lookups", FindBatchOfRouteCache},
+        {"rejected landmark file", RejectedLandmarkFile},
+        {"exact reachability labels", ExactReachability},
+        {"memory of the region flights", RegionMemoryUsage},
+        {"vectorized edge relaxation", RelaxKernelsAgree},
+    };
+    int testCount = sizeof(tests) / sizeof(tests[0]);
+
+    int failedCount = 0;
+    for (int i = 0; i < testCount; i++)
+    {
+        bool isPassed = tests[i].run();
+        WaitOutput();
+        fprintf(stderr, "%s: %s\n", isPassed ? "PASS" : "FAIL", tests[i].name);
+        if (!isPassed)
+            failedCount++;
+    }
+    fprintf(stderr, "%d of %d passed\n", testCount - failedCount, testCount);
+    return (failedCount == 0) ? 0 : 1;
+}
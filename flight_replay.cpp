@@ -0,0 +1,376 @@
+#include "command_processor.h"
+#include "output_writer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// flight_replay record MAP_FILE COMMAND_FILE RECORD_FILE [-n RUNS]
+//   Runs the commands of command_processor.h against the map and stores
+//   every command with its output and latency (the fastest of RUNS
+//   runs, each on a freshly loaded map).
+// flight_replay check MAP_FILE RECORD_FILE [-n RUNS] [-t PERCENT]
+//                     [-T PERCENT] [-m MICROSECONDS] [-i COMMAND]...
+//   Runs the recorded commands again, reports every output that differs
+//   and compares the latency percentiles of each command with the
+//   record. The median and p90 may grow by -t percent (default 20), p99
+//   by -T percent (default 50); latencies under -m microseconds (default
+//   5) are taken as that much, commands run less than 20 times are not
+//   judged. -i skips the output of a command (e.g. memory). Exits with 1
+//   on differing output, 2 on slower commands.
+
+// First line of a record file
+#define REPLAY_HEADER "FLIGHT_REPLAY 1"
+// Differing outputs reported in full
+#define REPLAY_REPORTED_DIFFERENCES 10
+// Latencies of commands run fewer times are shown but not judged
+#define REPLAY_MIN_COUNT 20
+
+struct ReplayEntry
+{
+    std::string line;
+    std::string output;
+    // Nanoseconds, the map load for the first entry
+    long long latency;
+};
+
+struct ReplayOptions
+{
+    int runCount = 1;
+    double medianPercent = 20;
+    double tailPercent = 50;
+    double floorMicroseconds = 5;
+    std::set<std::string> ignoredCommands;
+};
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+            "Usage: flight_replay record MAP_FILE COMMAND_FILE RECORD_FILE [-n RUNS]\n"
+            "       flight_replay check MAP_FILE RECORD_FILE [-n RUNS] [-t PERCENT]\n"
+            "                           [-T PERCENT] [-m MICROSECONDS] [-i COMMAND]...\n");
+}
+
+static long long ElapsedNanoseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// "load" for the map, otherwise the first token of the command
+static std::string CommandName(const ReplayEntry &entry, bool isLoad)
+{
+    if (isLoad)
+        return "load";
+
+    std::istringstream tokens(entry.line);
+    std::string name;
+    tokens >> name;
+    return name;
+}
+
+// One run over a fresh map. The first entry is the map load, the
+// others get the latency and output of their command.
+static void Run(std::vector<ReplayEntry> &entries, const std::string &mapPath)
+{
+    std::string capture;
+    CaptureOutput(&capture);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    flight_app app(mapPath);
+    entries[0].latency = ElapsedNanoseconds(start);
+    FlushOutput();
+    entries[0].output.swap(capture);
+    capture.clear();
+
+    CommandProcessor processor(app);
+    for (size_t i = 1; i < entries.size(); i++)
+    {
+        start = std::chrono::steady_clock::now();
+        processor.ExecuteLine(entries[i].line);
+        FlushOutput();
+        entries[i].latency = ElapsedNanoseconds(start);
+        entries[i].output.swap(capture);
+        capture.clear();
+    }
+
+    CaptureOutput(NULL);
+}
+
+// Fastest latency of every entry over the runs, the outputs of the runs
+// must agree
+static bool RunBest(std::vector<ReplayEntry> &entries, const std::string &mapPath, int runCount)
+{
+    Run(entries, mapPath);
+    for (int run = 1; run < runCount; run++)
+    {
+        std::vector<ReplayEntry> again(entries);
+        Run(again, mapPath);
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            if (again[i].output != entries[i].output)
+            {
+                fprintf(stderr, "Output of \"%s\" differs between runs\n", entries[i].line.c_str());
+                return false;
+            }
+            entries[i].latency = std::min(entries[i].latency, again[i].latency);
+        }
+    }
+    return true;
+}
+
+static bool ReadCommands(std::vector<ReplayEntry> &entries, const std::string &commandPath)
+{
+    std::ifstream file(commandPath.c_str());
+    if (!file.is_open())
+        return false;
+
+    entries.assign(1, ReplayEntry());
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+        if (CommandProcessor::IsSkippedLine(line))
+            continue;
+
+        ReplayEntry entry;
+        entry.line = line;
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+// Header, then per entry "latency outputBytes line" and the raw output
+static bool WriteRecord(const std::vector<ReplayEntry> &entries, const std::string &recordPath)
+{
+    std::ofstream file(recordPath.c_str(), std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    file << REPLAY_HEADER << '\n';
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        file << entries[i].latency << ' ' << entries[i].output.size() << ' ' << entries[i].line << '\n';
+        file.write(entries[i].output.data(), static_cast<std::streamsize>(entries[i].output.size()));
+    }
+    return static_cast<bool>(file);
+}
+
+static bool ReadRecord(std::vector<ReplayEntry> &entries, const std::string &recordPath)
+{
+    std::ifstream file(recordPath.c_str(), std::ios::binary);
+    std::string line;
+    if (!file.is_open() || !std::getline(file, line) || line != REPLAY_HEADER)
+        return false;
+
+    entries.clear();
+    while (std::getline(file, line))
+    {
+        ReplayEntry entry;
+        size_t outputBytes;
+        std::istringstream header(line);
+        if (!(header >> entry.latency >> outputBytes))
+            return false;
+        header.get();
+        std::getline(header, entry.line);
+
+        entry.output.resize(outputBytes);
+        if (outputBytes > 0 && !file.read(&entry.output[0], static_cast<std::streamsize>(outputBytes)))
+            return false;
+        entries.push_back(entry);
+    }
+    return !entries.empty();
+}
+
+// First line of the two texts that differs, 1 based
+static int FirstDifferentLine(const std::string &expected, const std::string &actual,
+                              std::string &expectedLine, std::string &actualLine)
+{
+    std::istringstream expectedLines(expected);
+    std::istringstream actualLines(actual);
+    for (int lineNumber = 1;; lineNumber++)
+    {
+        bool hasExpected = static_cast<bool>(std::getline(expectedLines, expectedLine));
+        bool hasActual = static_cast<bool>(std::getline(actualLines, actualLine));
+        if (!hasExpected)
+            expectedLine = "(end of output)";
+        if (!hasActual)
+            actualLine = "(end of output)";
+        if (!hasExpected && !hasActual)
+            return 0;
+        if (!hasExpected || !hasActual || expectedLine != actualLine)
+            return lineNumber;
+    }
+}
+
+static int CompareOutputs(const std::vector<ReplayEntry> &recorded,
+                          const std::vector<ReplayEntry> &replayed,
+                          const ReplayOptions &options)
+{
+    int differenceCount = 0;
+    for (size_t i = 0; i < recorded.size(); i++)
+    {
+        if (replayed[i].output == recorded[i].output ||
+            options.ignoredCommands.count(CommandName(recorded[i], i == 0)) > 0)
+            continue;
+
+        if (differenceCount < REPLAY_REPORTED_DIFFERENCES)
+        {
+            std::string expectedLine, actualLine;
+            int lineNumber = FirstDifferentLine(recorded[i].output, replayed[i].output,
+                                                expectedLine, actualLine);
+            printf("Command %zu \"%s\" output line %d\n  recorded: %s\n  replayed: %s\n",
+                   i, i == 0 ? "load" : recorded[i].line.c_str(), lineNumber,
+                   expectedLine.c_str(), actualLine.c_str());
+        }
+        differenceCount++;
+    }
+    return differenceCount;
+}
+
+// Nearest rank percentile of sorted latencies
+static double Percentile(const std::vector<long long> &latencies, double percent)
+{
+    size_t rank = static_cast<size_t>(percent / 100 * latencies.size() + 0.5);
+    rank = std::max<size_t>(rank, 1);
+    return static_cast<double>(latencies[std::min(rank, latencies.size()) - 1]);
+}
+
+// Latency percentiles by command, true when none grew past its limit
+static bool CompareLatencies(const std::vector<ReplayEntry> &recorded,
+                             const std::vector<ReplayEntry> &replayed,
+                             const ReplayOptions &options)
+{
+    std::map<std::string, std::pair<std::vector<long long>, std::vector<long long>>> byCommand;
+    for (size_t i = 0; i < recorded.size(); i++)
+    {
+        std::string name = CommandName(recorded[i], i == 0);
+        byCommand[name].first.push_back(recorded[i].latency);
+        byCommand[name].second.push_back(replayed[i].latency);
+        if (i > 0)
+        {
+            byCommand["all"].first.push_back(recorded[i].latency);
+            byCommand["all"].second.push_back(replayed[i].latency);
+        }
+    }
+
+    const double percents[3] = {50, 90, 99};
+    const double limits[3] = {options.medianPercent, options.medianPercent, options.tailPercent};
+    double floor = options.floorMicroseconds * 1000;
+    bool isWithinLimits = true;
+
+    printf("%-16s %8s %30s %30s %30s\n", "command", "count",
+           "p50 us (recorded)", "p90 us (recorded)", "p99 us (recorded)");
+    std::map<std::string, std::pair<std::vector<long long>, std::vector<long long>>>::iterator it;
+    for (it = byCommand.begin(); it != byCommand.end(); ++it)
+    {
+        std::vector<long long> &before = it->second.first;
+        std::vector<long long> &after = it->second.second;
+        std::sort(before.begin(), before.end());
+        std::sort(after.begin(), after.end());
+
+        bool isRegressed = false;
+        printf("%-16s %8zu", it->first.c_str(), before.size());
+        for (int k = 0; k < 3; k++)
+        {
+            double old = std::max(Percentile(before, percents[k]), floor);
+            double now = std::max(Percentile(after, percents[k]), floor);
+            double change = (now - old) / old * 100;
+            if (change > limits[k] && before.size() >= REPLAY_MIN_COUNT)
+                isRegressed = true;
+            printf(" %9.1f (%9.1f) %+6.0f%%", now / 1000, old / 1000, change);
+        }
+        printf("%s\n", isRegressed ? "  SLOWER" : "");
+        if (isRegressed)
+            isWithinLimits = false;
+    }
+    return isWithinLimits;
+}
+
+static bool ParseOptions(ReplayOptions &options, int argc, char **argv, int first)
+{
+    for (int i = first; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        if (strcmp(argv[i], "-n") == 0)
+            options.runCount = std::max(atoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "-t") == 0)
+            options.medianPercent = atof(argv[++i]);
+        else if (strcmp(argv[i], "-T") == 0)
+            options.tailPercent = atof(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0)
+            options.floorMicroseconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "-i") == 0)
+            options.ignoredCommands.insert(argv[++i]);
+        else
+            return false;
+    }
+    return true;
+}
+
+static int Record(const std::string &mapPath, const std::string &commandPath,
+                  const std::string &recordPath, const ReplayOptions &options)
+{
+    std::vector<ReplayEntry> entries;
+    if (!ReadCommands(entries, commandPath))
+    {
+        fprintf(stderr, "Can not read %s\n", commandPath.c_str());
+        return 1;
+    }
+    if (!RunBest(entries, mapPath, options.runCount))
+        return 1;
+    if (!WriteRecord(entries, recordPath))
+    {
+        fprintf(stderr, "Can not write %s\n", recordPath.c_str());
+        return 1;
+    }
+
+    printf("Recorded %zu commands\n", entries.size() - 1);
+    return 0;
+}
+
+static int Check(const std::string &mapPath, const std::string &recordPath,
+                 const ReplayOptions &options)
+{
+    std::vector<ReplayEntry> recorded;
+    if (!ReadRecord(recorded, recordPath))
+    {
+        fprintf(stderr, "Can not read the record %s\n", recordPath.c_str());
+        return 1;
+    }
+
+    std::vector<ReplayEntry> replayed(recorded);
+    if (!RunBest(replayed, mapPath, options.runCount))
+        return 1;
+
+    int differenceCount = CompareOutputs(recorded, replayed, options);
+    bool isWithinLimits = CompareLatencies(recorded, replayed, options);
+    printf("%zu commands, %d with different output, latency %s\n",
+           recorded.size() - 1, differenceCount,
+           isWithinLimits ? "within limits" : "regressed");
+
+    if (differenceCount > 0)
+        return 1;
+    return isWithinLimits ? 0 : 2;
+}
+
+int main(int argc, char **argv)
+{
+    ReplayOptions options;
+    if (argc >= 5 && strcmp(argv[1], "record") == 0 && ParseOptions(options, argc, argv, 5))
+        return Record(argv[2], argv[3], argv[4], options);
+    if (argc >= 4 && strcmp(argv[1], "check") == 0 && ParseOptions(options, argc, argv, 4))
+        return Check(argv[2], argv[3], options);
+
+    PrintUsage();
+    return 1;
+}
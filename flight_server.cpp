@@ -0,0 +1,131 @@
+#include "command_processor.h"
+#include "output_writer.h"
+#include "trace.h"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// flight_server MAP_FILE [-u SOCKET_PATH] [-s] [-t TRACE_FILE]
+//   Runs the commands of command_processor.h against the map, read from
+//   stdin, or from the clients of the Unix socket (each on its own
+//   thread, results are written back to the client). Commands of
+//   different clients run one batch at a time. -s reports the command
+//   rate on stderr, -t traces the map load and the commands from stdin
+//   into a Chrome trace JSON file.
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: flight_server MAP_FILE [-u SOCKET_PATH] [-s] [-t TRACE_FILE]\n");
+}
+
+static void RunTimed(CommandProcessor &processor, int fileDescriptor, int outputDescriptor,
+                     bool isStatistics)
+{
+    long executedBefore = processor.ExecutedCount();
+    long invalidBefore = processor.InvalidCount();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    processor.Run(fileDescriptor, outputDescriptor);
+    WaitOutput();
+
+    if (!isStatistics)
+        return;
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long executed = processor.ExecutedCount() - executedBefore;
+    long invalid = processor.InvalidCount() - invalidBefore;
+    fprintf(stderr, "%ld commands (%ld invalid) in %.3f s, %.0f commands/s\n",
+            executed + invalid, invalid, seconds,
+            seconds > 0 ? (executed + invalid) / seconds : 0.0);
+}
+
+static int ServeSocket(flight_app &app, const std::string &socketPath, bool isStatistics)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Socket path is too long: %s\n", socketPath.c_str());
+        return 1;
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath.c_str());
+    if (listener < 0 ||
+        bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+        listen(listener, 16) < 0)
+    {
+        perror("flight_server");
+        return 1;
+    }
+
+    // A client that leaves early must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+    std::mutex appMutex;
+
+    while (true)
+    {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0)
+            continue;
+
+        // A processor per client, a waiting client does not hold up
+        // the others
+        std::thread([&app, &appMutex, client, isStatistics]
+                    {
+                        CommandProcessor processor(app, &appMutex);
+                        RunTimed(processor, client, client, isStatistics);
+                        close(client); })
+            .detach();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::string socketPath;
+    std::string tracePath;
+    bool isStatistics = false;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-u") == 0 && i + 1 < argc)
+            socketPath = argv[++i];
+        else if (strcmp(argv[i], "-s") == 0)
+            isStatistics = true;
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            tracePath = argv[++i];
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    SetTracing(!tracePath.empty());
+    flight_app app(argv[1]);
+    if (!socketPath.empty())
+        return ServeSocket(app, socketPath, isStatistics);
+
+    CommandProcessor processor(app);
+    RunTimed(processor, STDIN_FILENO, -1, isStatistics);
+    if (!tracePath.empty() && !WriteChromeTrace(tracePath))
+    {
+        fprintf(stderr, "Can not write trace %s\n", tracePath.c_str());
+        return 1;
+    }
+    return 0;
+}
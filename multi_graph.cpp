@@ -1,28 +1,62 @@
 #include "multi_graph.h"
 #include "Exceptions.h"
 #include "IntPair.h"
+#include "WeightPolicy.h"
+#include "edge_relax.h"
+#include "output_writer.h"
+#include "trace.h"
 #include <iostream>
-#include <iomanip>
 #include <fstream>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+// Out degree from which the vectorized relaxation pays off
+static const int SIMD_RELAX_MIN_DEGREE = 8;
+
+// -DNO_WEIGHT_SPECIALIZATION searches alpha 0 and 1 with the blend
+// kernels as well (flight_bench policy compares the two builds)
+#ifdef NO_WEIGHT_SPECIALIZATION
+static const bool IS_WEIGHT_SPECIALIZED = false;
+#else
+static const bool IS_WEIGHT_SPECIALIZED = true;
+#endif
 
 multi_graph::multi_graph()
+    : vertexIndices(std::make_shared<std::unordered_map<std::string, int>>()),
+      removedVertexCount(0), version(0), isConnectionsDirty(false),
+      landmarkTables(std::make_shared<LandmarkTables>()),
+      searchIndex(std::make_shared<SearchIndex>()), isSearchIndexDirty(true),
+      compactStep(0), isHotTreesDirty(false), isRegionsDirty(true)
 {
 }
 
 multi_graph::multi_graph(const std::string &filePath)
+    : vertexIndices(std::make_shared<std::unordered_map<std::string, int>>()),
+      removedVertexCount(0), version(0), isConnectionsDirty(false),
+      landmarkTables(std::make_shared<LandmarkTables>()),
+      searchIndex(std::make_shared<SearchIndex>()), isSearchIndexDirty(true),
+      compactStep(0), isHotTreesDirty(false), isRegionsDirty(true)
 {
-    // Tokens
-    std::string tokens[5];
+    TRACE_SCOPE("load map");
+    // Tokens (one extra to detect overlong lines)
+    const int MAX_TOKENS = 7;
+    std::string tokens[MAX_TOKENS];
     std::ifstream mapFile(filePath.c_str());
 
     if (!mapFile.is_open())
     {
-        std::cout << "Unable to open " << filePath << std::endl;
+        OutputBuffer &out = ThreadOutput();
+        out.Append("Unable to open ");
+        out.Append(filePath);
+        out.Append('\n');
+        FlushOutput();
         return;
     }
 
-    // Read line by line
+    // Read line by line, the line and stream buffers are reused
     std::string line;
+    std::istringstream stream;
     while (std::getline(mapFile, line))
     {
         // Empty Line Skip
@@ -34,8 +68,9 @@ multi_graph::multi_graph(const std::string &filePath)
 
         // Tokenize the line
         int i = 0;
-        std::istringstream stream(line);
-        while (stream >> tokens[i])
+        stream.clear();
+        stream.str(line);
+        while (i < MAX_TOKENS && stream >> tokens[i])
             i++;
 
         // Single token (Meaning it is a vertex)
@@ -54,15 +89,100 @@ multi_graph::multi_graph(const std::string &filePath)
             AddEdge(edgeName, vertexFromName, vertexToName,
                     weight0, weight1);
         }
+        // "DEP from to airline departure arrival" (A timetable entry)
+        else if (i == 6 && tokens[0] == "DEP")
+        {
+            float departureTime = static_cast<float>(std::atof(tokens[4].c_str()));
+            float arrivalTime = static_cast<float>(std::atof(tokens[5].c_str()));
+            AddDeparture(tokens[3], tokens[1], tokens[2],
+                         departureTime, arrivalTime);
+        }
+        // "MCT airport time" (Minimum connection time of an airport)
+        else if (i == 3 && tokens[0] == "MCT")
+        {
+            SetMinConnectionTime(tokens[1],
+                                 static_cast<float>(std::atof(tokens[2].c_str())));
+        }
+        // "REGION airport name" (Partition of an airport)
+        else if (i == 3 && tokens[0] == "REGION")
+        {
+            SetVertexRegion(tokens[1], tokens[2]);
+        }
         else
             std::cerr << "Token Size Mismatch" << std::endl;
     }
 }
 
+multi_graph::multi_graph(const multi_graph &other)
+    : vertexList(other.vertexList), vertexIndices(other.vertexIndices),
+      removedVertexCount(other.removedVertexCount), version(other.version),
+      edgeNames(other.edgeNames), edgeNameIds(other.edgeNameIds),
+      isConnectionsDirty(true), landmarkTables(other.landmarkTables),
+      searchIndex(other.searchIndex), isSearchIndexDirty(other.isSearchIndexDirty),
+      staleIndexVertices(other.staleIndexVertices), compactStep(other.compactStep),
+      isHotTreesDirty(true), reachability(other.reachability),
+      regionNames(other.regionNames), regionIds(other.regionIds), isRegionsDirty(true)
+{
+    // Hot origins stay registered, their trees are grown again
+    for (size_t t = 0; t < other.hotTrees.size(); t++)
+    {
+        DynamicTree tree;
+        tree.sourceName = other.hotTrees[t].sourceName;
+        tree.sourceIndex = other.hotTrees[t].sourceIndex;
+        tree.alpha = other.hotTrees[t].alpha;
+        hotTrees.push_back(tree);
+    }
+}
+
+void multi_graph::MakeItinerary(FlightItinerary &itinerary,
+                                const std::vector<int> &orderedVertexEdgeIndexList,
+                                float heuristicWeight) const
+{
+    const std::vector<int> &ove = orderedVertexEdgeIndexList;
+    size_t legCount = ove.size() / 2;
+
+    itinerary.vertexIndices.resize(legCount + 1);
+    itinerary.edgeIndices.resize(legCount);
+    itinerary.legWeight0.resize(legCount);
+    itinerary.legWeight1.resize(legCount);
+    itinerary.legCosts.resize(legCount);
+    itinerary.alpha = heuristicWeight;
+    itinerary.totalCost = 0;
+    itinerary.isCacheHit = false;
+
+    if (ove.empty())
+    {
+        itinerary.vertexIndices.clear();
+        return;
+    }
+
+    for (size_t i = 0; i < legCount; i++)
+    {
+        const GraphEdge &edge = vertexList[ove[2 * i]].edges[ove[2 * i + 1]];
+        itinerary.vertexIndices[i] = ove[2 * i];
+        itinerary.edgeIndices[i] = ove[2 * i + 1];
+        itinerary.legWeight0[i] = edge.weight[0];
+        itinerary.legWeight1[i] = edge.weight[1];
+        itinerary.legCosts[i] = Lerp(edge.weight[0], edge.weight[1], heuristicWeight);
+        itinerary.totalCost += itinerary.legCosts[i];
+    }
+    itinerary.vertexIndices[legCount] = ove[ove.size() - 1];
+}
+
 void multi_graph::PrintPath(const std::vector<int> &orderedVertexEdgeIndexList,
                            float heuristicWeight,
                            bool sameLine) const
 {
+    TRACE_SCOPE("print path");
+    FormatPath(ThreadOutput(), orderedVertexEdgeIndexList, heuristicWeight, sameLine);
+    FlushOutput();
+}
+
+void multi_graph::FormatPath(OutputBuffer &out,
+                             const std::vector<int> &orderedVertexEdgeIndexList,
+                             float heuristicWeight,
+                             bool sameLine) const
+{
 
     // Name is too long
     const std::vector<int> &ove = orderedVertexEdgeIndexList;
@@ -78,15 +198,16 @@ void multi_graph::PrintPath(const std::vector<int> &orderedVertexEdgeIndexList,
         if (vertexId >= static_cast<int>(vertexList.size()))
         {
             // Return if there is a bad vertex id
-            std::cout << "VertexId " << vertexId
-                      << " not found!" << std::endl;
+            out.Append("VertexId ");
+            out.AppendInt(vertexId);
+            out.Append(" not found!\n");
             return;
         }
 
         const GraphVertex &vertex = vertexList[vertexId];
-        std::cout << vertex.name;
+        out.Append(vertex.name);
         if (!sameLine)
-            std::cout << "\n";
+            out.Append('\n');
         // Only find and print the weight if next is available
         if (i == ove.size() - 1)
             break;
@@ -94,8 +215,9 @@ void multi_graph::PrintPath(const std::vector<int> &orderedVertexEdgeIndexList,
         if (nextVertexId >= static_cast<int>(vertexList.size()))
         {
             // Return if there is a bad vertex id
-            std::cout << "VertexId " << vertexId
-                      << " not found!" << std::endl;
+            out.Append("VertexId ");
+            out.AppendInt(vertexId);
+            out.Append(" not found!\n");
             return;
         }
 
@@ -104,8 +226,11 @@ void multi_graph::PrintPath(const std::vector<int> &orderedVertexEdgeIndexList,
         if (localEdgeId >= static_cast<int>(vertex.edges.size()))
         {
             // Return if there is a bad vertex id
-            std::cout << "EdgeId " << localEdgeId
-                      << " not found in " << vertexId << "!" << std::endl;
+            out.Append("EdgeId ");
+            out.AppendInt(localEdgeId);
+            out.Append(" not found in ");
+            out.AppendInt(vertexId);
+            out.Append("!\n");
             return;
         }
 
@@ -115,43 +240,70 @@ void multi_graph::PrintPath(const std::vector<int> &orderedVertexEdgeIndexList,
         float weight = Lerp(edge.weight[0], edge.weight[1],
                             heuristicWeight);
 
-        std::cout << "-" << std::setfill('-')
-                  << std::setw(4)
-                  << weight << "->";
+        out.Append('-');
+        out.AppendFloat(weight, 4, '-');
+        out.Append("->");
     }
     // Print endline on the last vertex if same line is set
     if (sameLine)
-        std::cout << "\n";
-    // Reset fill value because it "sticks" to the std out
-    std::cout << std::setfill(' ');
-    std::cout.flush();
+        out.Append('\n');
+}
+
+void multi_graph::PrintTimedPath(const std::vector<int> &orderedVertexEdgeIndexList,
+                                 const std::vector<FlightDeparture> &legTimes) const
+{
+    const std::vector<int> &ove = orderedVertexEdgeIndexList;
+    if (ove.size() < 3 || legTimes.size() != ove.size() / 2)
+        return;
+
+    OutputBuffer &out = ThreadOutput();
+    for (size_t i = 0; i < ove.size(); i += 2)
+    {
+        out.Append(vertexList[ove[i]].name);
+        if (i == ove.size() - 1)
+            break;
+
+        const FlightDeparture &leg = legTimes[i / 2];
+        out.Append("-[");
+        out.AppendFloat(leg.departureTime);
+        out.Append('/');
+        out.AppendFloat(leg.arrivalTime);
+        out.Append("](");
+        out.Append(edgeNames[vertexList[ove[i]].edges[ove[i + 1]].nameId]);
+        out.Append(")->");
+    }
+    out.Append('\n');
+    FlushOutput();
 }
 
 void multi_graph::PrintEntireGraph() const
 {
+    OutputBuffer &out = ThreadOutput();
     for (size_t i = 0; i < vertexList.size(); i++)
     {
         const GraphVertex &v = vertexList[i];
-        std::cout << v.name << "\n";
+        if (v.isRemoved)
+            continue;
+        out.Append(v.name);
+        out.Append('\n');
         for (size_t j = 0; j < v.edges.size(); j++)
         {
             const GraphEdge &edge = v.edges[j];
 
             // List the all vertex names and weight
-            std::cout << "    -"
-                      << std::setfill('-')
-                      << std::setw(4) << edge.weight[0]
-                      << "-"
-                      << std::setw(4) << edge.weight[1]
-                      << "-> ";
-            std::cout << vertexList[edge.endVertexIndex].name;
-            std::cout << " (" << edge.name << ")"
-                      << "\n";
+            out.Append("    -");
+            out.AppendFloat(edge.weight[0], 4, '-');
+            out.Append('-');
+            out.AppendFloat(edge.weight[1], 4, '-');
+            out.Append("-> ");
+            out.Append(vertexList[edge.endVertexIndex].name);
+            out.Append(" (");
+            out.Append(edgeNames[edge.nameId]);
+            out.Append(")\n");
         }
     }
 
-    std::cout << std::setfill(' ');
-    std::cout.flush();
+    FlushOutput();
 }
 
 float multi_graph::Lerp(float w0, float w1, float alpha)
@@ -159,498 +311,3104 @@ float multi_graph::Lerp(float w0, float w1, float alpha)
     return w0 * (1 - alpha) + w1 * alpha;
 }
 
-void multi_graph::InsertVertex(const std::string &vertexName)
+int multi_graph::FindVertexIndex(const std::string &vertexName) const
 {
-    for (int i = 0; i < vertexList.size(); i++)
-    {
-
-        if (vertexList[i].name == vertexName)
-            throw DuplicateVertexException(vertexName);
-    }
-
-    GraphVertex new_vertex;
-    new_vertex.name = vertexName;
-    vertexList.push_back(new_vertex);
+    std::unordered_map<std::string, int>::const_iterator it = vertexIndices->find(vertexName);
+    if (it == vertexIndices->end())
+        return -1;
+    return it->second;
 }
 
-void multi_graph::RemoveVertex(const std::string &vertexName)
+std::unordered_map<std::string, int> &multi_graph::WritableVertexIndices()
 {
-    for (int i = 0; i < vertexList.size(); i++)
-    {
-
-        if (vertexList[i].name == vertexName)
-        {
-            vertexList[i].edges.clear();
-
-            for (int k = 0; k < vertexList.size(); k++)
-            {
-                for (int j = 0; j < vertexList[k].edges.size(); j++)
-                {
-                    if (vertexList[k].edges[j].endVertexIndex == i)
-                    {
-                        vertexList[k].edges.erase(vertexList[k].edges.begin() + j);
-                        break;
-                    }
-                }
-            }
-
-            vertexList.erase(vertexList.begin() + i);
-            return;
-        }
-    }
-
-    throw VertexNotFoundException(vertexName);
+    // Shared with a snapshot until the first vertex change
+    if (vertexIndices.use_count() != 1)
+        vertexIndices = std::make_shared<std::unordered_map<std::string, int>>(*vertexIndices);
+    return *vertexIndices;
 }
 
-void multi_graph::AddEdge(const std::string &edgeName,
-                         const std::string &vertexFromName,
-                         const std::string &vertexToName,
-                         float weight0, float weight1)
+int multi_graph::InternEdgeName(const std::string &edgeName)
 {
-    bool flag2 = false;
-    int index;
-    for (index = 0; index < vertexList.size(); index++)
-    {
-        if (vertexList[index].name == vertexToName)
-        {
-            flag2 = true;
-            break;
-        }
-    } // index to vertexToName is preserved
+    std::unordered_map<std::string, int>::const_iterator it = edgeNameIds.find(edgeName);
+    if (it != edgeNameIds.end())
+        return it->second;
+
+    // Names are never released, there are only a few airlines
+    int nameId = static_cast<int>(edgeNames.size());
+    edgeNames.push_back(edgeName);
+    edgeNameIds[edgeName] = nameId;
+    return nameId;
+}
 
-    if (!flag2)
-        throw VertexNotFoundException(vertexToName);
+int multi_graph::FindEdgeNameId(const std::string &edgeName) const
+{
+    std::unordered_map<std::string, int>::const_iterator it = edgeNameIds.find(edgeName);
+    if (it == edgeNameIds.end())
+        return -1;
+    return it->second;
+}
 
-    for (int i = 0; i < vertexList.size(); i++)
+void multi_graph::RemoveInEdge(int vertexIndex, int inSlot)
+{
+    // Order of the incoming lists is irrelevant, the last entry moves
+    // into the slot and its edge is told
+    GraphVertex &vertex = vertexList[vertexIndex];
+    int last = static_cast<int>(vertex.inVertices.size()) - 1;
+    if (inSlot != last)
     {
+        vertex.inVertices[inSlot] = vertex.inVertices[last];
+        vertex.inEdges[inSlot] = vertex.inEdges[last];
+        vertexList[vertex.inVertices[inSlot]].edges[vertex.inEdges[inSlot]].inSlot = inSlot;
+    }
+    vertex.inVertices.pop_back();
+    vertex.inEdges.pop_back();
+}
 
-        if (vertexList[i].name == vertexFromName)
-        {
+void multi_graph::UpdateInEdges(int vertexIndex, size_t begin)
+{
+    GraphEdgeList &edges = vertexList[vertexIndex].edges;
+    for (size_t k = begin; k < edges.size(); k++)
+        vertexList[edges[k].endVertexIndex].inEdges[edges[k].inSlot] = static_cast<int>(k);
+}
 
-            for (int q = 0; q < vertexList[i].edges.size(); q++)
-            {
-                if (vertexList[i].edges[q].name == edgeName && vertexList[i].edges[q].endVertexIndex == index)
-                    throw SameNamedEdgeException(edgeName, vertexFromName, vertexToName);
-            }
+void multi_graph::InsertVertex(const std::string &vertexName)
+{
+    if (FindVertexIndex(vertexName) != -1)
+        throw DuplicateVertexException(vertexName);
 
-            GraphEdge new_edge;
-            new_edge.name = edgeName;
-            new_edge.weight[0] = weight0;
-            new_edge.weight[1] = weight1;
-            new_edge.endVertexIndex = index;
-            vertexList[i].edges.push_back(new_edge);
-            return;
-        }
-    }
+    GraphVertex new_vertex;
+    new_vertex.name = vertexName;
+    new_vertex.isRemoved = false;
+    vertexList.push_back(new_vertex);
+    WritableVertexIndices()[vertexName] = static_cast<int>(vertexList.size()) - 1;
+    SearchIndexChanged(static_cast<int>(vertexList.size()) - 1);
+    ClearReachability();
+    isRegionsDirty = true;
+    // Landmark tables and hot trees hold one entry per vertex
+    TopologyChanged();
+}
 
-    throw VertexNotFoundException(vertexFromName);
+void multi_graph::RemoveVertex(const std::string &vertexName)
+{
+    std::vector<int> affectedVertexIndices;
+    RemoveVertex(vertexName, affectedVertexIndices);
 }
 
-void multi_graph::RemoveEdge(const std::string &edgeName,
-                            const std::string &vertexFromName,
-                            const std::string &vertexToName)
+void multi_graph::RemoveVertex(const std::string &vertexName,
+                               std::vector<int> &affectedVertexIndices)
 {
-    bool flag1 = false;
-    for (int i = 0; i < vertexList.size(); i++)
-    {
-        if (vertexList[i].name == vertexFromName)
-        {
-            flag1 = true;
-            break;
-        }
-    }
+    int index = FindVertexIndex(vertexName);
+    if (index == -1)
+        throw VertexNotFoundException(vertexName);
 
-    if (!flag1)
-        throw VertexNotFoundException(vertexFromName);
+    GraphVertex &vertex = vertexList[index];
 
-    flag1 = false;
-    for (int i = 0; i < vertexList.size(); i++)
+    // Outgoing edges, only the targets' incoming lists refer to them
+    for (size_t i = 0; i < vertex.edges.size(); i++)
     {
-        if (vertexList[i].name == vertexToName)
-        {
-            flag1 = true;
-            break;
-        }
+        int toIndex = vertex.edges[i].endVertexIndex;
+        if (toIndex != index)
+            RemoveInEdge(toIndex, vertex.edges[i].inSlot);
     }
 
-    if (!flag1)
-        throw VertexNotFoundException(vertexToName);
-
-    flag1 = false;
+    // Incoming edges, every source vertex loses its edges to this vertex
+    // (local edge indices of these vertices shift, report them)
+    std::vector<int> sources(vertex.inVertices.begin(), vertex.inVertices.end());
+    std::sort(sources.begin(), sources.end());
+    sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
 
-    for (int i = 0; i < vertexList.size(); i++)
+    affectedVertexIndices.clear();
+    affectedVertexIndices.push_back(index);
+    for (size_t i = 0; i < sources.size(); i++)
     {
-        int k = 0;
-        for (k = 0; k < vertexList[i].edges.size(); k++)
-        {
+        if (sources[i] == index)
+            continue;
 
-            if (vertexList[i].edges[k].name == edgeName)
-            {
-                flag1 = true;
-                break;
-            }
+        GraphEdgeList &edges = vertexList[sources[i]].edges;
+        size_t k = 0;
+        for (size_t j = 0; j < edges.size(); j++)
+        {
+            if (edges[j].endVertexIndex != index)
+                edges[k++] = edges[j];
         }
-
-        if (!flag1)
-            throw EdgeNotFoundException(vertexFromName, edgeName);
-
-        vertexList[i].edges.erase(vertexList[i].edges.begin() + k);
-        return;
+        edges.resize(k);
+        UpdateInEdges(sources[i], 0);
+        affectedVertexIndices.push_back(sources[i]);
+        SearchIndexChanged(sources[i]);
     }
+
+    vertex.edges.clear();
+    vertex.inVertices.clear();
+    vertex.inEdges.clear();
+    vertex.isRemoved = true;
+    SearchIndexChanged(index);
+    isConnectionsDirty = true;
+    MarkReachabilityInexact();
+    isRegionsDirty = true;
+    TopologyChanged();
+    WritableVertexIndices().erase(vertexName);
+    removedVertexCount++;
 }
 
-bool multi_graph::HeuristicShortestPath(std::vector<int> &orderedVertexEdgeIndexList,
-                                       const std::string &vertexNameFrom,
-                                       const std::string &vertexNameTo,
-                                       float heuristicWeight) const
+void multi_graph::CompactVertices(std::vector<int> &oldToNewIndex)
 {
-    MaxPairHeap<int, GraphVertex> pq;
-
-    std::vector<Pair<int, GraphVertex>> pairCounts;
-    std::vector<int> counts;
-    std::vector<int> prev;
-    std::vector<int> Edges;
-
-    Pair<int, GraphVertex> a;
+    oldToNewIndex.assign(vertexList.size(), -1);
 
-    for (int i = 0; i < vertexList.size(); i++)
+    // Assign new indices by keeping the relative order
+    int newIndex = 0;
+    for (size_t i = 0; i < vertexList.size(); i++)
     {
-        pairCounts.push_back(a);
-        counts.push_back(50000);
-        prev.push_back(-1);
-        Edges.push_back(-1);
+        if (!vertexList[i].isRemoved)
+            oldToNewIndex[i] = newIndex++;
     }
 
-    for (int i = 0; i < pairCounts.size(); i++)
-    {
-
-        Pair<int, GraphVertex> pair;
-        pair.value = vertexList[i]; // put the vertex here
-        pair.key = i;               // put its distance from start here
-        pairCounts[i] = pair;
-    }
+    RenumberVertices(oldToNewIndex, newIndex);
+}
 
-    int index;
-    for (index = 0; index < vertexList.size(); index++)
+void multi_graph::ReorderVertices(std::vector<int> &oldToNewIndex)
+{
+    // Reverse Cuthill-McKee over the edges of both directions, adjacent
+    // airports get close indices and so do their search array entries
+    std::vector<int> degrees(vertexList.size());
+    std::vector<int> starts;
+    for (size_t i = 0; i < vertexList.size(); i++)
     {
-        if (vertexList[index].name == vertexNameFrom)
-            break;
-    } // we have the index of the first vertex
-    int index_first = index;
+        degrees[i] = static_cast<int>(vertexList[i].edges.size() + vertexList[i].inVertices.size());
+        if (!vertexList[i].isRemoved)
+            starts.push_back(static_cast<int>(i));
+    }
 
-    int index_end;
-    for (index_end = 0; index_end < vertexList.size(); index_end++)
+    auto isLowerDegree = [&degrees](int a, int b)
     {
-        if (vertexList[index_end].name == vertexNameTo)
-            break;
-    } // we have the index of the last vertex
-
-    counts[index] = 0; // assigning A->A to 0
-    prev[index] = -10;
+        return degrees[a] < degrees[b];
+    };
+    // Every component starts from its lowest degree vertex
+    std::stable_sort(starts.begin(), starts.end(), isLowerDegree);
 
-    // implementing dijkstra's algo
-    pq.push(pairCounts[index]);
+    std::vector<int> order;
+    order.reserve(starts.size());
+    std::vector<char> isVisited(vertexList.size(), 0);
+    std::vector<int> neighbours;
 
-    while (!pq.empty())
+    for (size_t s = 0; s < starts.size(); s++)
     {
+        if (isVisited[starts[s]])
+            continue;
+        isVisited[starts[s]] = 1;
+        order.push_back(starts[s]);
 
-        Pair<int, GraphVertex> a = pq.top();
-
-        pq.pop();
-
-        index = a.key;
-
-        for (int i = 0; i < a.value.edges.size(); i++)
+        // Breadth first, neighbours of a vertex by increasing degree
+        for (size_t head = order.size() - 1; head < order.size(); head++)
         {
-
-            float weight = Lerp(a.value.edges[i].weight[0], a.value.edges[i].weight[1], heuristicWeight);
-
-            int next_index = a.value.edges[i].endVertexIndex;
-
-            if (counts[index] + weight < counts[next_index])
+            const GraphVertex &vertex = vertexList[order[head]];
+            neighbours.clear();
+            for (size_t k = 0; k < vertex.edges.size(); k++)
             {
-
-                counts[next_index] = counts[index] + weight;
-                prev[next_index] = a.key;
-                Edges[next_index] = i;
-
-                pq.push(pairCounts[next_index]);
+                int next = vertex.edges[k].endVertexIndex;
+                if (!isVisited[next])
+                {
+                    isVisited[next] = 1;
+                    neighbours.push_back(next);
+                }
+            }
+            for (size_t k = 0; k < vertex.inVertices.size(); k++)
+            {
+                int next = vertex.inVertices[k];
+                if (!isVisited[next])
+                {
+                    isVisited[next] = 1;
+                    neighbours.push_back(next);
+                }
             }
-        }
 
-        if (a.key == index_end)
-            break;
+            std::stable_sort(neighbours.begin(), neighbours.end(), isLowerDegree);
+            order.insert(order.end(), neighbours.begin(), neighbours.end());
+        }
     }
 
-    int index2 = index_end;
+    int vertexCount = static_cast<int>(order.size());
+    oldToNewIndex.assign(vertexList.size(), -1);
+    for (int k = 0; k < vertexCount; k++)
+        oldToNewIndex[order[k]] = vertexCount - 1 - k;
 
-    for (; index_first != index_end; index_end = prev[index_end])
-    {
-
-        if (index_end == -1)
-            return false;
-    }
-
-    orderedVertexEdgeIndexList.clear();
+    RenumberVertices(oldToNewIndex, vertexCount);
+}
 
-    for (; index_first != index2; index2 = prev[index2])
+void multi_graph::RenumberVertices(const std::vector<int> &oldToNewIndex, int vertexCount)
+{
+    // Remap every stored index and move the live vertices in one pass,
+    // local edge indices keep their order
+    SharedChunks<GraphVertex> renumbered(vertexCount);
+    for (size_t i = 0; i < vertexList.size(); i++)
     {
+        if (oldToNewIndex[i] == -1)
+            continue;
 
-        orderedVertexEdgeIndexList.insert(orderedVertexEdgeIndexList.begin(), index2);
+        GraphVertex &vertex = vertexList[i];
+        for (size_t j = 0; j < vertex.edges.size(); j++)
+            vertex.edges[j].endVertexIndex = oldToNewIndex[vertex.edges[j].endVertexIndex];
+        for (size_t j = 0; j < vertex.inVertices.size(); j++)
+            vertex.inVertices[j] = oldToNewIndex[vertex.inVertices[j]];
 
-        orderedVertexEdgeIndexList.insert(orderedVertexEdgeIndexList.begin(), Edges[index2]);
+        WritableVertexIndices()[vertex.name] = oldToNewIndex[i];
+        renumbered[oldToNewIndex[i]] = std::move(vertex);
     }
 
-    orderedVertexEdgeIndexList.insert(orderedVertexEdgeIndexList.begin(), index2);
-
-    orderedVertexEdgeIndexList.insert(orderedVertexEdgeIndexList.begin(), Edges[index2]);
-
-    orderedVertexEdgeIndexList.erase(orderedVertexEdgeIndexList.begin());
-
-    return true;
+    vertexList.swap(renumbered);
+    removedVertexCount = 0;
+    isConnectionsDirty = true;
+    ClearReachability();
+    isRegionsDirty = true;
+    isSearchIndexDirty = true;
+    TopologyChanged();
 }
 
-bool multi_graph::FilteredShortestPath(std::vector<int> &orderedVertexEdgeIndexList,
-                                      const std::string &vertexNameFrom,
-                                      const std::string &vertexNameTo,
-                                      float heuristicWeight,
-                                      const std::vector<std::string> &edgeNames) const
+void multi_graph::AddEdge(const std::string &edgeName,
+                         const std::string &vertexFromName,
+                         const std::string &vertexToName,
+                         float weight0, float weight1)
 {
-    MaxPairHeap<int, GraphVertex> pq;
-
-    std::vector<Pair<int, GraphVertex>> pairCounts;
-    std::vector<int> counts;
-    std::vector<int> prev;
-    std::vector<int> Edges;
+    int index = FindVertexIndex(vertexToName);
+    if (index == -1)
+        throw VertexNotFoundException(vertexToName);
 
-    Pair<int, GraphVertex> a;
+    int i = FindVertexIndex(vertexFromName);
+    if (i == -1)
+        throw VertexNotFoundException(vertexFromName);
 
-    for (int i = 0; i < vertexList.size(); i++)
+    int nameId = InternEdgeName(edgeName);
+    for (int q = 0; q < vertexList[i].edges.size(); q++)
     {
-        pairCounts.push_back(a);
-        counts.push_back(50000);
-        prev.push_back(-1);
-        Edges.push_back(-1);
+        if (vertexList[i].edges[q].nameId == nameId && vertexList[i].edges[q].endVertexIndex == index)
+            throw SameNamedEdgeException(edgeName, vertexFromName, vertexToName);
     }
 
-    for (int i = 0; i < pairCounts.size(); i++)
+    GraphEdge new_edge;
+    new_edge.nameId = nameId;
+    new_edge.weight[0] = weight0;
+    new_edge.weight[1] = weight1;
+    new_edge.endVertexIndex = index;
+    new_edge.inSlot = static_cast<int>(vertexList[index].inVertices.size());
+    vertexList[i].edges.push_back(new_edge);
+    vertexList[index].inVertices.push_back(i);
+    vertexList[index].inEdges.push_back(static_cast<int>(vertexList[i].edges.size()) - 1);
+    ReachabilityEdgeAdded(i, index, nameId);
+    RegionEdgeChanged(i, index);
+    SearchIndexChanged(i);
+
+    // Local indices of the other edges stay, hot trees are repaired as
+    // for an edge that got cheaper than infinity
+    ClearLandmarks();
+    version++;
+    if (!isHotTreesDirty)
     {
-
-        Pair<int, GraphVertex> pair;
-        pair.value = vertexList[i]; // put the vertex here
-        pair.key = i;               // put its distance from start here
-        pairCounts[i] = pair;
+        int k = static_cast<int>(vertexList[i].edges.size()) - 1;
+        for (size_t t = 0; t < hotTrees.size(); t++)
+            RepairHotTree(hotTrees[t], i, k, std::numeric_limits<float>::infinity(),
+                          Lerp(weight0, weight1, hotTrees[t].alpha));
     }
+}
 
-    int index;
-    for (index = 0; index < vertexList.size(); index++)
-    {
-        if (vertexList[index].name == vertexNameFrom)
-            break;
-    } // we have the index of the first vertex
-    int index_first = index;
-
-    int index_end;
-    for (index_end = 0; index_end < vertexList.size(); index_end++)
-    {
-        if (vertexList[index_end].name == vertexNameTo)
-            break;
-    } // we have the index of the last vertex
-
-    counts[index] = 0; // assigning A->A to 0
-    prev[index] = -10;
+void multi_graph::RemoveEdge(const std::string &edgeName,
+                            const std::string &vertexFromName,
+                            const std::string &vertexToName)
+{
+    int i = FindVertexIndex(vertexFromName);
+    if (i == -1)
+        throw VertexNotFoundException(vertexFromName);
 
-    // implementing dijkstra's algo
-    pq.push(pairCounts[index]);
+    int index = FindVertexIndex(vertexToName);
+    if (index == -1)
+        throw VertexNotFoundException(vertexToName);
 
-    while (!pq.empty())
+    int nameId = FindEdgeNameId(edgeName);
+    GraphEdgeList &edges = vertexList[i].edges;
+    for (size_t k = 0; k < edges.size(); k++)
     {
-
-        Pair<int, GraphVertex> a = pq.top();
-
-        pq.pop();
-
-        index = a.key;
-
-        for (int i = 0; i < a.value.edges.size(); i++)
+        if (edges[k].nameId == nameId && edges[k].endVertexIndex == index)
         {
+            if (!edges[k].departures.empty())
+                isConnectionsDirty = true;
+            // Later local edge indices shift
+            else if (k + 1 != edges.size())
+                isConnectionsDirty = true;
+            RemoveInEdge(index, edges[k].inSlot);
+            edges.erase(edges.begin() + k);
+            UpdateInEdges(i, k);
+            MarkReachabilityInexact();
+            RegionEdgeChanged(i, index);
+            SearchIndexChanged(i);
+            TopologyChanged();
+            return;
+        }
+    }
 
-            bool flag = false;
-
-            for (int k = 0; k < edgeNames.size(); k++)
-            {
-                if (a.value.edges[i].name == edgeNames[k])
-                {
-                    flag = true;
-                    break;
-                }
-            }
+    throw EdgeNotFoundException(vertexFromName, edgeName);
+}
 
-            if (flag)
-                continue;
+int multi_graph::UpdateEdgeWeights(const std::string &edgeName,
+                                   const std::string &vertexFromName,
+                                   const std::string &vertexToName,
+                                   float weight0, float weight1)
+{
+    int i = FindVertexIndex(vertexFromName);
+    if (i == -1)
+        throw VertexNotFoundException(vertexFromName);
 
-            float weight = Lerp(a.value.edges[i].weight[0], a.value.edges[i].weight[1], heuristicWeight);
+    int index = FindVertexIndex(vertexToName);
+    if (index == -1)
+        throw VertexNotFoundException(vertexToName);
 
-            int next_index = a.value.edges[i].endVertexIndex;
+    int nameId = FindEdgeNameId(edgeName);
+    GraphEdgeList &edges = vertexList[i].edges;
+    for (size_t k = 0; k < edges.size(); k++)
+    {
+        if (edges[k].nameId != nameId || edges[k].endVertexIndex != index)
+            continue;
 
-            if (counts[index] + weight < counts[next_index])
-            {
+        version++;
+        // Flights between regions are read from the graph
+        if (!isRegionsDirty && RegionOf(i) == RegionOf(index))
+            RegionChanged(RegionOf(i));
+        float old0 = edges[k].weight[0];
+        float old1 = edges[k].weight[1];
+        edges[k].weight[0] = weight0;
+        edges[k].weight[1] = weight1;
+
+        // Same layout, patched in place (rebuilt when the compact
+        // encoding can not hold the new weights). A shared index is not
+        // written, the vertex is searched over its edges instead.
+        bool isIndexed = !isSearchIndexDirty && IsIndexed(i);
+        if (isIndexed && searchIndex.use_count() != 1)
+            SearchIndexChanged(i);
+        else if (isIndexed && !searchIndex->isCompactIndex)
+        {
+            searchIndex->edgeWeight0[searchIndex->edgeOffsets[i] + k] = weight0;
+            searchIndex->edgeWeight1[searchIndex->edgeOffsets[i] + k] = weight1;
+        }
+        else if (isIndexed)
+        {
+            int offset = searchIndex->edgeOffsets[i] + k;
+            if (!EncodeWeight(searchIndex->compactWeight0[offset], weight0) ||
+                !EncodeWeight(searchIndex->compactWeight1[offset], weight1))
+                isSearchIndexDirty = true;
+        }
 
-                counts[next_index] = counts[index] + weight;
-                prev[next_index] = a.key;
-                Edges[next_index] = i;
+        // Lower bounds survive increases only
+        if (weight0 < old0 || weight1 < old1)
+            ClearLandmarks();
 
-                pq.push(pairCounts[next_index]);
+        if (!isHotTreesDirty)
+        {
+            for (size_t t = 0; t < hotTrees.size(); t++)
+            {
+                float alpha = hotTrees[t].alpha;
+                RepairHotTree(hotTrees[t], i, static_cast<int>(k),
+                              Lerp(old0, old1, alpha), Lerp(weight0, weight1, alpha));
             }
         }
-
-        if (a.key == index_end)
-            break;
+        return static_cast<int>(k);
     }
 
-    int index2 = index_end;
-
-    for (; index_first != index_end; index_end = prev[index_end])
-    {
-
-        if (index_end == -1)
-            return false;
-    }
+    throw EdgeNotFoundException(vertexFromName, edgeName);
+}
 
-    orderedVertexEdgeIndexList.insert(orderedVertexEdgeIndexList.begin(), index2);
+void multi_graph::AddDeparture(const std::string &edgeName,
+                               const std::string &vertexFromName,
+                               const std::string &vertexToName,
+                               float departureTime, float arrivalTime)
+{
+    int i = FindVertexIndex(vertexFromName);
+    if (i == -1)
+        throw VertexNotFoundException(vertexFromName);
 
-    orderedVertexEdgeIndexList.insert(orderedVertexEdgeIndexList.begin(), Edges[index2]);
+    int index = FindVertexIndex(vertexToName);
+    if (index == -1)
+        throw VertexNotFoundException(vertexToName);
 
-    for (; index_first != index2; index2 = prev[index2])
+    int nameId = FindEdgeNameId(edgeName);
+    GraphEdgeList &edges = vertexList[i].edges;
+    for (size_t k = 0; k < edges.size(); k++)
     {
-
-        orderedVertexEdgeIndexList.insert(orderedVertexEdgeIndexList.begin(), prev[index2]);
-
-        orderedVertexEdgeIndexList.insert(orderedVertexEdgeIndexList.begin(), Edges[prev[index2]]);
+        if (edges[k].nameId == nameId && edges[k].endVertexIndex == index)
+        {
+            FlightDeparture departure;
+            departure.departureTime = departureTime;
+            departure.arrivalTime = arrivalTime;
+            edges[k].departures.push_back(departure);
+            isConnectionsDirty = true;
+            return;
+        }
     }
 
-    orderedVertexEdgeIndexList.erase(orderedVertexEdgeIndexList.begin());
+    throw EdgeNotFoundException(vertexFromName, edgeName);
+}
 
-    return true;
+void multi_graph::SetMinConnectionTime(const std::string &vertexName,
+                                       float minConnectionTime)
+{
+    int index = FindVertexIndex(vertexName);
+    if (index == -1)
+        throw VertexNotFoundException(vertexName);
+
+    vertexList[index].minConnectionTime = minConnectionTime;
 }
 
-int multi_graph::BiDirectionalEdgeCount() const
+bool multi_graph::ReadDelta(std::vector<GraphChange> &changes, const std::string &filePath)
 {
-    int counter = 0;
+    // Tokens (one extra to detect overlong lines)
+    const int MAX_TOKENS = 7;
+    std::string tokens[MAX_TOKENS];
+    std::ifstream deltaFile(filePath.c_str());
 
-    for (int i = 0; i < vertexList.size(); i++)
+    if (!deltaFile.is_open())
     {
-        for (int k = 0; k < vertexList[i].edges.size(); k++)
+        OutputBuffer &out = ThreadOutput();
+        out.Append("Unable to open ");
+        out.Append(filePath);
+        out.Append('\n');
+        FlushOutput();
+        return false;
+    }
+
+    std::string line;
+    std::istringstream stream;
+    while (std::getline(deltaFile, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        int i = 0;
+        stream.clear();
+        stream.str(line);
+        while (i < MAX_TOKENS && stream >> tokens[i])
+            i++;
+
+        GraphChange change;
+        // Edge changes, as the edge lines of the map after the keyword
+        if ((i == 6 && (tokens[0] == "ADD" || tokens[0] == "UPDATE" || tokens[0] == "DEP")) ||
+            (i == 4 && tokens[0] == "REMOVE"))
+        {
+            if (tokens[0] == "ADD")
+                change.type = GRAPH_CHANGE_ADD_EDGE;
+            else if (tokens[0] == "UPDATE")
+                change.type = GRAPH_CHANGE_UPDATE_EDGE;
+            else if (tokens[0] == "DEP")
+                change.type = GRAPH_CHANGE_ADD_DEPARTURE;
+            else
+                change.type = GRAPH_CHANGE_REMOVE_EDGE;
+            change.vertexFromName = tokens[1];
+            change.vertexToName = tokens[2];
+            change.edgeName = tokens[3];
+            if (i == 6)
+            {
+                change.values[0] = static_cast<float>(std::atof(tokens[4].c_str()));
+                change.values[1] = static_cast<float>(std::atof(tokens[5].c_str()));
+            }
+        }
+        else if (i == 2 && tokens[0] == "ADD_AIRPORT")
+        {
+            change.type = GRAPH_CHANGE_ADD_VERTEX;
+            change.vertexFromName = tokens[1];
+        }
+        else if (i == 2 && tokens[0] == "REMOVE_AIRPORT")
+        {
+            change.type = GRAPH_CHANGE_REMOVE_VERTEX;
+            change.vertexFromName = tokens[1];
+        }
+        else
+        {
+            std::cerr << "Token Size Mismatch" << std::endl;
+            continue;
+        }
+        changes.push_back(change);
+    }
+    return true;
+}
+
+void multi_graph::ApplyChanges(const std::vector<GraphChange> &changes, GraphChangeResult &result)
+{
+    TRACE_SCOPE("ApplyChanges");
+    result.isApplied.assign(changes.size(), 0);
+    result.shiftedVertices.clear();
+    result.costlierEdges.clear();
+    result.cheaperEdges.clear();
+    result.appliedCount = 0;
+
+    // The changes clear the landmarks one by one, they are put back when
+    // no distance can have shrunk. The search index and regions are
+    // rebuilt once by the next search that needs them, hot trees take
+    // added edges in place.
+    size_t vertexCount = vertexList.size();
+    std::shared_ptr<LandmarkTables> keptLandmarks = landmarkTables;
+
+    std::vector<int> affectedVertexIndices;
+    for (size_t c = 0; c < changes.size(); c++)
+    {
+        const GraphChange &change = changes[c];
+        try
+        {
+            switch (change.type)
+            {
+            case GRAPH_CHANGE_ADD_EDGE:
+            {
+                AddEdge(change.edgeName, change.vertexFromName, change.vertexToName,
+                        change.values[0], change.values[1]);
+                int i = FindVertexIndex(change.vertexFromName);
+                GraphEdgeChange added = {i, static_cast<int>(vertexList[i].edges.size()) - 1,
+                                         vertexList[i].edges.back().endVertexIndex,
+                                         change.values[0], change.values[1]};
+                result.cheaperEdges.push_back(added);
+                break;
+            }
+            case GRAPH_CHANGE_REMOVE_EDGE:
+                RemoveEdge(change.edgeName, change.vertexFromName, change.vertexToName);
+                result.shiftedVertices.push_back(FindVertexIndex(change.vertexFromName));
+                break;
+            case GRAPH_CHANGE_UPDATE_EDGE:
+            {
+                GraphEdge edge = getEdge(change.edgeName, change.vertexFromName, change.vertexToName);
+                int k = UpdateEdgeWeights(change.edgeName, change.vertexFromName, change.vertexToName,
+                                          change.values[0], change.values[1]);
+                GraphEdgeChange updated = {FindVertexIndex(change.vertexFromName), k,
+                                           edge.endVertexIndex, change.values[0], change.values[1]};
+                if (change.values[0] > edge.weight[0] || change.values[1] > edge.weight[1])
+                    result.costlierEdges.push_back(updated);
+                if (change.values[0] < edge.weight[0] || change.values[1] < edge.weight[1])
+                    result.cheaperEdges.push_back(updated);
+                break;
+            }
+            case GRAPH_CHANGE_ADD_DEPARTURE:
+                AddDeparture(change.edgeName, change.vertexFromName, change.vertexToName,
+                             change.values[0], change.values[1]);
+                break;
+            case GRAPH_CHANGE_ADD_VERTEX:
+                InsertVertex(change.vertexFromName);
+                break;
+            case GRAPH_CHANGE_REMOVE_VERTEX:
+                RemoveVertex(change.vertexFromName, affectedVertexIndices);
+                result.shiftedVertices.insert(result.shiftedVertices.end(),
+                                              affectedVertexIndices.begin(),
+                                              affectedVertexIndices.end());
+                break;
+            default:
+                continue;
+            }
+        }
+        catch (struct VertexNotFoundException)
+        {
+            continue;
+        }
+        catch (struct EdgeNotFoundException)
+        {
+            continue;
+        }
+        catch (struct SameNamedEdgeException)
+        {
+            continue;
+        }
+        catch (struct DuplicateVertexException)
+        {
+            continue;
+        }
+
+        result.isApplied[c] = 1;
+        result.appliedCount++;
+    }
+
+    std::vector<int> &shifted = result.shiftedVertices;
+    std::sort(shifted.begin(), shifted.end());
+    shifted.erase(std::unique(shifted.begin(), shifted.end()), shifted.end());
+
+    // Distances to and from a removed vertex stay lower bounds as well,
+    // the tables of a grown graph are too short
+    if (result.cheaperEdges.empty() && vertexList.size() == vertexCount)
+        landmarkTables = keptLandmarks;
+}
+
+bool multi_graph::MayReach(int index_first, int index_end) const
+{
+    return CanReach(index_first, index_end, SearchFilter());
+}
+
+static bool ConnectionLess(const GraphConnection &left,
+                           const GraphConnection &right)
+{
+    if (left.departureTime != right.departureTime)
+        return left.departureTime < right.departureTime;
+    return left.arrivalTime < right.arrivalTime;
+}
+
+void multi_graph::BuildConnections() const
+{
+    TRACE_SCOPE("BuildConnections");
+    connections.clear();
+    for (size_t i = 0; i < vertexList.size(); i++)
+    {
+        const GraphEdgeList &edges = vertexList[i].edges;
+        for (size_t k = 0; k < edges.size(); k++)
+        {
+            for (size_t d = 0; d < edges[k].departures.size(); d++)
+            {
+                GraphConnection c;
+                c.departureTime = edges[k].departures[d].departureTime;
+                c.arrivalTime = edges[k].departures[d].arrivalTime;
+                c.vertexFromIndex = static_cast<int>(i);
+                c.edgeIndex = static_cast<int>(k);
+                connections.push_back(c);
+            }
+        }
+    }
+
+    std::sort(connections.begin(), connections.end(), ConnectionLess);
+    isConnectionsDirty = false;
+}
+
+bool multi_graph::EarliestArrivalPath(std::vector<int> &orderedVertexEdgeIndexList,
+                                      std::vector<FlightDeparture> &legTimes,
+                                      const std::string &vertexNameFrom,
+                                      const std::string &vertexNameTo,
+                                      float departureTime) const
+{
+    int index_first = FindVertexIndex(vertexNameFrom);
+    int index_end = FindVertexIndex(vertexNameTo);
+    if (index_first == -1 || index_end == -1)
+        return false;
+    if (!CanReach(index_first, index_end, SearchFilter()))
+        return false;
+
+    if (isConnectionsDirty)
+        BuildConnections();
+
+    // Connection scan, a single pass over the connections departing
+    // after the requested time
+    const float INF = std::numeric_limits<float>::infinity();
+    std::vector<float> arrival(vertexList.size(), INF);
+    std::vector<int> inConnection(vertexList.size(), -1);
+    arrival[index_first] = departureTime;
+
+    GraphConnection first;
+    first.departureTime = departureTime;
+    first.arrivalTime = -INF;
+    size_t c = std::lower_bound(connections.begin(), connections.end(),
+                                first, ConnectionLess) -
+               connections.begin();
+
+    for (; c < connections.size(); c++)
+    {
+        const GraphConnection &conn = connections[c];
+
+        // Nothing departing later can arrive earlier
+        if (conn.departureTime >= arrival[index_end])
+            break;
+
+        int from = conn.vertexFromIndex;
+        if (arrival[from] == INF)
+            continue;
+
+        // Layover at the origin does not need a connection window
+        float ready = arrival[from];
+        if (from != index_first)
+            ready += vertexList[from].minConnectionTime;
+        if (ready > conn.departureTime)
+            continue;
+
+        int to = vertexList[from].edges[conn.edgeIndex].endVertexIndex;
+        if (conn.arrivalTime < arrival[to])
+        {
+            arrival[to] = conn.arrivalTime;
+            inConnection[to] = static_cast<int>(c);
+        }
+    }
+
+    if (index_first != index_end && inConnection[index_end] == -1)
+        return false;
+
+    // Walk back the journey, legs are collected in reverse
+    orderedVertexEdgeIndexList.clear();
+    legTimes.clear();
+    int vertex = index_end;
+    for (size_t step = 0; vertex != index_first && step < vertexList.size(); step++)
+    {
+        const GraphConnection &conn = connections[inConnection[vertex]];
+        FlightDeparture leg;
+        leg.departureTime = conn.departureTime;
+        leg.arrivalTime = conn.arrivalTime;
+        legTimes.push_back(leg);
+        orderedVertexEdgeIndexList.push_back(vertex);
+        orderedVertexEdgeIndexList.push_back(conn.edgeIndex);
+        vertex = conn.vertexFromIndex;
+    }
+
+    if (vertex != index_first)
+        return false;
+
+    orderedVertexEdgeIndexList.push_back(index_first);
+    std::reverse(orderedVertexEdgeIndexList.begin(), orderedVertexEdgeIndexList.end());
+    std::reverse(legTimes.begin(), legTimes.end());
+    return true;
+}
+
+bool multi_graph::IsEdgeFiltered(const SearchFilter &filter,
+                                 const GraphEdge &edge,
+                                 int vertexIndex, int edgeIndex)
+{
+    if (filter.bannedVertices && (*filter.bannedVertices)[edge.endVertexIndex])
+        return true;
+
+    if (filter.bannedEdges && vertexIndex == filter.bannedEdgeVertex)
+    {
+        const std::vector<int> &banned = *filter.bannedEdges;
+        for (size_t k = 0; k < banned.size(); k++)
+        {
+            if (banned[k] == edgeIndex)
+                return true;
+        }
+    }
+
+    if (filter.excludedEdgeNameIds)
+    {
+        const std::vector<int> &nameIds = *filter.excludedEdgeNameIds;
+        for (size_t k = 0; k < nameIds.size(); k++)
+        {
+            if (edge.nameId == nameIds[k])
+                return true;
+        }
+    }
+    return false;
+}
+
+void multi_graph::BuildReachability(ReachabilityLabels &labels, int excludedNameId) const
+{
+    TRACE_SCOPE("BuildReachability");
+    int vertexCount = static_cast<int>(vertexList.size());
+    labels.components.assign(vertexCount, -1);
+    labels.lows.clear();
+    labels.excludedNameId = excludedNameId;
+    labels.isExact = true;
+
+    // Iterative Tarjan, the call stack keeps (vertex, next edge)
+    std::vector<int> order(vertexCount, -1);
+    std::vector<int> lowLinks(vertexCount, 0);
+    std::vector<int> stack;
+    std::vector<std::pair<int, size_t>> callStack;
+    int visitCount = 0;
+
+    for (int root = 0; root < vertexCount; root++)
+    {
+        if (order[root] != -1)
+            continue;
+
+        order[root] = lowLinks[root] = visitCount++;
+        stack.push_back(root);
+        callStack.push_back(std::make_pair(root, static_cast<size_t>(0)));
+        while (!callStack.empty())
+        {
+            int index = callStack.back().first;
+            const GraphEdgeList &edges = vertexList[index].edges;
+            bool isDescended = false;
+            while (callStack.back().second < edges.size())
+            {
+                const GraphEdge &edge = edges[callStack.back().second++];
+                if (edge.nameId == excludedNameId)
+                    continue;
+
+                int next = edge.endVertexIndex;
+                if (order[next] == -1)
+                {
+                    order[next] = lowLinks[next] = visitCount++;
+                    stack.push_back(next);
+                    callStack.push_back(std::make_pair(next, static_cast<size_t>(0)));
+                    isDescended = true;
+                    break;
+                }
+                // Still on the stack, part of the open component
+                if (labels.components[next] == -1)
+                    lowLinks[index] = std::min(lowLinks[index], order[next]);
+            }
+            if (isDescended)
+                continue;
+
+            callStack.pop_back();
+            if (!callStack.empty())
+            {
+                int parent = callStack.back().first;
+                lowLinks[parent] = std::min(lowLinks[parent], lowLinks[index]);
+            }
+            if (lowLinks[index] != order[index])
+                continue;
+
+            // The components it reaches are finished, their lows final
+            int component = static_cast<int>(labels.lows.size());
+            size_t first = stack.size();
+            do
+                first--;
+            while (stack[first] != index);
+            for (size_t s = first; s < stack.size(); s++)
+                labels.components[stack[s]] = component;
+
+            int low = component;
+            for (size_t s = first; s < stack.size(); s++)
+            {
+                const GraphEdgeList &componentEdges = vertexList[stack[s]].edges;
+                for (size_t k = 0; k < componentEdges.size(); k++)
+                {
+                    int next = labels.components[componentEdges[k].endVertexIndex];
+                    if (componentEdges[k].nameId != excludedNameId && next != component)
+                        low = std::min(low, labels.lows[next]);
+                }
+            }
+            labels.lows.push_back(low);
+            stack.resize(first);
+        }
+    }
+
+    BuildReachableComponents(labels);
+}
+
+void multi_graph::BuildReachableComponents(ReachabilityLabels &labels) const
+{
+    size_t componentCount = labels.lows.size();
+    labels.wordCount = static_cast<int>((componentCount + 63) / 64);
+    labels.reachable.clear();
+    if (componentCount * labels.wordCount * sizeof(unsigned long long) > REACHABILITY_MAX_BITSET_BYTES)
+    {
+        labels.reachable.shrink_to_fit();
+        return;
+    }
+    labels.reachable.assign(componentCount * labels.wordCount, 0);
+
+    // Vertices grouped by component
+    std::vector<int> offsets(componentCount + 1, 0);
+    for (size_t i = 0; i < labels.components.size(); i++)
+        offsets[labels.components[i] + 1]++;
+    for (size_t c = 0; c < componentCount; c++)
+        offsets[c + 1] += offsets[c];
+    std::vector<int> members(labels.components.size());
+    std::vector<int> cursors(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < labels.components.size(); i++)
+        members[cursors[labels.components[i]]++] = static_cast<int>(i);
+
+    // Successors have lower numbers, their rows are complete
+    for (size_t c = 0; c < componentCount; c++)
+    {
+        unsigned long long *row = &labels.reachable[c * labels.wordCount];
+        row[c / 64] |= 1ULL << (c % 64);
+        for (int m = offsets[c]; m < offsets[c + 1]; m++)
+        {
+            const GraphEdgeList &edges = vertexList[members[m]].edges;
+            for (size_t k = 0; k < edges.size(); k++)
+            {
+                size_t next = static_cast<size_t>(labels.components[edges[k].endVertexIndex]);
+                if (edges[k].nameId == labels.excludedNameId || next == c ||
+                    (row[next / 64] >> (next % 64)) & 1)
+                    continue;
+                const unsigned long long *nextRow = &labels.reachable[next * labels.wordCount];
+                for (size_t w = 0; w <= next / 64; w++)
+                    row[w] |= nextRow[w];
+            }
+        }
+    }
+}
+
+bool multi_graph::IsInRange(const ReachabilityLabels &labels, int index_first, int index_end)
+{
+    int from = labels.components[index_first];
+    int to = labels.components[index_end];
+    if (from == to)
+        return true;
+    if (to > from || labels.lows[from] > labels.lows[to])
+        return false;
+    if (labels.reachable.empty())
+        return true;
+    return (labels.reachable[static_cast<size_t>(from) * labels.wordCount + to / 64] >> (to % 64)) & 1;
+}
+
+ReachabilityLabels &multi_graph::FilteredReachability(int excludedNameId) const
+{
+    size_t k = 0;
+    while (k < reachabilityWithout.size() && reachabilityWithout[k].excludedNameId != excludedNameId)
+        k++;
+    if (k == reachabilityWithout.size())
+    {
+        // The least recently used labels make room
+        if (k == REACHABILITY_FILTERED_LABELS)
+            k--;
+        else
+            reachabilityWithout.push_back(ReachabilityLabels());
+        reachabilityWithout[k].components.clear();
+    }
+    std::rotate(reachabilityWithout.begin(), reachabilityWithout.begin() + k,
+                reachabilityWithout.begin() + k + 1);
+
+    ReachabilityLabels &labels = reachabilityWithout[0];
+    if (labels.components.size() != vertexList.size())
+        BuildReachability(labels, excludedNameId);
+    return labels;
+}
+
+bool multi_graph::CanReach(int index_first, int index_end, const SearchFilter &filter) const
+{
+    if (reachability.components.size() != vertexList.size())
+        BuildReachability(reachability, -1);
+    if (!IsInRange(reachability, index_first, index_end))
+        return false;
+
+    // Every excluded name removes edges, the labels without any one of
+    // them hold for the filtered graph
+    if (filter.excludedEdgeNameIds)
+    {
+        const std::vector<int> &nameIds = *filter.excludedEdgeNameIds;
+        for (size_t k = 0; k < nameIds.size(); k++)
+        {
+            if (!IsInRange(FilteredReachability(nameIds[k]), index_first, index_end))
+                return false;
+        }
+    }
+    return true;
+}
+
+void multi_graph::DropInexactReachability(const SearchFilter &filter) const
+{
+    // Banned vertices and edges are not part of any labels
+    if (filter.bannedVertices || filter.bannedEdges)
+        return;
+
+    ReachabilityLabels *labels = &reachability;
+    if (filter.excludedEdgeNameIds && !filter.excludedEdgeNameIds->empty())
+    {
+        if (filter.excludedEdgeNameIds->size() != 1)
+            return;
+        size_t k = 0;
+        while (k < reachabilityWithout.size() &&
+               reachabilityWithout[k].excludedNameId != (*filter.excludedEdgeNameIds)[0])
+            k++;
+        if (k == reachabilityWithout.size())
+            return;
+        labels = &reachabilityWithout[k];
+    }
+
+    // Rebuilt by the next search
+    if (!labels->isExact)
+        labels->components.clear();
+}
+
+void multi_graph::ClearReachability()
+{
+    reachability.components.clear();
+    reachabilityWithout.clear();
+}
+
+void multi_graph::MarkReachabilityInexact()
+{
+    reachability.isExact = false;
+    for (size_t k = 0; k < reachabilityWithout.size(); k++)
+        reachabilityWithout[k].isExact = false;
+}
+
+void multi_graph::ReachabilityEdgeAdded(int vertexFromIndex, int vertexToIndex, int nameId)
+{
+    // Range containment is transitive, an edge within the range of its
+    // start adds no pair the labels rule out
+    if (reachability.components.size() == vertexList.size() &&
+        !IsInRange(reachability, vertexFromIndex, vertexToIndex))
+        reachability.components.clear();
+
+    for (size_t k = 0; k < reachabilityWithout.size(); k++)
+    {
+        ReachabilityLabels &labels = reachabilityWithout[k];
+        if (labels.excludedNameId != nameId && labels.components.size() == vertexList.size() &&
+            !IsInRange(labels, vertexFromIndex, vertexToIndex))
+            labels.components.clear();
+    }
+}
+
+bool multi_graph::ShortestPathCore(std::vector<int> &orderedVertexEdgeIndexList,
+                                   int index_first, int index_end,
+                                   float heuristicWeight,
+                                   const SearchFilter &filter,
+                                   SearchTree *tree) const
+{
+    // Without checkpoints the first slice is the whole search
+    SearchTask search = ShortestPathSteps(orderedVertexEdgeIndexList, index_first, index_end,
+                                          heuristicWeight, filter, tree, 0);
+    search.Resume();
+    return search.Result();
+}
+
+SearchTask multi_graph::ShortestPathSteps(std::vector<int> &orderedVertexEdgeIndexList,
+                                          int index_first, int index_end,
+                                          float heuristicWeight,
+                                          const SearchFilter &filter,
+                                          SearchTree *tree, int yieldInterval) const
+{
+    if (IS_WEIGHT_SPECIALIZED && heuristicWeight == 0)
+        return ShortestPathKernel(orderedVertexEdgeIndexList, index_first, index_end,
+                                  TimeWeightPolicy(), filter, tree, yieldInterval);
+    if (IS_WEIGHT_SPECIALIZED && heuristicWeight == 1)
+        return ShortestPathKernel(orderedVertexEdgeIndexList, index_first, index_end,
+                                  PriceWeightPolicy(), filter, tree, yieldInterval);
+
+    BlendWeightPolicy weight;
+    weight.alpha = heuristicWeight;
+    return ShortestPathKernel(orderedVertexEdgeIndexList, index_first, index_end,
+                              weight, filter, tree, yieldInterval);
+}
+
+template <class WeightPolicy>
+SearchTask multi_graph::ShortestPathKernel(std::vector<int> &orderedVertexEdgeIndexList,
+                                           int index_first, int index_end,
+                                           WeightPolicy weightOf,
+                                           const SearchFilter &filter,
+                                           SearchTree *tree, int yieldInterval) const
+{
+    const float INF = std::numeric_limits<float>::infinity();
+
+    // Pairs in unconnected components are answered without a search
+    {
+        TRACE_SCOPE("reachability check");
+        if (!CanReach(index_first, index_end, filter))
+            co_return false;
+    }
+
+    TRACE_PHASE(setupScope, "search setup");
+    // A tree of an earlier search from the same source and alpha is
+    // extended
+    if (tree && (tree->sourceIndex != index_first || tree->alpha != weightOf.Alpha() ||
+                 tree->prevVertices.size() != vertexList.size()))
+    {
+        tree->sourceIndex = index_first;
+        tree->alpha = weightOf.Alpha();
+        tree->prevVertices.assign(vertexList.size(), -1);
+        tree->prevEdges.assign(vertexList.size(), -1);
+    }
+
+    // Potentials are either given or computed once per touched vertex
+    // from the landmark tables (NaN marks not yet computed)
+    std::vector<float> landmarkPotentials;
+    const std::vector<float> *potentials = filter.potentials;
+    bool isLandmarkSearch = WeightPolicy::IS_BLEND && !potentials &&
+                            filter.useLandmarks && !landmarkTables->landmarks.empty();
+    bool isFiltered = filter.excludedEdgeNameIds || filter.bannedVertices || filter.bannedEdges;
+    if (isLandmarkSearch)
+    {
+        landmarkPotentials.assign(vertexList.size(), std::numeric_limits<float>::quiet_NaN());
+        potentials = &landmarkPotentials;
+    }
+
+    // Unfiltered blends read the flattened edges, high degree vertices
+    // are relaxed by the vectorized kernel (of one weight for alpha 0
+    // and 1)
+    bool useIndex = WeightPolicy::IS_BLEND && !isFiltered;
+    if (useIndex && isSearchIndexDirty)
+        BuildSearchIndex();
+    // Kept alive while the search is suspended
+    std::shared_ptr<const SearchIndex> sharedIndex = searchIndex;
+    const SearchIndex &flat = *sharedIndex;
+    std::vector<int> improvedEdges(useIndex ? flat.maxOutDegree : 0);
+    std::vector<float> candidates(useIndex ? flat.maxOutDegree : 0);
+    // Compact weights of the current vertex, decoded for the relaxation
+    std::vector<float> decoded0(useIndex && flat.isCompactIndex ? flat.maxOutDegree : 0);
+    std::vector<float> decoded1(useIndex && flat.isCompactIndex && WeightPolicy::SINGLE_WEIGHT == -1 ?
+                                flat.maxOutDegree : 0);
+
+    std::vector<float> counts(vertexList.size(), INF);
+    std::vector<int> prev(vertexList.size(), -1);
+    std::vector<int> Edges(vertexList.size(), -1);
+
+    // Heap key is the tentative distance (plus the potential for A*)
+    MinPairHeap<float, int> pq;
+    Pair<float, int> p;
+
+    counts[index_first] = 0; // assigning A->A to 0
+    if (isLandmarkSearch)
+        landmarkPotentials[index_first] = LandmarkPotential(index_first, index_end, weightOf.Alpha());
+    p.key = potentials ? (*potentials)[index_first] : 0;
+    p.value = index_first;
+    pq.push(p);
+
+    int index = index_first;
+    float count = 0;
+    int settledCount = 0;
+    TRACE_END(setupScope);
+
+    // Relaxes the i-th edge of the current vertex
+    auto relax = [&](int next_index, float candidate, int i)
+    {
+        if (candidate < counts[next_index])
+        {
+            // Vertices that can not reach the target are pruned
+            if (isLandmarkSearch && landmarkPotentials[next_index] != landmarkPotentials[next_index])
+                landmarkPotentials[next_index] = LandmarkPotential(next_index, index_end, weightOf.Alpha());
+            float potential = potentials ? (*potentials)[next_index] : 0;
+            if (potential == INF)
+                return;
+
+            counts[next_index] = candidate;
+            prev[next_index] = index;
+            Edges[next_index] = i;
+
+            p.key = candidate + potential;
+            p.value = next_index;
+            pq.push(p);
+        }
+    };
+
+    // Sliced searches include their suspensions
+    TRACE_PHASE(heapScope, "heap search");
+    while (!pq.empty())
+    {
+        Pair<float, int> a = pq.top();
+        pq.pop();
+
+        index = a.value;
+        count = counts[index];
+
+        // Stale heap entry, a shorter one is already settled
+        if (a.key > count + (potentials ? (*potentials)[index] : 0))
+            continue;
+
+        // Settled distances are final, so is their predecessor
+        if (tree && index != index_first && tree->prevEdges[index] == -1)
+        {
+            tree->prevVertices[index] = prev[index];
+            tree->prevEdges[index] = Edges[index];
+        }
+
+        if (index == index_end)
+            break;
+
+        // Checkpoint of a sliced search
+        if (yieldInterval > 0 && ++settledCount % yieldInterval == 0)
+            co_yield 0;
+
+        if constexpr (WeightPolicy::SINGLE_WEIGHT != -1)
+        {
+            if (useIndex && IsIndexed(index))
+            {
+                int begin = flat.edgeOffsets[index];
+                int degree = flat.edgeOffsets[index + 1] - begin;
+                const float *weight = decoded0.data();
+                if (flat.isCompactIndex)
+                {
+                    const std::vector<unsigned short> &compactWeight =
+                        (WeightPolicy::SINGLE_WEIGHT == 0) ? flat.compactWeight0 : flat.compactWeight1;
+                    for (int i = 0; i < degree; i++)
+                        decoded0[i] = compactWeight[begin + i] * compactStep;
+                }
+                else
+                {
+                    weight = ((WeightPolicy::SINGLE_WEIGHT == 0) ? flat.edgeWeight0 : flat.edgeWeight1).data() + begin;
+                }
+
+                if (degree >= SIMD_RELAX_MIN_DEGREE)
+                {
+                    int improvedCount = RelaxEdgeWeights(weight, flat.edgeTargets.data() + begin, degree,
+                                                         count, counts.data(),
+                                                         improvedEdges.data(), candidates.data());
+                    for (int k = 0; k < improvedCount; k++)
+                        relax(flat.edgeTargets[begin + improvedEdges[k]], candidates[k], improvedEdges[k]);
+                }
+                else
+                {
+                    for (int i = 0; i < degree; i++)
+                        relax(flat.edgeTargets[begin + i], count + weight[i], i);
+                }
+                continue;
+            }
+        }
+        else if constexpr (WeightPolicy::IS_BLEND)
+        {
+            if (useIndex && IsIndexed(index))
+            {
+                int begin = flat.edgeOffsets[index];
+                int degree = flat.edgeOffsets[index + 1] - begin;
+                const float *weight0 = decoded0.data();
+                const float *weight1 = decoded1.data();
+                if (flat.isCompactIndex)
+                {
+                    for (int i = 0; i < degree; i++)
+                    {
+                        decoded0[i] = flat.compactWeight0[begin + i] * compactStep;
+                        decoded1[i] = flat.compactWeight1[begin + i] * compactStep;
+                    }
+                }
+                else
+                {
+                    weight0 = flat.edgeWeight0.data() + begin;
+                    weight1 = flat.edgeWeight1.data() + begin;
+                }
+
+                if (degree >= SIMD_RELAX_MIN_DEGREE)
+                {
+                    int improvedCount = RelaxEdges(weight0, weight1,
+                                                   flat.edgeTargets.data() + begin, degree,
+                                                   weightOf.Alpha(), count, counts.data(),
+                                                   improvedEdges.data(), candidates.data());
+                    for (int k = 0; k < improvedCount; k++)
+                        relax(flat.edgeTargets[begin + improvedEdges[k]], candidates[k], improvedEdges[k]);
+                }
+                else
+                {
+                    for (int i = 0; i < degree; i++)
+                        relax(flat.edgeTargets[begin + i],
+                              count + weightOf(weight0[i], weight1[i]), i);
+                }
+                continue;
+            }
+        }
+
+        const GraphEdgeList &edges = vertexList[index].edges;
+        for (size_t i = 0; i < edges.size(); i++)
+        {
+            const GraphEdge &edge = edges[i];
+            if (isFiltered && IsEdgeFiltered(filter, edge, index, static_cast<int>(i)))
+                continue;
+
+            relax(edge.endVertexIndex, count + weightOf(edge), static_cast<int>(i));
+        }
+    }
+
+    TRACE_END(heapScope);
+
+    if (counts[index_end] == INF)
+    {
+        DropInexactReachability(filter);
+        co_return false;
+    }
+
+    // Walk back from the end, then reverse
+    TRACE_SCOPE("path reconstruction");
+    orderedVertexEdgeIndexList.clear();
+    for (index = index_end; index != index_first; index = prev[index])
+    {
+        orderedVertexEdgeIndexList.push_back(index);
+        orderedVertexEdgeIndexList.push_back(Edges[index]);
+    }
+    orderedVertexEdgeIndexList.push_back(index_first);
+    std::reverse(orderedVertexEdgeIndexList.begin(), orderedVertexEdgeIndexList.end());
+
+    co_return true;
+}
+
+void multi_graph::ReverseShortestPathTree(std::vector<float> &distances,
+                                          std::vector<int> &nextEdges,
+                                          int index_end, float heuristicWeight) const
+{
+    if (IS_WEIGHT_SPECIALIZED && heuristicWeight == 0)
+        return ReverseShortestPathTreeKernel(distances, nextEdges, index_end,
+                                             TimeWeightPolicy());
+    if (IS_WEIGHT_SPECIALIZED && heuristicWeight == 1)
+        return ReverseShortestPathTreeKernel(distances, nextEdges, index_end,
+                                             PriceWeightPolicy());
+
+    BlendWeightPolicy weight;
+    weight.alpha = heuristicWeight;
+    ReverseShortestPathTreeKernel(distances, nextEdges, index_end, weight);
+}
+
+template <class WeightPolicy>
+void multi_graph::ReverseShortestPathTreeKernel(std::vector<float> &distances,
+                                                std::vector<int> &nextEdges,
+                                                int index_end,
+                                                const WeightPolicy &weightOf) const
+{
+    const float INF = std::numeric_limits<float>::infinity();
+
+    distances.assign(vertexList.size(), INF);
+    nextEdges.assign(vertexList.size(), -1);
+    // Last vertex the incoming edges were scanned for, skips duplicates
+    std::vector<int> scannedFor(vertexList.size(), -1);
+
+    MinPairHeap<float, int> pq;
+    Pair<float, int> p;
+
+    distances[index_end] = 0;
+    p.key = 0;
+    p.value = index_end;
+    pq.push(p);
+
+    while (!pq.empty())
+    {
+        Pair<float, int> a = pq.top();
+        pq.pop();
+
+        int index = a.value;
+        if (a.key > distances[index])
+            continue;
+
+        const GraphIndexList &inVertices = vertexList[index].inVertices;
+        for (size_t i = 0; i < inVertices.size(); i++)
+        {
+            int from = inVertices[i];
+            if (scannedFor[from] == index)
+                continue;
+            scannedFor[from] = index;
+
+            const GraphEdgeList &edges = vertexList[from].edges;
+            for (size_t k = 0; k < edges.size(); k++)
+            {
+                if (edges[k].endVertexIndex != index)
+                    continue;
+
+                float weight = weightOf(edges[k]);
+                if (distances[index] + weight < distances[from])
+                {
+                    distances[from] = distances[index] + weight;
+                    nextEdges[from] = static_cast<int>(k);
+
+                    p.key = distances[from];
+                    p.value = from;
+                    pq.push(p);
+                }
+            }
+        }
+    }
+}
+
+void multi_graph::ShortestPathTree(std::vector<float> &distances,
+                                   std::vector<int> &prevVertices,
+                                   std::vector<int> &prevEdges,
+                                   int index_first, float heuristicWeight) const
+{
+    if (IS_WEIGHT_SPECIALIZED && heuristicWeight == 0)
+        return ShortestPathTreeKernel(distances, prevVertices, prevEdges, index_first,
+                                      TimeWeightPolicy());
+    if (IS_WEIGHT_SPECIALIZED && heuristicWeight == 1)
+        return ShortestPathTreeKernel(distances, prevVertices, prevEdges, index_first,
+                                      PriceWeightPolicy());
+
+    BlendWeightPolicy weight;
+    weight.alpha = heuristicWeight;
+    ShortestPathTreeKernel(distances, prevVertices, prevEdges, index_first, weight);
+}
+
+template <class WeightPolicy>
+void multi_graph::ShortestPathTreeKernel(std::vector<float> &distances,
+                                         std::vector<int> &prevVertices,
+                                         std::vector<int> &prevEdges,
+                                         int index_first,
+                                         const WeightPolicy &weightOf) const
+{
+    const float INF = std::numeric_limits<float>::infinity();
+
+    distances.assign(vertexList.size(), INF);
+    prevVertices.assign(vertexList.size(), -1);
+    prevEdges.assign(vertexList.size(), -1);
+
+    MinPairHeap<float, int> pq;
+    Pair<float, int> p;
+
+    distances[index_first] = 0;
+    p.key = 0;
+    p.value = index_first;
+    pq.push(p);
+
+    if (WeightPolicy::IS_BLEND && isSearchIndexDirty)
+        BuildSearchIndex();
+    // Trees keep the exact weights, hot tree repairs rely on them
+    const SearchIndex &flat = *searchIndex;
+    bool useIndex = WeightPolicy::IS_BLEND && !flat.isCompactIndex;
+
+    while (!pq.empty())
+    {
+        Pair<float, int> a = pq.top();
+        pq.pop();
+
+        int index = a.value;
+        if (a.key > distances[index])
+            continue;
+
+        if constexpr (WeightPolicy::IS_BLEND)
+        {
+            if (useIndex && IsIndexed(index))
+            {
+                int begin = flat.edgeOffsets[index];
+                int end = flat.edgeOffsets[index + 1];
+                for (int i = begin; i < end; i++)
+                {
+                    float weight = weightOf(flat.edgeWeight0[i], flat.edgeWeight1[i]);
+                    int next_index = flat.edgeTargets[i];
+
+                    if (distances[index] + weight < distances[next_index])
+                    {
+                        distances[next_index] = distances[index] + weight;
+                        prevVertices[next_index] = index;
+                        prevEdges[next_index] = i - begin;
+
+                        p.key = distances[next_index];
+                        p.value = next_index;
+                        pq.push(p);
+                    }
+                }
+                continue;
+            }
+        }
+
+        const GraphEdgeList &edges = vertexList[index].edges;
+        for (size_t i = 0; i < edges.size(); i++)
+        {
+            float weight = weightOf(edges[i]);
+            int next_index = edges[i].endVertexIndex;
+
+            if (distances[index] + weight < distances[next_index])
+            {
+                distances[next_index] = distances[index] + weight;
+                prevVertices[next_index] = index;
+                prevEdges[next_index] = static_cast<int>(i);
+
+                p.key = distances[next_index];
+                p.value = next_index;
+                pq.push(p);
+            }
+        }
+    }
+}
+
+bool multi_graph::TreePath(std::vector<int> &orderedVertexEdgeIndexList,
+                           const std::vector<int> &nextEdges,
+                           int index_first, int index_end,
+                           const SearchFilter &filter) const
+{
+    orderedVertexEdgeIndexList.clear();
+
+    int index = index_first;
+    while (index != index_end)
+    {
+        int edgeIndex = nextEdges[index];
+        if (edgeIndex == -1)
+            return false;
+
+        const GraphEdge &edge = vertexList[index].edges[edgeIndex];
+        if (IsEdgeFiltered(filter, edge, index, edgeIndex))
+            return false;
+
+        orderedVertexEdgeIndexList.push_back(index);
+        orderedVertexEdgeIndexList.push_back(edgeIndex);
+        index = edge.endVertexIndex;
+    }
+    orderedVertexEdgeIndexList.push_back(index_end);
+
+    return true;
+}
+
+float multi_graph::PathCost(const std::vector<int> &orderedVertexEdgeIndexList,
+                            float heuristicWeight) const
+{
+    const std::vector<int> &ove = orderedVertexEdgeIndexList;
+
+    float cost = 0;
+    for (size_t i = 1; i < ove.size(); i += 2)
+    {
+        const GraphEdge &edge = vertexList[ove[i - 1]].edges[ove[i]];
+        cost += Lerp(edge.weight[0], edge.weight[1], heuristicWeight);
+    }
+    return cost;
+}
+
+void multi_graph::PathWeights(const std::vector<int> &orderedVertexEdgeIndexList,
+                              float &weight0, float &weight1) const
+{
+    const std::vector<int> &ove = orderedVertexEdgeIndexList;
+
+    weight0 = 0;
+    weight1 = 0;
+    for (size_t i = 1; i < ove.size(); i += 2)
+    {
+        const GraphEdge &edge = vertexList[ove[i - 1]].edges[ove[i]];
+        weight0 += edge.weight[0];
+        weight1 += edge.weight[1];
+    }
+}
+
+void multi_graph::TopologyChanged()
+{
+    // Landmark bounds are only valid for the graph they are built on
+    ClearLandmarks();
+    isHotTreesDirty = true;
+    version++;
+}
+
+void multi_graph::SearchIndexChanged(int index)
+{
+    if (isSearchIndexDirty)
+        return;
+
+    // A shared index stays as it is until too many vertices changed
+    if (searchIndex.use_count() == 1)
+        isSearchIndexDirty = true;
+    else
+    {
+        staleIndexVertices.insert(index);
+        if (staleIndexVertices.size() * STALE_INDEX_RATIO > vertexList.size())
+            isSearchIndexDirty = true;
+    }
+}
+
+bool multi_graph::IsIndexed(int index) const
+{
+    return staleIndexVertices.empty() || staleIndexVertices.count(index) == 0;
+}
+
+void multi_graph::BuildSearchIndex() const
+{
+    TRACE_SCOPE("BuildSearchIndex");
+    // Snapshots keep the index they share
+    if (searchIndex.use_count() != 1)
+        searchIndex = std::make_shared<SearchIndex>();
+    staleIndexVertices.clear();
+
+    SearchIndex &flat = *searchIndex;
+    flat.edgeOffsets.assign(1, 0);
+    flat.edgeWeight0.clear();
+    flat.edgeWeight1.clear();
+    flat.edgeTargets.clear();
+    flat.compactWeight0.clear();
+    flat.compactWeight1.clear();
+    flat.maxOutDegree = 0;
+
+    for (size_t i = 0; i < vertexList.size(); i++)
+    {
+        const GraphEdgeList &edges = vertexList[i].edges;
+        for (size_t k = 0; k < edges.size(); k++)
+        {
+            flat.edgeWeight0.push_back(edges[k].weight[0]);
+            flat.edgeWeight1.push_back(edges[k].weight[1]);
+            flat.edgeTargets.push_back(edges[k].endVertexIndex);
+        }
+        flat.edgeOffsets.push_back(static_cast<int>(flat.edgeTargets.size()));
+        flat.maxOutDegree = std::max(flat.maxOutDegree, static_cast<int>(edges.size()));
+    }
+
+    // Compact weights replace the float ones when every weight fits,
+    // otherwise the index stays exact
+    flat.isCompactIndex = false;
+    if (compactStep > 0)
+    {
+        size_t edgeCount = flat.edgeTargets.size();
+        flat.compactWeight0.resize(edgeCount);
+        flat.compactWeight1.resize(edgeCount);
+
+        bool isEncoded = true;
+        for (size_t i = 0; i < edgeCount && isEncoded; i++)
+        {
+            isEncoded = EncodeWeight(flat.compactWeight0[i], flat.edgeWeight0[i]) &&
+                        EncodeWeight(flat.compactWeight1[i], flat.edgeWeight1[i]);
+        }
+
+        if (isEncoded)
+        {
+            std::vector<float>().swap(flat.edgeWeight0);
+            std::vector<float>().swap(flat.edgeWeight1);
+            flat.isCompactIndex = true;
+        }
+        else
+        {
+            std::vector<unsigned short>().swap(flat.compactWeight0);
+            std::vector<unsigned short>().swap(flat.compactWeight1);
+        }
+    }
+
+    isSearchIndexDirty = false;
+}
+
+bool multi_graph::EncodeWeight(unsigned short &code, float weight) const
+{
+    // Negated test so NaN fails too
+    float steps = weight / compactStep;
+    if (!(steps >= 0 && steps <= COMPACT_WEIGHT_MAX))
+        return false;
+
+    code = static_cast<unsigned short>(std::lround(steps));
+    return true;
+}
+
+void multi_graph::SetCompactWeights(float maxError)
+{
+    // Rounding to the nearest multiple of the step errs by half a step
+    float step = (maxError > 0) ? 2 * maxError : 0;
+    if (step == compactStep)
+        return;
+
+    compactStep = step;
+    isSearchIndexDirty = true;
+    version++;
+}
+
+bool multi_graph::IsCompactIndex() const
+{
+    if (isSearchIndexDirty)
+        BuildSearchIndex();
+    return searchIndex->isCompactIndex;
+}
+
+// Heap bytes of a string, none while it is stored inline
+static size_t StringBytes(const std::string &text)
+{
+    const char *begin = reinterpret_cast<const char *>(&text);
+    if (text.data() >= begin && text.data() < begin + sizeof(text))
+        return 0;
+    return text.capacity() + 1;
+}
+
+template <class T, class Allocator>
+static size_t VectorBytes(const std::vector<T, Allocator> &values)
+{
+    return values.capacity() * sizeof(T);
+}
+
+// Pooled arrays occupy whole blocks
+template <class T>
+static size_t VectorBytes(const std::vector<T, PoolAllocator<T>> &values)
+{
+#ifdef NO_BLOCK_POOL
+    return values.capacity() * sizeof(T);
+#else
+    return values.capacity() ? BlockPool::BlockBytes(values.capacity() * sizeof(T)) : 0;
+#endif
+}
+
+// Buckets plus one node (link, cached hash, value) per element
+static size_t NameMapBytes(const std::unordered_map<std::string, int> &names)
+{
+    size_t bytes = names.bucket_count() * sizeof(void *) +
+                   names.size() * (sizeof(std::pair<const std::string, int>) + 2 * sizeof(void *));
+    for (std::unordered_map<std::string, int>::const_iterator it = names.begin(); it != names.end(); ++it)
+        bytes += StringBytes(it->first);
+    return bytes;
+}
+
+void multi_graph::MemoryUsage(GraphMemoryUsage &usage) const
+{
+    usage = GraphMemoryUsage();
+
+    usage.vertexBytes = vertexList.Bytes() + NameMapBytes(*vertexIndices);
+    for (size_t i = 0; i < vertexList.size(); i++)
+    {
+        const GraphVertex &vertex = vertexList[i];
+        usage.vertexBytes += StringBytes(vertex.name);
+        usage.edgeBytes += VectorBytes(vertex.edges) + VectorBytes(vertex.inVertices) +
+                           VectorBytes(vertex.inEdges);
+        for (size_t k = 0; k < vertex.edges.size(); k++)
+            usage.edgeBytes += VectorBytes(vertex.edges[k].departures);
+    }
+
+    usage.edgeNameBytes = VectorBytes(edgeNames) + NameMapBytes(edgeNameIds);
+    for (size_t i = 0; i < edgeNames.size(); i++)
+        usage.edgeNameBytes += StringBytes(edgeNames[i]);
+
+    const SearchIndex &flat = *searchIndex;
+    usage.searchIndexBytes = VectorBytes(flat.edgeOffsets) + VectorBytes(flat.edgeWeight0) +
+                             VectorBytes(flat.edgeWeight1) + VectorBytes(flat.edgeTargets) +
+                             VectorBytes(flat.compactWeight0) + VectorBytes(flat.compactWeight1);
+    const LandmarkTables &tables = *landmarkTables;
+    usage.landmarkBytes = VectorBytes(tables.landmarks);
+    for (int d = 0; d < 2; d++)
+        usage.landmarkBytes += VectorBytes(tables.landmarkFrom[d]) + VectorBytes(tables.landmarkTo[d]);
+    usage.connectionBytes = VectorBytes(connections);
+
+    usage.hotTreeBytes = VectorBytes(hotTrees);
+    for (size_t t = 0; t < hotTrees.size(); t++)
+    {
+        usage.hotTreeBytes += StringBytes(hotTrees[t].sourceName) + VectorBytes(hotTrees[t].distances) +
+                              VectorBytes(hotTrees[t].prevVertices) + VectorBytes(hotTrees[t].prevEdges);
+    }
+
+    usage.reachabilityBytes = VectorBytes(reachability.components) + VectorBytes(reachability.lows) +
+                              VectorBytes(reachability.reachable) + VectorBytes(reachabilityWithout);
+    for (size_t k = 0; k < reachabilityWithout.size(); k++)
+    {
+        usage.reachabilityBytes += VectorBytes(reachabilityWithout[k].components) +
+                                   VectorBytes(reachabilityWithout[k].lows) +
+                                   VectorBytes(reachabilityWithout[k].reachable);
+    }
+
+    usage.regionBytes = VectorBytes(regionNames) + NameMapBytes(regionIds) + VectorBytes(regions) +
+                        VectorBytes(regionSlots) + VectorBytes(entrySlots) + VectorBytes(exitSlots) +
+                        VectorBytes(overlayVertices) + VectorBytes(overlays);
+    for (size_t i = 0; i < regionNames.size(); i++)
+        usage.regionBytes += StringBytes(regionNames[i]);
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        const GraphRegion &region = regions[r];
+        usage.regionBytes += VectorBytes(region.vertices) + VectorBytes(region.entryVertices) +
+                             VectorBytes(region.exitVertices) + VectorBytes(region.edgeOffsets) +
+                             VectorBytes(region.edgeTargets) + VectorBytes(region.edgeIndices) +
+                             VectorBytes(region.edgeWeight0) + VectorBytes(region.edgeWeight1) +
+                             VectorBytes(region.inOffsets) + VectorBytes(region.inSources) +
+                             VectorBytes(region.inEdgeIndices) + VectorBytes(region.inWeight0) +
+                             VectorBytes(region.inWeight1);
+    }
+    for (size_t i = 0; i < overlays.size(); i++)
+    {
+        usage.regionBytes += VectorBytes(overlays[i].distances);
+        for (size_t r = 0; r < overlays[i].distances.size(); r++)
+            usage.regionBytes += VectorBytes(overlays[i].distances[r]);
+    }
+
+    usage.totalBytes = usage.vertexBytes + usage.edgeBytes + usage.edgeNameBytes +
+                       usage.searchIndexBytes + usage.landmarkBytes + usage.connectionBytes +
+                       usage.hotTreeBytes + usage.reachabilityBytes + usage.regionBytes;
+}
+
+void multi_graph::LayoutLocality(GraphLayoutLocality &locality) const
+{
+    locality = GraphLayoutLocality();
+
+    long long edgeCount = 0;
+    long long sameLineCount = 0;
+    long long samePageCount = 0;
+    double gapSum = 0;
+    for (size_t i = 0; i < vertexList.size(); i++)
+    {
+        if (vertexList[i].isRemoved)
+            continue;
+        const GraphEdgeList &edges = vertexList[i].edges;
+        long long from = static_cast<long long>(i);
+        for (size_t k = 0; k < edges.size(); k++)
+        {
+            long long to = edges[k].endVertexIndex;
+            gapSum += (from > to) ? from - to : to - from;
+            sameLineCount += (from * sizeof(float) / 64 == to * sizeof(float) / 64);
+            samePageCount += (from * sizeof(float) / 4096 == to * sizeof(float) / 4096);
+            edgeCount++;
+        }
+    }
+
+    if (edgeCount == 0)
+        return;
+    locality.meanIndexGap = gapSum / edgeCount;
+    locality.sameLinePercent = 100.0 * sameLineCount / edgeCount;
+    locality.samePagePercent = 100.0 * samePageCount / edgeCount;
+}
+
+void multi_graph::BuildHotTree(DynamicTree &tree) const
+{
+    ShortestPathTree(tree.distances, tree.prevVertices, tree.prevEdges,
+                     tree.sourceIndex, tree.alpha);
+}
+
+void multi_graph::RebuildHotTrees() const
+{
+    // Indices may have moved, trees of removed origins are dropped
+    size_t k = 0;
+    for (size_t t = 0; t < hotTrees.size(); t++)
+    {
+        int index = FindVertexIndex(hotTrees[t].sourceName);
+        if (index == -1)
+            continue;
+
+        if (k != t)
+            hotTrees[k] = hotTrees[t];
+        hotTrees[k].sourceIndex = index;
+        BuildHotTree(hotTrees[k]);
+        k++;
+    }
+    hotTrees.resize(k);
+    isHotTreesDirty = false;
+}
+
+void multi_graph::RepairHotTree(DynamicTree &tree, int vertexFromIndex, int edgeIndex,
+                                float oldWeight, float newWeight) const
+{
+    const float INF = std::numeric_limits<float>::infinity();
+
+    std::vector<float> &distances = tree.distances;
+    std::vector<int> &prevVertices = tree.prevVertices;
+    std::vector<int> &prevEdges = tree.prevEdges;
+    int next_index = vertexList[vertexFromIndex].edges[edgeIndex].endVertexIndex;
+
+    MinPairHeap<float, int> pq;
+    Pair<float, int> p;
+
+    if (newWeight < oldWeight)
+    {
+        // Only the vertices the cheaper edge improves change, they are
+        // found by a search seeded at the edge's target
+        float candidate = distances[vertexFromIndex] + newWeight;
+        if (!(candidate < distances[next_index]))
+            return;
+
+        distances[next_index] = candidate;
+        prevVertices[next_index] = vertexFromIndex;
+        prevEdges[next_index] = edgeIndex;
+        p.key = candidate;
+        p.value = next_index;
+        pq.push(p);
+    }
+    else if (newWeight > oldWeight)
+    {
+        // Only the subtree below a tree edge can get longer
+        if (prevVertices[next_index] != vertexFromIndex || prevEdges[next_index] != edgeIndex)
+            return;
+
+        std::vector<char> isAffected(vertexList.size(), 0);
+        std::vector<int> affected(1, next_index);
+        isAffected[next_index] = 1;
+        for (size_t a = 0; a < affected.size(); a++)
+        {
+            int index = affected[a];
+            const GraphEdgeList &edges = vertexList[index].edges;
+            for (size_t i = 0; i < edges.size(); i++)
+            {
+                int child = edges[i].endVertexIndex;
+                if (!isAffected[child] && prevVertices[child] == index &&
+                    prevEdges[child] == static_cast<int>(i))
+                {
+                    isAffected[child] = 1;
+                    affected.push_back(child);
+                }
+            }
+        }
+
+        for (size_t a = 0; a < affected.size(); a++)
+        {
+            distances[affected[a]] = INF;
+            prevVertices[affected[a]] = -1;
+            prevEdges[affected[a]] = -1;
+        }
+
+        // Best entry of every affected vertex from the unaffected part
+        std::vector<int> scannedFor(vertexList.size(), -1);
+        for (size_t a = 0; a < affected.size(); a++)
+        {
+            int index = affected[a];
+            const GraphIndexList &inVertices = vertexList[index].inVertices;
+            for (size_t i = 0; i < inVertices.size(); i++)
+            {
+                int from = inVertices[i];
+                if (isAffected[from] || scannedFor[from] == index || distances[from] == INF)
+                    continue;
+                scannedFor[from] = index;
+
+                const GraphEdgeList &edges = vertexList[from].edges;
+                for (size_t k = 0; k < edges.size(); k++)
+                {
+                    if (edges[k].endVertexIndex != index)
+                        continue;
+
+                    float candidate = distances[from] + Lerp(edges[k].weight[0], edges[k].weight[1], tree.alpha);
+                    if (candidate < distances[index])
+                    {
+                        distances[index] = candidate;
+                        prevVertices[index] = from;
+                        prevEdges[index] = static_cast<int>(k);
+                    }
+                }
+            }
+
+            if (distances[index] != INF)
+            {
+                p.key = distances[index];
+                p.value = index;
+                pq.push(p);
+            }
+        }
+    }
+
+    // Dijkstra over the changed part only
+    while (!pq.empty())
+    {
+        Pair<float, int> a = pq.top();
+        pq.pop();
+
+        int index = a.value;
+        if (a.key > distances[index])
+            continue;
+
+        const GraphEdgeList &edges = vertexList[index].edges;
+        for (size_t i = 0; i < edges.size(); i++)
+        {
+            float candidate = distances[index] + Lerp(edges[i].weight[0], edges[i].weight[1], tree.alpha);
+            int to = edges[i].endVertexIndex;
+            if (candidate < distances[to])
+            {
+                distances[to] = candidate;
+                prevVertices[to] = index;
+                prevEdges[to] = static_cast<int>(i);
+
+                p.key = candidate;
+                p.value = to;
+                pq.push(p);
+            }
+        }
+    }
+}
+
+void multi_graph::RegisterHotOrigin(const std::string &vertexName, float heuristicWeight)
+{
+    int index = FindVertexIndex(vertexName);
+    if (index == -1)
+        throw VertexNotFoundException(vertexName);
+
+    for (size_t t = 0; t < hotTrees.size(); t++)
+    {
+        if (hotTrees[t].sourceName == vertexName && hotTrees[t].alpha == heuristicWeight)
+            return;
+    }
+
+    DynamicTree tree;
+    tree.sourceName = vertexName;
+    tree.sourceIndex = index;
+    tree.alpha = heuristicWeight;
+    if (!isHotTreesDirty)
+        BuildHotTree(tree);
+    hotTrees.push_back(tree);
+}
+
+void multi_graph::UnregisterHotOrigin(const std::string &vertexName, float heuristicWeight)
+{
+    for (size_t t = 0; t < hotTrees.size(); t++)
+    {
+        if (hotTrees[t].sourceName == vertexName && hotTrees[t].alpha == heuristicWeight)
+        {
+            hotTrees.erase(hotTrees.begin() + t);
+            return;
+        }
+    }
+}
+
+bool multi_graph::HotOriginPath(std::vector<int> &orderedVertexEdgeIndexList,
+                                const std::string &vertexNameFrom,
+                                const std::string &vertexNameTo,
+                                float heuristicWeight) const
+{
+    if (hotTrees.empty())
+        return false;
+    if (isHotTreesDirty)
+        RebuildHotTrees();
+
+    int index_end = FindVertexIndex(vertexNameTo);
+    if (index_end == -1)
+        return false;
+
+    for (size_t t = 0; t < hotTrees.size(); t++)
+    {
+        const DynamicTree &tree = hotTrees[t];
+        if (tree.sourceName != vertexNameFrom || tree.alpha != heuristicWeight)
+            continue;
+        if (tree.distances[index_end] == std::numeric_limits<float>::infinity())
+            return false;
+
+        // Walk back from the end, then reverse
+        std::vector<int> &ove = orderedVertexEdgeIndexList;
+        ove.clear();
+        for (int index = index_end; index != tree.sourceIndex; index = tree.prevVertices[index])
+        {
+            ove.push_back(index);
+            ove.push_back(tree.prevEdges[index]);
+        }
+        ove.push_back(tree.sourceIndex);
+        std::reverse(ove.begin(), ove.end());
+        return true;
+    }
+
+    return false;
+}
+
+void multi_graph::ClearLandmarks()
+{
+    // Tables shared with a snapshot are left to it
+    if (landmarkTables.use_count() != 1)
+    {
+        landmarkTables = std::make_shared<LandmarkTables>();
+        return;
+    }
+
+    landmarkTables->landmarks.clear();
+    for (int d = 0; d < 2; d++)
+    {
+        landmarkTables->landmarkFrom[d].clear();
+        landmarkTables->landmarkTo[d].clear();
+    }
+}
+
+void multi_graph::BuildLandmarks(int landmarkCount)
+{
+    TRACE_SCOPE("BuildLandmarks");
+    ClearLandmarks();
+    version++;
+    LandmarkTables &tables = *landmarkTables;
+
+    const float INF = std::numeric_limits<float>::infinity();
+    size_t vertexCount = vertexList.size();
+    if (landmarkCount > VertexCount())
+        landmarkCount = VertexCount();
+
+    // First landmark is the busiest hub, the rest are picked greedily as
+    // the vertex furthest (in weight 0, both directions) from the chosen
+    // ones, which spreads them to the edges of the network
+    int landmark = -1;
+    size_t maxDegree = 0;
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const GraphVertex &v = vertexList[i];
+        if (!v.isRemoved && (landmark == -1 || v.edges.size() + v.inVertices.size() > maxDegree))
+        {
+            landmark = static_cast<int>(i);
+            maxDegree = v.edges.size() + v.inVertices.size();
+        }
+    }
+
+    std::vector<float> closeness(vertexCount, INF);
+    std::vector<float> distances;
+    std::vector<int> prevVertices, prevEdges;
+    for (int l = 0; l < landmarkCount && landmark != -1; l++)
+    {
+        tables.landmarks.push_back(landmark);
+        for (int d = 0; d < 2; d++)
+        {
+            ShortestPathTree(distances, prevVertices, prevEdges, landmark, static_cast<float>(d));
+            tables.landmarkFrom[d].insert(tables.landmarkFrom[d].end(), distances.begin(), distances.end());
+            ReverseShortestPathTree(distances, prevEdges, landmark, static_cast<float>(d));
+            tables.landmarkTo[d].insert(tables.landmarkTo[d].end(), distances.begin(), distances.end());
+        }
+
+        // Vertices unrelated to the landmark in both directions are not
+        // candidates, they are usually isolated and give no bounds
+        landmark = -1;
+        float furthest = -1;
+        const float *from = &tables.landmarkFrom[0][l * vertexCount];
+        const float *to = &tables.landmarkTo[0][l * vertexCount];
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            if (from[i] == INF && to[i] == INF)
+                continue;
+            float distance = (from[i] != INF ? from[i] : 0) + (to[i] != INF ? to[i] : 0);
+            closeness[i] = std::min(closeness[i], distance);
+            if (closeness[i] > furthest)
+            {
+                furthest = closeness[i];
+                landmark = static_cast<int>(i);
+            }
+        }
+        if (furthest <= 0)
+            break;
+    }
+}
+
+float multi_graph::LandmarkBound(int dimension, int index, int index_end) const
+{
+    const float INF = std::numeric_limits<float>::infinity();
+    size_t vertexCount = vertexList.size();
+    const LandmarkTables &tables = *landmarkTables;
+
+    // Triangle inequality on every landmark L, in both directions
+    //   d(u,t) >= d(L,t) - d(L,u)  and  d(u,t) >= d(u,L) - d(t,L)
+    float bound = 0;
+    for (size_t l = 0; l < tables.landmarks.size(); l++)
+    {
+        const float *from = &tables.landmarkFrom[dimension][l * vertexCount];
+        const float *to = &tables.landmarkTo[dimension][l * vertexCount];
+
+        // L reaches u but not t, or t reaches L but u does not
+        if ((from[index] != INF && from[index_end] == INF) ||
+            (to[index_end] != INF && to[index] == INF))
+            return INF;
+
+        if (from[index] != INF)
+            bound = std::max(bound, from[index_end] - from[index]);
+        if (to[index_end] != INF)
+            bound = std::max(bound, to[index] - to[index_end]);
+    }
+    return bound;
+}
+
+float multi_graph::LandmarkPotential(int index, int index_end, float heuristicWeight) const
+{
+    // Blended distance is at least the blend of the per weight distances
+    float potential = 0;
+    if (heuristicWeight != 1)
+        potential += (1 - heuristicWeight) * LandmarkBound(0, index, index_end);
+    if (heuristicWeight != 0)
+        potential += heuristicWeight * LandmarkBound(1, index, index_end);
+    return potential;
+}
+
+bool multi_graph::SaveLandmarks(const std::string &filePath) const
+{
+    std::ofstream file(filePath.c_str(), std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    const LandmarkTables &tables = *landmarkTables;
+
+    // Header: vertex count, landmark count then the landmark names
+    int vertexCount = static_cast<int>(vertexList.size());
+    int landmarkCount = static_cast<int>(tables.landmarks.size());
+    file.write(reinterpret_cast<const char *>(&vertexCount), sizeof(int));
+    file.write(reinterpret_cast<const char *>(&landmarkCount), sizeof(int));
+    for (int l = 0; l < landmarkCount; l++)
+        file << vertexList[tables.landmarks[l]].name << '\n';
+
+    for (int d = 0; d < 2; d++)
+    {
+        file.write(reinterpret_cast<const char *>(tables.landmarkFrom[d].data()),
+                   tables.landmarkFrom[d].size() * sizeof(float));
+        file.write(reinterpret_cast<const char *>(tables.landmarkTo[d].data()),
+                   tables.landmarkTo[d].size() * sizeof(float));
+    }
+    return file.good();
+}
+
+bool multi_graph::LoadLandmarks(const std::string &filePath)
+{
+    // Read aside, the current tables stay when the file is rejected
+    std::shared_ptr<LandmarkTables> loadedTables = std::make_shared<LandmarkTables>();
+    LandmarkTables &tables = *loadedTables;
+
+    std::ifstream file(filePath.c_str(), std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    int vertexCount = 0;
+    int landmarkCount = 0;
+    file.read(reinterpret_cast<char *>(&vertexCount), sizeof(int));
+    file.read(reinterpret_cast<char *>(&landmarkCount), sizeof(int));
+    // Tables of another graph are rejected
+    if (!file || vertexCount != static_cast<int>(vertexList.size()) || landmarkCount < 0)
+        return false;
+
+    std::vector<int> loaded;
+    std::string name;
+    for (int l = 0; l < landmarkCount; l++)
+    {
+        std::getline(file, name);
+        int index = FindVertexIndex(name);
+        if (index == -1)
+            return false;
+        loaded.push_back(index);
+    }
+
+    size_t tableSize = static_cast<size_t>(vertexCount) * landmarkCount;
+    for (int d = 0; d < 2; d++)
+    {
+        tables.landmarkFrom[d].resize(tableSize);
+        tables.landmarkTo[d].resize(tableSize);
+        file.read(reinterpret_cast<char *>(tables.landmarkFrom[d].data()), tableSize * sizeof(float));
+        file.read(reinterpret_cast<char *>(tables.landmarkTo[d].data()), tableSize * sizeof(float));
+    }
+
+    if (!file)
+        return false;
+    tables.landmarks = loaded;
+    landmarkTables = loadedTables;
+    version++;
+    return true;
+}
+
+int multi_graph::LandmarkCount() const
+{
+    return static_cast<int>(landmarkTables->landmarks.size());
+}
+
+bool multi_graph::HeuristicShortestPath(std::vector<int> &orderedVertexEdgeIndexList,
+                                       const std::string &vertexNameFrom,
+                                       const std::string &vertexNameTo,
+                                       float heuristicWeight,
+                                       SearchTree *tree) const
+{
+    int index_first = FindVertexIndex(vertexNameFrom);
+    int index_end = FindVertexIndex(vertexNameTo);
+    if (index_first == -1 || index_end == -1)
+        return false;
+
+    // Goal directed (A*) when landmark tables are available, the
+    // potentials are consistent so settled vertices are still exact
+    SearchFilter filter;
+    filter.useLandmarks = true;
+    return ShortestPathCore(orderedVertexEdgeIndexList, index_first, index_end,
+                            heuristicWeight, filter, tree);
+}
+
+bool multi_graph::SearchTreePath(std::vector<int> &orderedVertexEdgeIndexList,
+                                 const SearchTree &tree, int index_end) const
+{
+    if (tree.prevVertices.size() != vertexList.size() ||
+        index_end < 0 || index_end >= static_cast<int>(vertexList.size()))
+        return false;
+
+    // Walk back from the end, then reverse
+    std::vector<int> &ove = orderedVertexEdgeIndexList;
+    ove.clear();
+    int index = index_end;
+    while (index != tree.sourceIndex)
+    {
+        if (tree.prevEdges[index] == -1 || ove.size() > 2 * vertexList.size())
         {
+            ove.clear();
+            return false;
+        }
+        ove.push_back(index);
+        ove.push_back(tree.prevEdges[index]);
+        index = tree.prevVertices[index];
+    }
+    ove.push_back(tree.sourceIndex);
+    std::reverse(ove.begin(), ove.end());
 
-            int toIndex = vertexList[i].edges[k].endVertexIndex;
+    return true;
+}
 
-            for (int l = 0; l < vertexList[toIndex].edges.size(); l++)
+bool multi_graph::FilteredShortestPath(std::vector<int> &orderedVertexEdgeIndexList,
+                                      const std::string &vertexNameFrom,
+                                      const std::string &vertexNameTo,
+                                      float heuristicWeight,
+                                      const std::vector<std::string> &edgeNames) const
+{
+    int index_first = FindVertexIndex(vertexNameFrom);
+    int index_end = FindVertexIndex(vertexNameTo);
+    if (index_first == -1 || index_end == -1)
+        return false;
+
+    // Names no edge has can not exclude anything
+    std::vector<int> nameIds;
+    for (size_t k = 0; k < edgeNames.size(); k++)
+    {
+        int nameId = FindEdgeNameId(edgeNames[k]);
+        if (nameId != -1)
+            nameIds.push_back(nameId);
+    }
+
+    // Excluding edges only makes distances longer, the bounds still hold
+    SearchFilter filter;
+    filter.excludedEdgeNameIds = &nameIds;
+    filter.useLandmarks = true;
+    return ShortestPathCore(orderedVertexEdgeIndexList, index_first, index_end,
+                            heuristicWeight, filter);
+}
+
+SearchTask multi_graph::ResumableShortestPath(std::vector<int> &orderedVertexEdgeIndexList,
+                                              std::string vertexNameFrom,
+                                              std::string vertexNameTo,
+                                              float heuristicWeight,
+                                              std::vector<std::string> edgeNames,
+                                              int yieldInterval) const
+{
+    while (true)
+    {
+        unsigned int startVersion = version;
+        int index_first = FindVertexIndex(vertexNameFrom);
+        int index_end = FindVertexIndex(vertexNameTo);
+        if (index_first == -1 || index_end == -1)
+            co_return false;
+
+        // Same filter as HeuristicShortestPath / FilteredShortestPath
+        std::vector<int> nameIds;
+        for (size_t k = 0; k < edgeNames.size(); k++)
+        {
+            int nameId = FindEdgeNameId(edgeNames[k]);
+            if (nameId != -1)
+                nameIds.push_back(nameId);
+        }
+        SearchFilter filter;
+        if (!edgeNames.empty())
+            filter.excludedEdgeNameIds = &nameIds;
+        filter.useLandmarks = true;
+
+        SearchTask search = ShortestPathSteps(orderedVertexEdgeIndexList, index_first, index_end,
+                                              heuristicWeight, filter, NULL, yieldInterval);
+        bool isStale = false;
+        while (search.Resume())
+        {
+            co_yield 0;
+            // The suspended state belongs to the graph before the change
+            if (version != startVersion)
             {
-                if (vertexList[toIndex].edges[l].endVertexIndex == i && vertexList[i].edges[k].name == vertexList[toIndex].edges[l].name)
-                    counter++;
+                isStale = true;
+                break;
             }
         }
+
+        if (!isStale)
+            co_return search.Result();
     }
-    return counter / 2;
 }
 
-int multi_graph::MaxDepthViaEdgeName(const std::string &vertexName,
-                                    const std::string &edgeName) const
+unsigned int multi_graph::Version() const
 {
-    MaxPairHeap<int, GraphVertex> pq;
+    return version;
+}
 
-    std::vector<Pair<int, GraphVertex>> pairCounts;
-    std::vector<int> counts;
+void multi_graph::SetVertexRegion(const std::string &vertexName, const std::string &regionName)
+{
+    int index = FindVertexIndex(vertexName);
+    if (index == -1)
+        throw VertexNotFoundException(vertexName);
+
+    int region;
+    std::unordered_map<std::string, int>::const_iterator it = regionIds.find(regionName);
+    if (it != regionIds.end())
+        region = it->second;
+    else
+    {
+        region = static_cast<int>(regionNames.size());
+        regionNames.push_back(regionName);
+        regionIds[regionName] = region;
+    }
 
-    Pair<int, GraphVertex> a;
+    vertexList[index].region = region;
+    isRegionsDirty = true;
+}
 
-    for (int i = 0; i < vertexList.size(); i++)
+void multi_graph::PartitionRegions(int regionSize)
+{
+    std::vector<int> queue;
+    int nameNumber = 0;
+    for (size_t seed = 0; seed < vertexList.size(); seed++)
     {
-        pairCounts.push_back(a);
-        counts.push_back(50000);
+        if (vertexList[seed].isRemoved || vertexList[seed].region != -1)
+            continue;
+
+        // Generated names skip the ones of the map file
+        std::string regionName;
+        do
+            regionName = "P" + std::to_string(nameNumber++);
+        while (regionIds.find(regionName) != regionIds.end());
+        int region = static_cast<int>(regionNames.size());
+        regionNames.push_back(regionName);
+        regionIds[regionName] = region;
+
+        // Grown over the flights of both directions, so neighbouring
+        // airports share a region and few flights cross the boundary
+        vertexList[seed].region = region;
+        queue.assign(1, static_cast<int>(seed));
+        for (size_t q = 0; q < queue.size() && static_cast<int>(queue.size()) < regionSize; q++)
+        {
+            const GraphVertex &vertex = vertexList[queue[q]];
+            for (size_t k = 0; k < vertex.edges.size() + vertex.inVertices.size(); k++)
+            {
+                int next = k < vertex.edges.size() ? vertex.edges[k].endVertexIndex
+                                                   : vertex.inVertices[k - vertex.edges.size()];
+                if (vertexList[next].region != -1 || static_cast<int>(queue.size()) >= regionSize)
+                    continue;
+                vertexList[next].region = region;
+                queue.push_back(next);
+            }
+        }
     }
+    isRegionsDirty = true;
+}
+
+int multi_graph::RegionCount() const
+{
+    return static_cast<int>(regionNames.size());
+}
 
-    for (int i = 0; i < pairCounts.size(); i++)
+int multi_graph::RegionOf(int index) const
+{
+    int region = vertexList[index].region;
+    return region == -1 ? static_cast<int>(regionNames.size()) : region;
+}
+
+void multi_graph::BuildRegions() const
+{
+    TRACE_SCOPE("BuildRegions");
+    int vertexCount = static_cast<int>(vertexList.size());
+    regions.assign(regionNames.size() + 1, GraphRegion());
+    regionSlots.assign(vertexCount, -1);
+    entrySlots.assign(vertexCount, -1);
+    exitSlots.assign(vertexCount, -1);
+
+    for (int i = 0; i < vertexCount; i++)
     {
+        const GraphVertex &vertex = vertexList[i];
+        if (vertex.isRemoved)
+            continue;
+
+        int region = RegionOf(i);
+        GraphRegion &graphRegion = regions[region];
+        regionSlots[i] = static_cast<int>(graphRegion.vertices.size());
+        graphRegion.vertices.push_back(i);
 
-        Pair<int, GraphVertex> pair;
-        pair.value = vertexList[i]; // put the vertex here
-        pair.key = i;               // put its indexfrom start here
-        pairCounts[i] = pair;
+        bool isExit = false;
+        for (size_t k = 0; k < vertex.edges.size() && !isExit; k++)
+            isExit = RegionOf(vertex.edges[k].endVertexIndex) != region;
+        bool isEntry = false;
+        for (size_t k = 0; k < vertex.inVertices.size() && !isEntry; k++)
+            isEntry = RegionOf(vertex.inVertices[k]) != region;
+
+        if (isEntry)
+        {
+            entrySlots[i] = static_cast<int>(graphRegion.entryVertices.size());
+            graphRegion.entryVertices.push_back(i);
+        }
+        if (isExit)
+        {
+            exitSlots[i] = static_cast<int>(graphRegion.exitVertices.size());
+            graphRegion.exitVertices.push_back(i);
+        }
     }
 
-    int index;
-    for (index = 0; index < vertexList.size(); index++)
+    // Overlay nodes, the entries of every region then the exits
+    overlayVertices.clear();
+    for (size_t r = 0; r < regions.size(); r++)
     {
-        if (vertexList[index].name == vertexName)
-            break;
-    } // we have the index of the first vertex
+        regions[r].entryOffset = static_cast<int>(overlayVertices.size());
+        overlayVertices.insert(overlayVertices.end(), regions[r].entryVertices.begin(),
+                               regions[r].entryVertices.end());
+    }
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        regions[r].exitOffset = static_cast<int>(overlayVertices.size());
+        overlayVertices.insert(overlayVertices.end(), regions[r].exitVertices.begin(),
+                               regions[r].exitVertices.end());
+    }
+
+    overlays.clear();
+    isRegionsDirty = false;
+}
+
+void multi_graph::BuildRegionEdges(int region) const
+{
+    GraphRegion &graphRegion = regions[region];
+    size_t vertexCount = graphRegion.vertices.size();
+    graphRegion.edgeOffsets.assign(vertexCount + 1, 0);
+    graphRegion.edgeTargets.clear();
+    graphRegion.edgeIndices.clear();
+    graphRegion.edgeWeight0.clear();
+    graphRegion.edgeWeight1.clear();
+    std::vector<int> inCounts(vertexCount + 1, 0);
+
+    for (size_t slot = 0; slot < vertexCount; slot++)
+    {
+        graphRegion.edgeOffsets[slot] = static_cast<int>(graphRegion.edgeTargets.size());
+        const GraphEdgeList &edges = vertexList[graphRegion.vertices[slot]].edges;
+        for (size_t k = 0; k < edges.size(); k++)
+        {
+            int next = edges[k].endVertexIndex;
+            if (RegionOf(next) != region)
+                continue;
 
-    counts[index] = 0;
+            graphRegion.edgeTargets.push_back(regionSlots[next]);
+            graphRegion.edgeIndices.push_back(static_cast<int>(k));
+            graphRegion.edgeWeight0.push_back(edges[k].weight[0]);
+            graphRegion.edgeWeight1.push_back(edges[k].weight[1]);
+            inCounts[regionSlots[next] + 1]++;
+        }
+    }
+    graphRegion.edgeOffsets[vertexCount] = static_cast<int>(graphRegion.edgeTargets.size());
+
+    // Reverse edges grouped by target, filled in forward order
+    for (size_t slot = 0; slot < vertexCount; slot++)
+        inCounts[slot + 1] += inCounts[slot];
+    graphRegion.inOffsets = inCounts;
+    size_t edgeCount = graphRegion.edgeTargets.size();
+    graphRegion.inSources.resize(edgeCount);
+    graphRegion.inEdgeIndices.resize(edgeCount);
+    graphRegion.inWeight0.resize(edgeCount);
+    graphRegion.inWeight1.resize(edgeCount);
+    for (size_t slot = 0; slot < vertexCount; slot++)
+    {
+        for (int j = graphRegion.edgeOffsets[slot]; j < graphRegion.edgeOffsets[slot + 1]; j++)
+        {
+            int position = inCounts[graphRegion.edgeTargets[j]]++;
+            graphRegion.inSources[position] = static_cast<int>(slot);
+            graphRegion.inEdgeIndices[position] = graphRegion.edgeIndices[j];
+            graphRegion.inWeight0[position] = graphRegion.edgeWeight0[j];
+            graphRegion.inWeight1[position] = graphRegion.edgeWeight1[j];
+        }
+    }
+    graphRegion.isEdgesDirty = false;
+}
 
-    // implementing dijkstra's algo
-    pq.push(pairCounts[index]);
+void multi_graph::RegionSearch(std::vector<float> &distances,
+                               std::vector<int> &prevVertices,
+                               std::vector<int> &prevEdges,
+                               int index, float heuristicWeight, bool isReverse) const
+{
+    const float INF = std::numeric_limits<float>::infinity();
+
+    int region = RegionOf(index);
+    if (regions[region].isEdgesDirty)
+        BuildRegionEdges(region);
+    const GraphRegion &graphRegion = regions[region];
+    const std::vector<int> &offsets = isReverse ? graphRegion.inOffsets : graphRegion.edgeOffsets;
+    const std::vector<int> &targets = isReverse ? graphRegion.inSources : graphRegion.edgeTargets;
+    const std::vector<int> &edgeIndices = isReverse ? graphRegion.inEdgeIndices : graphRegion.edgeIndices;
+    const std::vector<float> &weight0 = isReverse ? graphRegion.inWeight0 : graphRegion.edgeWeight0;
+    const std::vector<float> &weight1 = isReverse ? graphRegion.inWeight1 : graphRegion.edgeWeight1;
+
+    size_t vertexCount = graphRegion.vertices.size();
+    distances.assign(vertexCount, INF);
+    prevVertices.assign(vertexCount, -1);
+    prevEdges.assign(vertexCount, -1);
+
+    MinPairHeap<float, int> pq;
+    Pair<float, int> p;
+
+    distances[regionSlots[index]] = 0;
+    p.key = 0;
+    p.value = regionSlots[index];
+    pq.push(p);
 
     while (!pq.empty())
     {
+        Pair<float, int> a = pq.top();
+        pq.pop();
+
+        int slot = a.value;
+        float distance = distances[slot];
+        if (a.key > distance)
+            continue;
+
+        for (int j = offsets[slot]; j < offsets[slot + 1]; j++)
+        {
+            int next = targets[j];
+            float candidate = distance + Lerp(weight0[j], weight1[j], heuristicWeight);
+            if (candidate < distances[next])
+            {
+                distances[next] = candidate;
+                prevVertices[next] = slot;
+                prevEdges[next] = edgeIndices[j];
+
+                p.key = candidate;
+                p.value = next;
+                pq.push(p);
+            }
+        }
+    }
+}
+
+void multi_graph::AppendRegionLegs(std::vector<int> &orderedVertexEdgeIndexList,
+                                   const std::vector<int> &prevVertices,
+                                   const std::vector<int> &prevEdges,
+                                   int index_first, int index_end) const
+{
+    const std::vector<int> &vertices = regions[RegionOf(index_first)].vertices;
+
+    // Walk back from the end, then reverse the appended part
+    std::vector<int> &ove = orderedVertexEdgeIndexList;
+    size_t start = ove.size();
+    for (int slot = regionSlots[index_end]; slot != regionSlots[index_first]; slot = prevVertices[slot])
+    {
+        ove.push_back(vertices[slot]);
+        ove.push_back(prevEdges[slot]);
+    }
+    std::reverse(ove.begin() + start, ove.end());
+}
+
+RegionOverlay &multi_graph::OverlayOf(float heuristicWeight) const
+{
+    for (size_t i = 0; i < overlays.size(); i++)
+    {
+        if (overlays[i].alpha == heuristicWeight)
+        {
+            std::rotate(overlays.begin() + i, overlays.begin() + i + 1, overlays.end());
+            return overlays.back();
+        }
+    }
+
+    // Least recently used alpha goes first
+    if (overlays.size() >= REGION_OVERLAY_ALPHAS)
+        overlays.erase(overlays.begin());
+    overlays.push_back(RegionOverlay());
+    overlays.back().alpha = heuristicWeight;
+    overlays.back().distances.resize(regions.size());
+    return overlays.back();
+}
+
+const std::vector<float> &multi_graph::RegionTable(RegionOverlay &overlay, int region) const
+{
+    std::vector<float> &table = overlay.distances[region];
+    const GraphRegion &graphRegion = regions[region];
+    size_t exitCount = graphRegion.exitVertices.size();
+    if (!table.empty() || exitCount == 0)
+        return table;
+
+    // One search inside the region from every entry
+    table.resize(graphRegion.entryVertices.size() * exitCount);
+    std::vector<float> distances;
+    std::vector<int> prevVertices;
+    std::vector<int> prevEdges;
+    for (size_t e = 0; e < graphRegion.entryVertices.size(); e++)
+    {
+        RegionSearch(distances, prevVertices, prevEdges, graphRegion.entryVertices[e],
+                     overlay.alpha, false);
+        for (size_t x = 0; x < exitCount; x++)
+            table[e * exitCount + x] = distances[regionSlots[graphRegion.exitVertices[x]]];
+    }
+    return table;
+}
+
+void multi_graph::RegionEdgeChanged(int vertexFromIndex, int vertexToIndex) const
+{
+    if (isRegionsDirty)
+        return;
+
+    int region = RegionOf(vertexFromIndex);
+    int regionTo = RegionOf(vertexToIndex);
+    if (region == regionTo)
+    {
+        RegionChanged(region);
+        return;
+    }
+
+    // Local edge indices after a removed flight shift, the tables stay
+    regions[region].isEdgesDirty = true;
+
+    // A flight between regions only moves the boundary when it was the
+    // first or the last one of its airports
+    const GraphVertex &vertexFrom = vertexList[vertexFromIndex];
+    bool isExit = false;
+    for (size_t k = 0; k < vertexFrom.edges.size() && !isExit; k++)
+        isExit = RegionOf(vertexFrom.edges[k].endVertexIndex) != region;
+    const GraphVertex &vertexTo = vertexList[vertexToIndex];
+    bool isEntry = false;
+    for (size_t k = 0; k < vertexTo.inVertices.size() && !isEntry; k++)
+        isEntry = RegionOf(vertexTo.inVertices[k]) != regionTo;
+
+    if (isExit != (exitSlots[vertexFromIndex] != -1) || isEntry != (entrySlots[vertexToIndex] != -1))
+        isRegionsDirty = true;
+}
+
+void multi_graph::RegionChanged(int region) const
+{
+    regions[region].isEdgesDirty = true;
+    for (size_t i = 0; i < overlays.size(); i++)
+        std::vector<float>().swap(overlays[i].distances[region]);
+}
+
+bool multi_graph::RegionShortestPath(std::vector<int> &orderedVertexEdgeIndexList,
+                                     const std::string &vertexNameFrom,
+                                     const std::string &vertexNameTo,
+                                     float heuristicWeight) const
+{
+    const float INF = std::numeric_limits<float>::infinity();
+
+    int index_first = FindVertexIndex(vertexNameFrom);
+    int index_end = FindVertexIndex(vertexNameTo);
+    if (index_first == -1 || index_end == -1)
+        return false;
+    if (!CanReach(index_first, index_end, SearchFilter()))
+        return false;
+
+    if (isRegionsDirty)
+        BuildRegions();
+    RegionOverlay &overlay = OverlayOf(heuristicWeight);
+
+    // Both ends inside their own regions
+    std::vector<float> fromDistances;
+    std::vector<int> fromVertices;
+    std::vector<int> fromEdges;
+    RegionSearch(fromDistances, fromVertices, fromEdges, index_first, heuristicWeight, false);
+    std::vector<float> toDistances;
+    std::vector<int> toVertices;
+    std::vector<int> toEdges;
+    RegionSearch(toDistances, toVertices, toEdges, index_end, heuristicWeight, true);
+
+    int regionFrom = RegionOf(index_first);
+    int regionTo = RegionOf(index_end);
+
+    // Best route so far, ending at an entry node of the end's region
+    // (-1 the route inside a single region)
+    float best = (regionFrom == regionTo) ? fromDistances[regionSlots[index_end]] : INF;
+    int bestNode = -1;
+
+    // Search over the boundaries, entries go to the exits of their
+    // region through the table, exits to entries over the flights
+    int entryCount = regions[0].exitOffset;
+    std::vector<float> distances(overlayVertices.size(), INF);
+    std::vector<int> prevNodes(overlayVertices.size(), -1);
+    std::vector<int> prevEdges(overlayVertices.size(), -1);
+
+    // Goal directed (A*) with the landmark bounds when they exist, the
+    // tables are real distances so the potentials stay consistent
+    bool isLandmarkSearch = !landmarkTables->landmarks.empty();
+    std::vector<float> potentials(isLandmarkSearch ? overlayVertices.size() : 0,
+                                  std::numeric_limits<float>::quiet_NaN());
+    auto potentialOf = [&](int node)
+    {
+        if (!isLandmarkSearch)
+            return 0.0f;
+        if (potentials[node] != potentials[node])
+            potentials[node] = LandmarkPotential(overlayVertices[node], index_end, heuristicWeight);
+        return potentials[node];
+    };
+
+    MinPairHeap<float, int> pq;
+    Pair<float, int> p;
+    // Relaxes the overlay node next, edgeIndex is the flight to an entry
+    auto relax = [&](int next, float candidate, int node, int edgeIndex)
+    {
+        if (candidate >= distances[next])
+            return;
+        float potential = potentialOf(next);
+        if (potential == INF)
+            return;
+
+        distances[next] = candidate;
+        prevNodes[next] = node;
+        prevEdges[next] = edgeIndex;
+
+        p.key = candidate + potential;
+        p.value = next;
+        pq.push(p);
+    };
 
-        Pair<int, GraphVertex> a = pq.top();
+    const GraphRegion &firstRegion = regions[regionFrom];
+    for (size_t x = 0; x < firstRegion.exitVertices.size(); x++)
+    {
+        float distance = fromDistances[regionSlots[firstRegion.exitVertices[x]]];
+        if (distance != INF)
+            relax(firstRegion.exitOffset + static_cast<int>(x), distance, -1, -1);
+    }
 
+    while (!pq.empty())
+    {
+        Pair<float, int> a = pq.top();
         pq.pop();
 
-        index = a.key;
+        int node = a.value;
+        float distance = distances[node];
+        if (a.key > distance + potentialOf(node))
+            continue;
+        // Nothing left can improve the route
+        if (a.key >= best)
+            break;
+
+        int index = overlayVertices[node];
+        int region = RegionOf(index);
+        const GraphRegion &graphRegion = regions[region];
+        if (node < entryCount)
+        {
+            if (region == regionTo && distance + toDistances[regionSlots[index]] < best)
+            {
+                best = distance + toDistances[regionSlots[index]];
+                bestNode = node;
+            }
+
+            const std::vector<float> &table = RegionTable(overlay, region);
+            size_t exitCount = graphRegion.exitVertices.size();
+            const float *row = table.data() + entrySlots[index] * exitCount;
+            for (size_t x = 0; x < exitCount; x++)
+                relax(graphRegion.exitOffset + static_cast<int>(x), distance + row[x], node, -1);
+            continue;
+        }
+
+        const GraphEdgeList &edges = vertexList[index].edges;
+        for (size_t k = 0; k < edges.size(); k++)
+        {
+            int target = edges[k].endVertexIndex;
+            int targetRegion = RegionOf(target);
+            if (targetRegion == region)
+                continue;
+
+            relax(regions[targetRegion].entryOffset + entrySlots[target],
+                  distance + Lerp(edges[k].weight[0], edges[k].weight[1], heuristicWeight),
+                  node, static_cast<int>(k));
+        }
+    }
+
+    if (best == INF)
+    {
+        DropInexactReachability(SearchFilter());
+        return false;
+    }
+
+    // Overlay nodes of the route, first exit to last entry
+    std::vector<int> nodes;
+    for (int node = bestNode; node != -1; node = prevNodes[node])
+        nodes.push_back(node);
+    std::reverse(nodes.begin(), nodes.end());
+
+    std::vector<int> &ove = orderedVertexEdgeIndexList;
+    ove.clear();
+    ove.push_back(index_first);
+    if (nodes.empty())
+    {
+        AppendRegionLegs(ove, fromVertices, fromEdges, index_first, index_end);
+        return true;
+    }
+
+    AppendRegionLegs(ove, fromVertices, fromEdges, index_first, overlayVertices[nodes[0]]);
+    std::vector<float> localDistances;
+    std::vector<int> localVertices;
+    std::vector<int> localEdges;
+    for (size_t n = 1; n < nodes.size(); n++)
+    {
+        int index = overlayVertices[nodes[n]];
+        if (nodes[n] < entryCount)
+        {
+            // Flight from the previous exit
+            ove.push_back(prevEdges[nodes[n]]);
+            ove.push_back(index);
+            continue;
+        }
+
+        // Table step, searched again inside the region to unpack it
+        int entry = overlayVertices[nodes[n - 1]];
+        RegionSearch(localDistances, localVertices, localEdges, entry, heuristicWeight, false);
+        AppendRegionLegs(ove, localVertices, localEdges, entry, index);
+    }
+
+    // Last entry to the end over the reverse search
+    const std::vector<int> &lastVertices = regions[regionTo].vertices;
+    for (int slot = regionSlots[overlayVertices[nodes.back()]]; slot != regionSlots[index_end];)
+    {
+        ove.push_back(toEdges[slot]);
+        slot = toVertices[slot];
+        ove.push_back(lastVertices[slot]);
+    }
+    return true;
+}
+
+void multi_graph::ParametricSplit(std::vector<ParametricPath> &paths,
+                                  int index_first, int index_end,
+                                  const ParametricPath &left,
+                                  const ParametricPath &right,
+                                  int depth) const
+{
+    // left is optimal at left.alphaFrom, right at right.alphaTo. The cost
+    // of a path is linear in alpha (T + alpha * (P - T)), the optimum is
+    // the lower envelope of these lines.
+    float t0, p0, t1, p1;
+    PathWeights(left.orderedVertexEdgeIndexList, t0, p0);
+    PathWeights(right.orderedVertexEdgeIndexList, t1, p1);
+
+    const float EPSILON = 1e-4f * (1 + std::max(std::max(t0, p0), std::max(t1, p1)));
+    float slope0 = p0 - t0;
+    float slope1 = p1 - t1;
+
+    // Same cost line, left is optimal on the whole interval
+    if (std::fabs(t0 - t1) <= EPSILON && std::fabs(slope0 - slope1) <= EPSILON)
+    {
+        ParametricPath segment = left;
+        segment.alphaTo = right.alphaTo;
+        paths.push_back(segment);
+        return;
+    }
+
+    // Where the two lines cross, clamped against numerical noise
+    float crossing = (slope0 != slope1) ? (t1 - t0) / (slope0 - slope1)
+                                        : 0.5f * (left.alphaFrom + right.alphaTo);
+    crossing = std::min(std::max(crossing, left.alphaFrom), right.alphaTo);
+
+    SearchFilter filter;
+    filter.useLandmarks = true;
+    ParametricPath middle;
+    ShortestPathCore(middle.orderedVertexEdgeIndexList, index_first, index_end,
+                     crossing, filter);
+
+    // Nothing beats both lines at the crossing, it is a breakpoint
+    float crossingCost = t0 + crossing * slope0;
+    if (depth == 0 || PathCost(middle.orderedVertexEdgeIndexList, crossing) >= crossingCost - EPSILON)
+    {
+        ParametricPath segment = left;
+        segment.alphaTo = crossing;
+        paths.push_back(segment);
+        segment = right;
+        segment.alphaFrom = crossing;
+        paths.push_back(segment);
+        return;
+    }
+
+    ParametricPath leftPart = left;
+    leftPart.alphaTo = crossing;
+    middle.alphaFrom = crossing;
+    middle.alphaTo = crossing;
+    ParametricSplit(paths, index_first, index_end, leftPart, middle, depth - 1);
+
+    middle.alphaTo = right.alphaTo;
+    ParametricPath rightPart = right;
+    rightPart.alphaFrom = crossing;
+    ParametricSplit(paths, index_first, index_end, middle, rightPart, depth - 1);
+}
+
+bool multi_graph::ParametricShortestPaths(std::vector<ParametricPath> &paths,
+                                          const std::string &vertexNameFrom,
+                                          const std::string &vertexNameTo) const
+{
+    paths.clear();
+
+    int index_first = FindVertexIndex(vertexNameFrom);
+    int index_end = FindVertexIndex(vertexNameTo);
+    if (index_first == -1 || index_end == -1)
+        return false;
+
+    // One search per breakpoint side, starting from both ends of [0, 1]
+    SearchFilter filter;
+    filter.useLandmarks = true;
+    ParametricPath left, right;
+    left.alphaFrom = right.alphaFrom = 0;
+    left.alphaTo = right.alphaTo = 1;
+    if (!ShortestPathCore(left.orderedVertexEdgeIndexList, index_first, index_end, 0, filter) ||
+        !ShortestPathCore(right.orderedVertexEdgeIndexList, index_first, index_end, 1, filter))
+        return false;
+
+    std::vector<ParametricPath> segments;
+    ParametricSplit(segments, index_first, index_end, left, right, 32);
+
+    // Drop empty intervals, merge neighbours with the same path
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        if (!paths.empty() && paths.back().orderedVertexEdgeIndexList == segments[i].orderedVertexEdgeIndexList)
+            paths.back().alphaTo = segments[i].alphaTo;
+        else if (segments[i].alphaTo > segments[i].alphaFrom || segments.size() == 1)
+            paths.push_back(segments[i]);
+    }
+    return true;
+}
+
+bool multi_graph::KShortestPaths(std::vector<std::vector<int>> &orderedVertexEdgeIndexLists,
+                                 const std::string &vertexNameFrom,
+                                 const std::string &vertexNameTo,
+                                 float heuristicWeight, int k) const
+{
+    orderedVertexEdgeIndexLists.clear();
+
+    int index_first = FindVertexIndex(vertexNameFrom);
+    int index_end = FindVertexIndex(vertexNameTo);
+    if (index_first == -1 || index_end == -1 || k < 1)
+        return false;
+
+    // One reverse tree to the target serves every spur search, both as
+    // a shortcut when the tree path is not blocked and as exact A*
+    // potentials (removing edges can only make distances longer)
+    std::vector<float> distances;
+    std::vector<int> nextEdges;
+    ReverseShortestPathTree(distances, nextEdges, index_end, heuristicWeight);
+
+    SearchFilter filter;
+    std::vector<int> path;
+    if (!TreePath(path, nextEdges, index_first, index_end, filter))
+        return false;
+    orderedVertexEdgeIndexLists.push_back(path);
+
+    // Yen's algorithm
+    std::vector<std::vector<int>> candidates;
+    std::vector<float> candidateCosts;
+    std::vector<char> bannedVertices(vertexList.size(), 0);
+    std::vector<int> bannedEdges;
+    filter.bannedVertices = &bannedVertices;
+    filter.bannedEdges = &bannedEdges;
+    filter.potentials = &distances;
+
+    for (int n = 1; n < k; n++)
+    {
+        const std::vector<int> last = orderedVertexEdgeIndexLists.back();
 
-        for (int i = 0; i < a.value.edges.size(); i++)
+        // Every vertex of the last path except the end is a spur vertex
+        for (size_t i = 0; i + 1 < last.size(); i += 2)
         {
+            int spur = last[i];
 
-            if (a.value.edges[i].name == edgeName)
+            // Edges leaving the spur on accepted paths with the same root
+            bannedEdges.clear();
+            for (size_t j = 0; j < orderedVertexEdgeIndexLists.size(); j++)
             {
+                const std::vector<int> &accepted = orderedVertexEdgeIndexLists[j];
+                if (accepted.size() > i + 1 &&
+                    std::equal(last.begin(), last.begin() + i + 1, accepted.begin()))
+                    bannedEdges.push_back(accepted[i + 1]);
+            }
+            filter.bannedEdgeVertex = spur;
 
-                int next_index = a.value.edges[i].endVertexIndex;
+            // Root vertices can not be visited again (loopless)
+            for (size_t j = 0; j < i; j += 2)
+                bannedVertices[last[j]] = 1;
 
-                if (counts[index] + 1 < counts[next_index])
-                {
+            std::vector<int> spurPath;
+            bool isFound = TreePath(spurPath, nextEdges, spur, index_end, filter) ||
+                           ShortestPathCore(spurPath, spur, index_end,
+                                            heuristicWeight, filter);
 
-                    counts[next_index] = counts[index] + 1;
+            for (size_t j = 0; j < i; j += 2)
+                bannedVertices[last[j]] = 0;
 
-                    pq.push(pairCounts[next_index]);
-                }
+            if (!isFound)
+                continue;
+
+            std::vector<int> candidate(last.begin(), last.begin() + i);
+            candidate.insert(candidate.end(), spurPath.begin(), spurPath.end());
+
+            if (std::find(candidates.begin(), candidates.end(), candidate) != candidates.end())
+                continue;
+
+            candidateCosts.push_back(PathCost(candidate, heuristicWeight));
+            candidates.push_back(candidate);
+        }
+
+        if (candidates.empty())
+            break;
+
+        size_t best = std::min_element(candidateCosts.begin(), candidateCosts.end()) -
+                      candidateCosts.begin();
+        orderedVertexEdgeIndexLists.push_back(candidates[best]);
+        candidates.erase(candidates.begin() + best);
+        candidateCosts.erase(candidateCosts.begin() + best);
+    }
+
+    return true;
+}
+
+int multi_graph::BiDirectionalEdgeCount() const
+{
+    int counter = 0;
+
+    for (int i = 0; i < vertexList.size(); i++)
+    {
+        for (int k = 0; k < vertexList[i].edges.size(); k++)
+        {
+
+            int toIndex = vertexList[i].edges[k].endVertexIndex;
+
+            for (int l = 0; l < vertexList[toIndex].edges.size(); l++)
+            {
+                if (vertexList[toIndex].edges[l].endVertexIndex == i && vertexList[i].edges[k].nameId == vertexList[toIndex].edges[l].nameId)
+                    counter++;
             }
         }
     }
+    return counter / 2;
+}
+
+int multi_graph::MaxDepthViaEdgeName(const std::string &vertexName,
+                                    const std::string &edgeName) const
+{
+    int index = FindVertexIndex(vertexName);
+    if (index == -1)
+        throw VertexNotFoundException(vertexName);
+
+    // Hop counts over the edges of the given name only
+    UnitWeightPolicy weight;
+    weight.edgeNameId = FindEdgeNameId(edgeName);
+
+    std::vector<float> counts;
+    std::vector<int> prevVertices, prevEdges;
+    ShortestPathTreeKernel(counts, prevVertices, prevEdges, index, weight);
 
     int maximum = -20;
 
-    for (int i = 0; i < counts.size(); i++)
+    for (size_t i = 0; i < counts.size(); i++)
     {
-        if (counts[i] > maximum && counts[i] != 50000)
+        if (counts[i] != std::numeric_limits<float>::infinity() && counts[i] > maximum)
         {
-            maximum = counts[i];
+            maximum = static_cast<int>(counts[i]);
         }
     }
 
     return maximum;
 }
 
+const std::string &multi_graph::EdgeName(const GraphEdge &edge) const
+{
+    return edgeNames[edge.nameId];
+}
+
 GraphEdge multi_graph::getEdge(const std::string &edgeName,
                               const std::string &vertexFromName,
                               const std::string &vertexToName)
 {
+    int i = FindVertexIndex(vertexFromName);
+    int l = FindVertexIndex(vertexToName);
 
-    for (int i = 0; i < vertexList.size(); i++)
+    int nameId = FindEdgeNameId(edgeName);
+    if (i != -1 && l != -1)
     {
-        if (vertexList[i].name == vertexFromName)
+        for (int k = 0; k < vertexList[i].edges.size(); k++)
         {
-            for (int k = 0; k < vertexList[i].edges.size(); k++)
-            {
-                for (int l = 0; l < vertexList.size(); l++)
-                {
-
-                    if (vertexList[i].edges[k].name == edgeName && vertexList[l].name == vertexToName && vertexList[i].edges[k].endVertexIndex == l)
-                        return vertexList[i].edges[k];
-                }
-            }
+            if (vertexList[i].edges[k].nameId == nameId && vertexList[i].edges[k].endVertexIndex == l)
+                return vertexList[i].edges[k];
         }
     }
 
@@ -659,25 +3417,26 @@ GraphEdge multi_graph::getEdge(const std::string &edgeName,
 
 int multi_graph::getVertexIndex(const std::string &vertexName)
 {
-
-    for (int i = 0; i < vertexList.size(); i++)
-    {
-        if (vertexList[i].name == vertexName)
-            return i;
-    }
-
-    throw VertexNotFoundException(vertexName);
+    int i = FindVertexIndex(vertexName);
+    if (i == -1)
+        throw VertexNotFoundException(vertexName);
+    return i;
 }
 
 void multi_graph::getVertexIndexModified(const std::string &vertexName, std::vector<int> &v) const
 {
+    int i = FindVertexIndex(vertexName);
+    if (i == -1)
+        throw VertexNotFoundException(vertexName);
+    v.push_back(i);
+}
 
-    for (int i = 0; i < vertexList.size(); i++)
-    {
-        if (vertexList[i].name == vertexName)
-            v.push_back(i);
-        return;
-    }
+int multi_graph::VertexCount() const
+{
+    return static_cast<int>(vertexList.size()) - removedVertexCount;
+}
 
-    throw VertexNotFoundException(vertexName);
-}
\ No newline at end of file
+int multi_graph::RemovedVertexCount() const
+{
+    return removedVertexCount;
+}
@@ -1,36 +1,509 @@
 #ifndef MULTI_GRAPH_H
 #define MULTI_GRAPH_H
 
+#include <memory>
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "BlockPool.h"
+#include "SearchTask.h"
+#include "SharedChunks.h"
+
+class OutputBuffer;
+
+// Largest code of a compact (16 bit) edge weight
+#define COMPACT_WEIGHT_MAX 65535
+// Alphas with region overlay tables kept at once
+#define REGION_OVERLAY_ALPHAS 4
+// A shared search index is rebuilt once more than 1/N of the vertices
+// changed since it was built
+#define STALE_INDEX_RATIO 16
+// Largest table of reachable component pairs, larger condensations keep
+// only the ranges
+#define REACHABILITY_MAX_BITSET_BYTES (4 * 1024 * 1024)
+// Labels of the graph without one edge name kept at once
+#define REACHABILITY_FILTERED_LABELS 8
+
+struct FlightDeparture
+{
+    float departureTime;
+    float arrivalTime;
+};
 
 struct GraphEdge
 {
-    std::string name;
+    // Interned name, see multi_graph::EdgeName
+    int nameId;
     float weight[2];
     int endVertexIndex;
+    // Slot of the edge in the incoming lists of its end vertex
+    int inSlot;
+    // Timetable of the flight, may be empty
+    std::vector<FlightDeparture> departures;
 };
 
+// Per vertex arrays live in the shared block pool, they are small and
+// change size often
+typedef std::vector<GraphEdge, PoolAllocator<GraphEdge>> GraphEdgeList;
+typedef std::vector<int, PoolAllocator<int>> GraphIndexList;
+
 struct GraphVertex
 {
-    std::vector<GraphEdge> edges;
+    GraphEdgeList edges;
+    // Minimum time between an arrival and a connecting departure
+    float minConnectionTime = 0;
+    // Source vertex of every incoming edge (one entry per edge) and the
+    // local index of the edge there
+    GraphIndexList inVertices;
+    GraphIndexList inEdges;
     std::string name;
+    // Tombstone, vertex indices stay stable until compaction
+    bool isRemoved = false;
+    // Region name id of the partitioned mode, -1 when not assigned
+    int region = -1;
+};
+
+// Single scheduled departure of an edge, flattened for connection scan
+struct GraphConnection
+{
+    float departureTime;
+    float arrivalTime;
+    int vertexFromIndex;
+    int edgeIndex;
+};
+
+// Optimal path of an alpha interval of the parametric search
+struct ParametricPath
+{
+    float alphaFrom;
+    float alphaTo;
+    std::vector<int> orderedVertexEdgeIndexList;
+};
+
+// Complete shortest path tree of a hot origin for one alpha, repaired
+// in place when edge weights change
+struct DynamicTree
+{
+    std::string sourceName;
+    int sourceIndex = -1;
+    float alpha = 0;
+    std::vector<float> distances;
+    std::vector<int> prevVertices;
+    std::vector<int> prevEdges;
+};
+
+// Airports of a region and its boundary: entries have a flight from
+// another region, exits a flight to another region
+struct GraphRegion
+{
+    std::vector<int> vertices;
+    std::vector<int> entryVertices;
+    std::vector<int> exitVertices;
+    // First overlay node of the entries and of the exits
+    int entryOffset = 0;
+    int exitOffset = 0;
+
+    // Flights inside the region by region slot, forward and reverse
+    // (edge indices are local to the source vertex), rebuilt after one
+    // of them changes
+    std::vector<int> edgeOffsets;
+    std::vector<int> edgeTargets;
+    std::vector<int> edgeIndices;
+    std::vector<float> edgeWeight0;
+    std::vector<float> edgeWeight1;
+    std::vector<int> inOffsets;
+    std::vector<int> inSources;
+    std::vector<int> inEdgeIndices;
+    std::vector<float> inWeight0;
+    std::vector<float> inWeight1;
+    bool isEdgesDirty = true;
 };
 
+// Shortest entry to exit distances inside every region for one alpha
+// (entry-major), empty until a search first reaches the region
+struct RegionOverlay
+{
+    float alpha = 0;
+    std::vector<std::vector<float>> distances;
+};
+
+// Route as plain data, leg i goes from vertexIndices[i] over its local
+// edge edgeIndices[i] to vertexIndices[i + 1]
+struct FlightItinerary
+{
+    std::vector<int> vertexIndices;
+    std::vector<int> edgeIndices;
+    // Both weights and the alpha blend of every leg
+    std::vector<float> legWeight0;
+    std::vector<float> legWeight1;
+    std::vector<float> legCosts;
+    float alpha = 0;
+    float totalCost = 0;
+    bool isCacheHit = false;
+};
+
+// Restrictions the search core applies on top of the graph
+struct SearchFilter
+{
+    // Interned names of the edges that can not be taken
+    const std::vector<int> *excludedEdgeNameIds = NULL;
+    // Vertices that can not be entered (indexed by vertex)
+    const std::vector<char> *bannedVertices = NULL;
+    // Local edge indices that can not be taken from bannedEdgeVertex
+    int bannedEdgeVertex = -1;
+    const std::vector<int> *bannedEdges = NULL;
+    // Lower bounds of the distance to the target (A* potentials)
+    const std::vector<float> *potentials = NULL;
+    // Use the landmark lower bounds when potentials are not given
+    bool useLandmarks = false;
+};
+
+// Bytes held by a graph per subsystem, from the container capacities
+// (hash map nodes are estimated)
+struct GraphMemoryUsage
+{
+    // Vertex array, airport names and the name lookup
+    size_t vertexBytes = 0;
+    // Edge and incoming vertex arrays, timetables
+    size_t edgeBytes = 0;
+    // Interned edge (airline) names
+    size_t edgeNameBytes = 0;
+    size_t searchIndexBytes = 0;
+    size_t landmarkBytes = 0;
+    size_t connectionBytes = 0;
+    size_t hotTreeBytes = 0;
+    size_t reachabilityBytes = 0;
+    // Region boundaries and overlay tables
+    size_t regionBytes = 0;
+    size_t totalBytes = 0;
+};
+
+// How close together the two ends of the flights are stored (what
+// ReorderVertices improves), over the live vertices
+struct GraphLayoutLocality
+{
+    // Mean index distance between the ends of a flight
+    double meanIndexGap = 0;
+    // Percentage of flights whose ends have their per-vertex float
+    // (distance) entries in one 64 byte cache line, or one 4 KiB page
+    double sameLinePercent = 0;
+    double samePagePercent = 0;
+};
+
+// Settled part of a single source search (predecessor arrays indexed
+// by vertex, -1 when the vertex is not in the tree)
+struct SearchTree
+{
+    int sourceIndex = -1;
+    // Alpha of the searches that settled it
+    float alpha = -1;
+    std::vector<int> prevVertices;
+    std::vector<int> prevEdges;
+};
+
+// Strongly connected component of every vertex, numbered in the order
+// Tarjan finishes them (a component only reaches lower numbers), and
+// per component the lowest number it reaches. A path can only exist
+// when the [low, component] range of its end lies within the one of
+// its start, but the ranges also pass pairs on sibling branches. Up to
+// REACHABILITY_MAX_BITSET_BYTES a bit per pair of components (the
+// condensation closed in component order) tells them apart.
+struct ReachabilityLabels
+{
+    std::vector<int> components;
+    std::vector<int> lows;
+    // wordCount words per component, bit j of row i when component i
+    // reaches j, empty above the limit (ranges only)
+    std::vector<unsigned long long> reachable;
+    int wordCount = 0;
+    // Edge name left out, -1 for the whole graph
+    int excludedNameId = -1;
+    // False once edges were removed, the ranges may allow pairs that
+    // are no longer connected
+    bool isExact = true;
+};
+
+// Lines of a delta file (multi_graph::ReadDelta):
+//   ADD from to airline w0 w1
+//   REMOVE from to airline
+//   UPDATE from to airline w0 w1
+//   DEP from to airline departure arrival
+//   ADD_AIRPORT airport
+//   REMOVE_AIRPORT airport
+#define GRAPH_CHANGE_ADD_EDGE 0
+#define GRAPH_CHANGE_REMOVE_EDGE 1
+#define GRAPH_CHANGE_UPDATE_EDGE 2
+#define GRAPH_CHANGE_ADD_DEPARTURE 3
+#define GRAPH_CHANGE_ADD_VERTEX 4
+#define GRAPH_CHANGE_REMOVE_VERTEX 5
+
+struct GraphChange
+{
+    int type = GRAPH_CHANGE_ADD_EDGE;
+    // The only name of the vertex changes
+    std::string vertexFromName;
+    std::string vertexToName;
+    std::string edgeName;
+    // Edge weights, or departure and arrival time
+    float values[2] = {0, 0};
+};
+
+// Edge of a change by index, weights after the change
+struct GraphEdgeChange
+{
+    int vertexFromIndex;
+    int edgeIndex;
+    int vertexToIndex;
+    float weight0;
+    float weight1;
+};
+
+// What a batch of changes did, for the caches over the graph
+struct GraphChangeResult
+{
+    // Per change, 0 when its vertex or edge was missing (or already
+    // there)
+    std::vector<char> isApplied;
+    // Removed vertices and the vertices whose local edge indices
+    // shifted, sorted
+    std::vector<int> shiftedVertices;
+    // Edges costlier for some alpha, and edges that are new or cheaper
+    // for some alpha (an edge changed twice is listed twice)
+    std::vector<GraphEdgeChange> costlierEdges;
+    std::vector<GraphEdgeChange> cheaperEdges;
+    int appliedCount = 0;
+};
+
+// Out edges flattened as structure of arrays for the search kernels
+// (same order as GraphVertex::edges)
+struct SearchIndex
+{
+    std::vector<int> edgeOffsets;
+    std::vector<float> edgeWeight0;
+    std::vector<float> edgeWeight1;
+    std::vector<int> edgeTargets;
+    int maxOutDegree = 0;
+    // Optional 16 bit weights (multiples of compactStep) replacing
+    // edgeWeight0/1
+    std::vector<unsigned short> compactWeight0;
+    std::vector<unsigned short> compactWeight1;
+    bool isCompactIndex = false;
+};
+
+// ALT landmark distances per weight dimension, landmark-major
+// ([l * vertexCount + v])
+struct LandmarkTables
+{
+    std::vector<int> landmarks;
+    std::vector<float> landmarkFrom[2];
+    std::vector<float> landmarkTo[2];
+};
+
+// A copy of a graph is a snapshot: it shares the vertex chunks, the name
+// lookup, the search index and the landmarks with the original, and
+// either of them copies a part only when it changes it. Lazily built
+// data (connections, hot trees, regions, filtered reachability) is
+// rebuilt by the copy when it needs it. Snapshots may not be used from
+// several threads at once.
 class multi_graph
 {
 private:
-    std::vector<GraphVertex> vertexList;
+    SharedChunks<GraphVertex> vertexList;
+    // Copied by the first vertex insertion or removal of a snapshot
+    std::shared_ptr<std::unordered_map<std::string, int>> vertexIndices;
+    int removedVertexCount;
+
+    // Incremented by every change a suspended search can not survive
+    unsigned int version;
+
+    // Every distinct edge name is stored once, edges keep its index
+    std::vector<std::string> edgeNames;
+    std::unordered_map<std::string, int> edgeNameIds;
+
+    // Connections sorted by departure time, rebuilt lazily after changes
+    mutable std::vector<GraphConnection> connections;
+    mutable bool isConnectionsDirty;
+
+    // Cleared whenever the topology changes, never written while shared
+    std::shared_ptr<LandmarkTables> landmarkTables;
+
+    // Rebuilt lazily after changes. An index shared with a snapshot is
+    // not written, the vertices changed since are searched over their
+    // edge lists instead.
+    mutable std::shared_ptr<SearchIndex> searchIndex;
+    mutable bool isSearchIndexDirty;
+    mutable std::unordered_set<int> staleIndexVertices;
+    // Step of the compact weights, 0 keeps the float weights
+    float compactStep;
+
+    // Trees of the registered hot origins, rebuilt lazily after
+    // topology changes and repaired after weight updates
+    mutable std::vector<DynamicTree> hotTrees;
+    mutable bool isHotTreesDirty;
+
+    // Labels of the whole graph and of the graph without one edge name
+    // (for the filtered searches, most recently used first, at most
+    // REACHABILITY_FILTERED_LABELS), built lazily. Removed edges leave
+    // them valid, an added edge drops the ones it breaks.
+    mutable ReachabilityLabels reachability;
+    mutable std::vector<ReachabilityLabels> reachabilityWithout;
+
+    // Partitioned mode. Region names are interned like the edge names,
+    // vertices without a region share the last one. Boundaries are
+    // rebuilt lazily, overlay tables per region and alpha (most
+    // recently used alpha last).
+    std::vector<std::string> regionNames;
+    std::unordered_map<std::string, int> regionIds;
+    mutable std::vector<GraphRegion> regions;
+    // Position of every vertex in its region and boundary lists (-1 not
+    // there)
+    mutable std::vector<int> regionSlots;
+    mutable std::vector<int> entrySlots;
+    mutable std::vector<int> exitSlots;
+    // Vertex of every overlay node, the entries of all regions first
+    mutable std::vector<int> overlayVertices;
+    mutable bool isRegionsDirty;
+    mutable std::vector<RegionOverlay> overlays;
 
     static float Lerp(float w0, float w1, float alpha);
 
+    void BuildConnections() const;
+
+    static bool IsEdgeFiltered(const SearchFilter &filter,
+                               const GraphEdge &edge,
+                               int vertexIndex, int edgeIndex);
+
+    // excludedNameId -1 labels the whole graph
+    void BuildReachability(ReachabilityLabels &labels, int excludedNameId) const;
+    void BuildReachableComponents(ReachabilityLabels &labels) const;
+    // Labels without the edge name, built or moved to the front
+    ReachabilityLabels &FilteredReachability(int excludedNameId) const;
+    static bool IsInRange(const ReachabilityLabels &labels, int index_first, int index_end);
+    // False when no path can exist under the filter
+    bool CanReach(int index_first, int index_end, const SearchFilter &filter) const;
+    // After a search the labels allowed found nothing
+    void DropInexactReachability(const SearchFilter &filter) const;
+    void ClearReachability();
+    void MarkReachabilityInexact();
+    void ReachabilityEdgeAdded(int vertexFromIndex, int vertexToIndex, int nameId);
+
+    int RegionOf(int index) const;
+    void BuildRegions() const;
+    void BuildRegionEdges(int region) const;
+    // Search restricted to the region of index, arrays (and the stored
+    // vertices) are region slots. The reverse search stores the next
+    // vertex and edge.
+    void RegionSearch(std::vector<float> &distances,
+                      std::vector<int> &prevVertices,
+                      std::vector<int> &prevEdges,
+                      int index, float heuristicWeight, bool isReverse) const;
+    // Appends the legs after index_first up to index_end
+    void AppendRegionLegs(std::vector<int> &orderedVertexEdgeIndexList,
+                          const std::vector<int> &prevVertices,
+                          const std::vector<int> &prevEdges,
+                          int index_first, int index_end) const;
+    RegionOverlay &OverlayOf(float heuristicWeight) const;
+    const std::vector<float> &RegionTable(RegionOverlay &overlay, int region) const;
+    // Keeps the boundaries and tables valid after an edge change
+    void RegionEdgeChanged(int vertexFromIndex, int vertexToIndex) const;
+    // Edges of the region changed, its tables go too
+    void RegionChanged(int region) const;
+    // Entry points dispatch on alpha to a kernel specialized for the
+    // weight policy (see WeightPolicy.h)
+    bool ShortestPathCore(std::vector<int> &orderedVertexEdgeIndexList,
+                          int index_first, int index_end,
+                          float heuristicWeight,
+                          const SearchFilter &filter,
+                          SearchTree *tree = NULL) const;
+    // Same search in slices, suspends every yieldInterval settled
+    // vertices (0 never). The filter must outlive the task.
+    SearchTask ShortestPathSteps(std::vector<int> &orderedVertexEdgeIndexList,
+                                 int index_first, int index_end,
+                                 float heuristicWeight,
+                                 const SearchFilter &filter,
+                                 SearchTree *tree, int yieldInterval) const;
+    template <class WeightPolicy>
+    SearchTask ShortestPathKernel(std::vector<int> &orderedVertexEdgeIndexList,
+                                  int index_first, int index_end,
+                                  WeightPolicy weightOf,
+                                  const SearchFilter &filter,
+                                  SearchTree *tree, int yieldInterval) const;
+    void ReverseShortestPathTree(std::vector<float> &distances,
+                                 std::vector<int> &nextEdges,
+                                 int index_end, float heuristicWeight) const;
+    template <class WeightPolicy>
+    void ReverseShortestPathTreeKernel(std::vector<float> &distances,
+                                       std::vector<int> &nextEdges,
+                                       int index_end,
+                                       const WeightPolicy &weightOf) const;
+    bool TreePath(std::vector<int> &orderedVertexEdgeIndexList,
+                  const std::vector<int> &nextEdges,
+                  int index_first, int index_end,
+                  const SearchFilter &filter) const;
+    void ShortestPathTree(std::vector<float> &distances,
+                          std::vector<int> &prevVertices,
+                          std::vector<int> &prevEdges,
+                          int index_first, float heuristicWeight) const;
+    template <class WeightPolicy>
+    void ShortestPathTreeKernel(std::vector<float> &distances,
+                                std::vector<int> &prevVertices,
+                                std::vector<int> &prevEdges,
+                                int index_first,
+                                const WeightPolicy &weightOf) const;
+    float LandmarkBound(int dimension, int index, int index_end) const;
+    float LandmarkPotential(int index, int index_end, float heuristicWeight) const;
+    void ClearLandmarks();
+    void TopologyChanged();
+    // Edges of the vertex changed
+    void SearchIndexChanged(int index);
+    bool IsIndexed(int index) const;
+    std::unordered_map<std::string, int> &WritableVertexIndices();
+    // Moves vertex i to oldToNewIndex[i] (-1 drops it)
+    void RenumberVertices(const std::vector<int> &oldToNewIndex, int vertexCount);
+    void BuildSearchIndex() const;
+    // False when the weight is negative or out of the code range
+    bool EncodeWeight(unsigned short &code, float weight) const;
+    void BuildHotTree(DynamicTree &tree) const;
+    void RebuildHotTrees() const;
+    void RepairHotTree(DynamicTree &tree, int vertexFromIndex, int edgeIndex,
+                       float oldWeight, float newWeight) const;
+    float PathCost(const std::vector<int> &orderedVertexEdgeIndexList,
+                   float heuristicWeight) const;
+    void PathWeights(const std::vector<int> &orderedVertexEdgeIndexList,
+                     float &weight0, float &weight1) const;
+    void ParametricSplit(std::vector<ParametricPath> &paths,
+                         int index_first, int index_end,
+                         const ParametricPath &left,
+                         const ParametricPath &right,
+                         int depth) const;
+
+    int FindVertexIndex(const std::string &vertexName) const;
+    int InternEdgeName(const std::string &edgeName);
+    // -1 when no edge was ever named so
+    int FindEdgeNameId(const std::string &edgeName) const;
+    // Drops an incoming edge of the vertex in O(1)
+    void RemoveInEdge(int vertexIndex, int inSlot);
+    // Tells the end vertices of the edges from begin on their new local
+    // index
+    void UpdateInEdges(int vertexIndex, size_t begin);
+
 protected:
 public:
     multi_graph();
     multi_graph(const std::string &filePath);
+    // Snapshot of the graph, see the class comment
+    multi_graph(const multi_graph &other);
+    multi_graph &operator=(const multi_graph &) = delete;
 
     void InsertVertex(const std::string &vertexName);
     void RemoveVertex(const std::string &vertexName);
+    void RemoveVertex(const std::string &vertexName,
+                      std::vector<int> &affectedVertexIndices);
+    void CompactVertices(std::vector<int> &oldToNewIndex);
+    // Renumbers (and compacts) the vertices so that adjacent ones are
+    // stored close together, names and local edge indices stay
+    void ReorderVertices(std::vector<int> &oldToNewIndex);
 
     void AddEdge(const std::string &edgeName,
                  const std::string &vertexFromName,
@@ -39,33 +512,132 @@ public:
     void RemoveEdge(const std::string &edgeName,
                     const std::string &vertexFromName,
                     const std::string &vertexToName);
+    // Returns the local index of the updated edge
+    int UpdateEdgeWeights(const std::string &edgeName,
+                          const std::string &vertexFromName,
+                          const std::string &vertexToName,
+                          float weight0, float weight1);
+
+    // Partitioned mode, "REGION airport name" lines of the map file
+    void SetVertexRegion(const std::string &vertexName, const std::string &regionName);
+    // Puts the vertices without a region into regions of about
+    // regionSize vertices, grown breadth first over the flights
+    void PartitionRegions(int regionSize);
+    int RegionCount() const;
+    // Same cost as HeuristicShortestPath, searched inside the regions of
+    // both ends and over the boundaries of the others (entry to exit
+    // tables and the flights between regions)
+    bool RegionShortestPath(std::vector<int> &orderedVertexEdgeIndexList,
+                            const std::string &vertexNameFrom,
+                            const std::string &vertexNameTo,
+                            float heuristicWeight) const;
+
+    // False when the file can not be opened, malformed lines are
+    // reported and skipped
+    static bool ReadDelta(std::vector<GraphChange> &changes, const std::string &filePath);
+    // Applies the changes in order as one update of the derived data.
+    // Landmarks survive a batch that adds no vertex and makes no edge
+    // cheaper; a change that fails leaves the others applied.
+    void ApplyChanges(const std::vector<GraphChange> &changes, GraphChangeResult &result);
+    // False only when no path from the first to the end vertex exists,
+    // true only when one does unless edges were removed or the
+    // condensation is past REACHABILITY_MAX_BITSET_BYTES
+    bool MayReach(int index_first, int index_end) const;
+
+    void AddDeparture(const std::string &edgeName,
+                      const std::string &vertexFromName,
+                      const std::string &vertexToName,
+                      float departureTime, float arrivalTime);
+    void SetMinConnectionTime(const std::string &vertexName,
+                              float minConnectionTime);
 
     bool HeuristicShortestPath(std::vector<int> &orderedVertexEdgeIndexList,
                                const std::string &vertexNameFrom,
                                const std::string &vertexNameTo,
-                               float heuristicWeight) const;
+                               float heuristicWeight,
+                               SearchTree *tree = NULL) const;
+    bool SearchTreePath(std::vector<int> &orderedVertexEdgeIndexList,
+                        const SearchTree &tree, int index_end) const;
+    void RegisterHotOrigin(const std::string &vertexName, float heuristicWeight);
+    void UnregisterHotOrigin(const std::string &vertexName, float heuristicWeight);
+    bool HotOriginPath(std::vector<int> &orderedVertexEdgeIndexList,
+                       const std::string &vertexNameFrom,
+                       const std::string &vertexNameTo,
+                       float heuristicWeight) const;
     bool FilteredShortestPath(std::vector<int> &orderedVertexEdgeIndexList,
                               const std::string &vertexNameFrom,
                               const std::string &vertexNameTo,
                               float heuristicWeight,
                               const std::vector<std::string> &edgeNames) const;
+    // HeuristicShortestPath (FilteredShortestPath with edge names) in
+    // slices of yieldInterval settled vertices. A slice after a change
+    // of the graph starts the search over. The path must outlive it.
+    SearchTask ResumableShortestPath(std::vector<int> &orderedVertexEdgeIndexList,
+                                     std::string vertexNameFrom,
+                                     std::string vertexNameTo,
+                                     float heuristicWeight,
+                                     std::vector<std::string> edgeNames,
+                                     int yieldInterval) const;
+    unsigned int Version() const;
+
+    // Point to point searches run on weights rounded to within maxError
+    // (16 bit codes, 0 restores the exact weights). Search trees keep
+    // the exact weights. Ignored while some weight does not fit.
+    void SetCompactWeights(float maxError);
+    bool IsCompactIndex() const;
+    void MemoryUsage(GraphMemoryUsage &usage) const;
+    void LayoutLocality(GraphLayoutLocality &locality) const;
+
+    void BuildLandmarks(int landmarkCount);
+    bool SaveLandmarks(const std::string &filePath) const;
+    // Tables saved for this graph, false keeps the current ones
+    bool LoadLandmarks(const std::string &filePath);
+    int LandmarkCount() const;
+
+    bool ParametricShortestPaths(std::vector<ParametricPath> &paths,
+                                 const std::string &vertexNameFrom,
+                                 const std::string &vertexNameTo) const;
+    bool KShortestPaths(std::vector<std::vector<int>> &orderedVertexEdgeIndexLists,
+                        const std::string &vertexNameFrom,
+                        const std::string &vertexNameTo,
+                        float heuristicWeight, int k) const;
+    bool EarliestArrivalPath(std::vector<int> &orderedVertexEdgeIndexList,
+                             std::vector<FlightDeparture> &legTimes,
+                             const std::string &vertexNameFrom,
+                             const std::string &vertexNameTo,
+                             float departureTime) const;
 
     int BiDirectionalEdgeCount() const;
     int MaxDepthViaEdgeName(const std::string &vertexName,
                             const std::string &edgeName) const;
 
+    void MakeItinerary(FlightItinerary &itinerary,
+                       const std::vector<int> &orderedVertexEdgeIndexList,
+                       float heuristicWeight) const;
+
     void PrintPath(const std::vector<int> &orderedVertexEdgeIndexList,
                    float heuristicWeight,
                    bool sameLine = false) const;
+    // Renders the PrintPath text into out without writing it
+    void FormatPath(OutputBuffer &out,
+                    const std::vector<int> &orderedVertexEdgeIndexList,
+                    float heuristicWeight,
+                    bool sameLine = false) const;
+    void PrintTimedPath(const std::vector<int> &orderedVertexEdgeIndexList,
+                        const std::vector<FlightDeparture> &legTimes) const;
     void PrintEntireGraph() const;
 
 public:
+    const std::string &EdgeName(const GraphEdge &edge) const;
     GraphEdge getEdge(const std::string &edgeName,
                       const std::string &vertexFromName,
                       const std::string &vertexToName);
 
     int getVertexIndex(const std::string &vertexName);
     void getVertexIndexModified(const std::string &vertexName, std::vector<int> &v) const;
+
+    int VertexCount() const;
+    int RemovedVertexCount() const;
 };
 
 #endif // MULTI_GRAPH_H
\ No newline at end of file
@@ -0,0 +1,302 @@
+#include "output_writer.h"
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+void OutputBuffer::Append(const std::string &text)
+{
+    data.append(text);
+}
+
+void OutputBuffer::Append(const char *text)
+{
+    data.append(text);
+}
+
+void OutputBuffer::Append(char c)
+{
+    data.push_back(c);
+}
+
+// Pads the text written at [start, end of data) on the left
+static void PadLeft(std::string &data, size_t start, int width, char fill)
+{
+    size_t length = data.size() - start;
+    if (width > 0 && length < static_cast<size_t>(width))
+        data.insert(start, static_cast<size_t>(width) - length, fill);
+}
+
+void OutputBuffer::AppendInt(int value, int width, char fill)
+{
+    char text[16];
+    std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+
+    size_t start = data.size();
+    data.append(text, result.ptr);
+    PadLeft(data, start, width, fill);
+}
+
+void OutputBuffer::AppendFloat(float value, int width, char fill)
+{
+    // std::ostream prints floats as %g with precision 6
+    char text[32];
+    std::to_chars_result result = std::to_chars(text, text + sizeof(text), value,
+                                                std::chars_format::general, 6);
+
+    size_t start = data.size();
+    data.append(text, result.ptr);
+    PadLeft(data, start, width, fill);
+}
+
+void OutputBuffer::AppendFormat(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+
+    size_t start = data.size();
+    int length = vsnprintf(NULL, 0, format, args);
+    if (length > 0)
+    {
+        data.resize(start + length + 1);
+        vsnprintf(&data[start], length + 1, format, argsCopy);
+        data.resize(start + length);
+    }
+
+    va_end(argsCopy);
+    va_end(args);
+}
+
+const std::string &OutputBuffer::Data() const
+{
+    return data;
+}
+
+void OutputBuffer::Swap(std::string &other)
+{
+    data.swap(other);
+}
+
+void OutputBuffer::Clear()
+{
+    data.clear();
+}
+
+static std::atomic<bool> isAsyncOutput(true);
+// Set while the writer exists, lets late callers skip waiting on it
+static std::atomic<bool> isWriterRunning(false);
+
+// Background thread draining the flushed buffers
+class OutputWriter
+{
+private:
+    std::mutex mutex;
+    std::condition_variable hasWork;
+    std::condition_variable hasRoom;
+    std::vector<std::string> pending;
+    // Written strings are returned to the flushing threads for reuse
+    std::vector<std::string> spare;
+    size_t pendingBytes;
+    bool isWriting;
+    bool isStopped;
+    std::thread thread;
+
+    void Run();
+
+public:
+    OutputWriter();
+    ~OutputWriter();
+
+    void Push(OutputBuffer &buffer);
+    void Wait();
+};
+
+OutputWriter::OutputWriter()
+    : pendingBytes(0), isWriting(false), isStopped(false)
+{
+    thread = std::thread(&OutputWriter::Run, this);
+    isWriterRunning = true;
+}
+
+OutputWriter::~OutputWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isStopped = true;
+    }
+    hasWork.notify_one();
+    thread.join();
+    isWriterRunning = false;
+}
+
+void OutputWriter::Push(OutputBuffer &buffer)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    hasRoom.wait(lock, [this]
+                 { return pendingBytes < OUTPUT_MAX_PENDING; });
+
+    std::string text;
+    if (!spare.empty())
+    {
+        text.swap(spare.back());
+        spare.pop_back();
+    }
+    buffer.Swap(text);
+
+    pendingBytes += text.size();
+    pending.push_back(std::string());
+    pending.back().swap(text);
+    lock.unlock();
+
+    hasWork.notify_one();
+}
+
+void OutputWriter::Wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    hasRoom.wait(lock, [this]
+                 { return pending.empty() && !isWriting; });
+}
+
+void OutputWriter::Run()
+{
+    std::vector<std::string> batch;
+    std::string text;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        hasWork.wait(lock, [this]
+                     { return !pending.empty() || isStopped; });
+        if (pending.empty())
+            break;
+
+        batch.swap(pending);
+        pendingBytes = 0;
+        isWriting = true;
+        lock.unlock();
+        hasRoom.notify_all();
+
+        // Whole batch in a single write
+        text.clear();
+        for (size_t i = 0; i < batch.size(); i++)
+            text.append(batch[i]);
+        fwrite(text.data(), 1, text.size(), stdout);
+        fflush(stdout);
+
+        lock.lock();
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            batch[i].clear();
+            spare.push_back(std::string());
+            spare.back().swap(batch[i]);
+        }
+        batch.clear();
+        isWriting = false;
+        hasRoom.notify_all();
+    }
+}
+
+static OutputWriter &Writer()
+{
+    // Started on first use, drained and joined at exit
+    static OutputWriter writer;
+    return writer;
+}
+
+OutputBuffer &ThreadOutput()
+{
+    thread_local OutputBuffer buffer;
+    return buffer;
+}
+
+static thread_local std::string *outputCapture = NULL;
+
+void FlushOutput()
+{
+    OutputBuffer &buffer = ThreadOutput();
+    if (buffer.Data().empty())
+        return;
+
+    if (outputCapture)
+    {
+        outputCapture->append(buffer.Data());
+        buffer.Clear();
+        return;
+    }
+
+    if (!isAsyncOutput)
+    {
+        fwrite(buffer.Data().data(), 1, buffer.Data().size(), stdout);
+        fflush(stdout);
+        buffer.Clear();
+        return;
+    }
+
+    Writer().Push(buffer);
+}
+
+void WaitOutput()
+{
+    if (isWriterRunning)
+        Writer().Wait();
+}
+
+void SetAsyncOutput(bool isAsync)
+{
+    // Earlier output goes first
+    WaitOutput();
+    isAsyncOutput = isAsync;
+}
+
+void CaptureOutput(std::string *capture)
+{
+    outputCapture = capture;
+}
+
+// std::cout writes wait for the queued output first, so results and
+// direct std::cout output of the same thread stay in order
+class OrderedStdoutBuffer : public std::streambuf
+{
+private:
+    std::streambuf *original;
+
+protected:
+    int overflow(int c)
+    {
+        if (c == EOF)
+            return 0;
+        WaitOutput();
+        return fputc(c, stdout);
+    }
+    std::streamsize xsputn(const char *text, std::streamsize count)
+    {
+        WaitOutput();
+        return static_cast<std::streamsize>(fwrite(text, 1, count, stdout));
+    }
+    int sync()
+    {
+        return fflush(stdout);
+    }
+
+public:
+    OrderedStdoutBuffer()
+    {
+        original = std::cout.rdbuf(this);
+    }
+    ~OrderedStdoutBuffer()
+    {
+        // std::cout outlives this object
+        fflush(stdout);
+        std::cout.rdbuf(original);
+    }
+};
+
+static OrderedStdoutBuffer orderedStdout;
@@ -0,0 +1,49 @@
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+
+#include <string>
+
+// Text of the results is rendered into a reusable per-thread buffer and
+// handed to a background writer, which writes every batch of flushed
+// buffers to stdout at once. Buffers of different threads never
+// interleave within a flush. std::cout is redirected to wait for the
+// queued output, so direct std::cout writes keep their order.
+
+// Flushing blocks while this many bytes are waiting to be written
+#define OUTPUT_MAX_PENDING (4 * 1024 * 1024)
+
+class OutputBuffer
+{
+private:
+    std::string data;
+
+public:
+    void Append(const std::string &text);
+    void Append(const char *text);
+    void Append(char c);
+    // Right aligned in width characters, padded with fill (std::setw)
+    void AppendInt(int value, int width = 0, char fill = ' ');
+    // Same text as std::ostream's default float formatting
+    void AppendFloat(float value, int width = 0, char fill = ' ');
+    void AppendFormat(const char *format, ...);
+
+    const std::string &Data() const;
+    void Swap(std::string &other);
+    void Clear();
+};
+
+// Buffer of the calling thread
+OutputBuffer &ThreadOutput();
+
+// Queues the calling thread's buffer for writing and clears it
+void FlushOutput();
+// Blocks until everything flushed so far is written (before writing
+// to stdout through anything but std::cout, e.g. printf)
+void WaitOutput();
+// Synchronous mode writes on FlushOutput from the calling thread
+void SetAsyncOutput(bool isAsync);
+// Flushes of the calling thread append to capture instead of writing,
+// NULL writes again
+void CaptureOutput(std::string *capture);
+
+#endif // OUTPUT_WRITER_H
@@ -0,0 +1,103 @@
+#include "trace.h"
+#include "output_writer.h"
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+std::atomic<bool> isTracingOn(false);
+
+// Slots are claimed with one atomic increment, so threads record
+// without locking; reading while calls are traced may see a slot that
+// is being written
+static TraceEvent traceEvents[TRACE_BUFFER_EVENTS];
+static std::atomic<unsigned long long> traceEventCount(0);
+static std::atomic<int> traceThreadCount(0);
+
+static const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+void SetTracing(bool isOn)
+{
+    isTracingOn.store(isOn, std::memory_order_relaxed);
+}
+
+void ClearTrace()
+{
+    traceEventCount.store(0);
+}
+
+long long TraceClock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+void RecordTraceEvent(const char *name, long long start, long long duration)
+{
+    thread_local int threadId = traceThreadCount.fetch_add(1) + 1;
+
+    unsigned long long slot = traceEventCount.fetch_add(1, std::memory_order_relaxed);
+    TraceEvent &event = traceEvents[slot % TRACE_BUFFER_EVENTS];
+    event.name = name;
+    event.start = start;
+    event.duration = duration;
+    event.threadId = threadId;
+}
+
+void GetTraceEvents(std::vector<TraceEvent> &events)
+{
+    unsigned long long count = traceEventCount.load();
+    unsigned long long first = (count > TRACE_BUFFER_EVENTS) ? count - TRACE_BUFFER_EVENTS : 0;
+
+    events.clear();
+    events.reserve(static_cast<size_t>(count - first));
+    for (unsigned long long i = first; i < count; i++)
+        events.push_back(traceEvents[i % TRACE_BUFFER_EVENTS]);
+}
+
+bool WriteChromeTrace(const std::string &filePath)
+{
+    FILE *file = fopen(filePath.c_str(), "w");
+    if (!file)
+        return false;
+
+    std::vector<TraceEvent> events;
+    GetTraceEvents(events);
+
+    // Complete events ("X"), times in microseconds
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}%s\n",
+                events[i].name, events[i].start / 1000.0, events[i].duration / 1000.0,
+                events[i].threadId, (i + 1 < events.size()) ? "," : "");
+    }
+    fprintf(file, "],\"displayTimeUnit\":\"ns\"}\n");
+
+    bool isWritten = !ferror(file);
+    return fclose(file) == 0 && isWritten;
+}
+
+void PrintTraceSummary()
+{
+    std::vector<TraceEvent> events;
+    GetTraceEvents(events);
+
+    // Names are literals, equal names may still have other addresses
+    std::map<std::string, std::pair<long long, long long>> totals;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        std::pair<long long, long long> &total = totals[events[i].name];
+        total.first++;
+        total.second += events[i].duration;
+    }
+
+    OutputBuffer &out = ThreadOutput();
+    out.AppendFormat("%-28s %10s %12s %10s\n", "phase", "count", "total ms", "mean us");
+    std::map<std::string, std::pair<long long, long long>>::const_iterator it;
+    for (it = totals.begin(); it != totals.end(); ++it)
+    {
+        out.AppendFormat("%-28s %10lld %12.3f %10.2f\n", it->first.c_str(), it->second.first,
+                         it->second.second / 1e6, it->second.second / 1e3 / it->second.first);
+    }
+    FlushOutput();
+}
@@ -0,0 +1,89 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Scoped timings of the phases of a call. While tracing is on, every
+// TRACE_SCOPE records its name, start and duration into a ring buffer
+// of the last TRACE_BUFFER_EVENTS events; while it is off a scope costs
+// one relaxed load. Building with NO_TRACING removes the scopes.
+
+// Events kept, older ones are overwritten
+#define TRACE_BUFFER_EVENTS (64 * 1024)
+
+struct TraceEvent
+{
+    // String literal (names are stored, not copied)
+    const char *name;
+    // Nanoseconds since the trace clock started
+    long long start;
+    long long duration;
+    int threadId;
+};
+
+extern std::atomic<bool> isTracingOn;
+
+inline bool IsTracing()
+{
+    return isTracingOn.load(std::memory_order_relaxed);
+}
+
+void SetTracing(bool isOn);
+void ClearTrace();
+long long TraceClock();
+void RecordTraceEvent(const char *name, long long start, long long duration);
+
+// Copies the kept events, oldest first
+void GetTraceEvents(std::vector<TraceEvent> &events);
+// Chrome trace event JSON (chrome://tracing, Perfetto), false when the
+// file can not be written
+bool WriteChromeTrace(const std::string &filePath);
+// Count, total and mean duration of every name
+void PrintTraceSummary();
+
+class TraceScope
+{
+private:
+    const char *name;
+    long long start;
+
+public:
+    explicit TraceScope(const char *name)
+        : name(IsTracing() ? name : NULL), start(0)
+    {
+        if (this->name)
+            start = TraceClock();
+    }
+    ~TraceScope()
+    {
+        End();
+    }
+    // Records the scope before its end (once)
+    void End()
+    {
+        if (name)
+            RecordTraceEvent(name, start, TraceClock() - start);
+        name = NULL;
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+};
+
+// TRACE_SCOPE times the rest of the block, TRACE_PHASE up to the
+// TRACE_END of the same scope variable
+#ifdef NO_TRACING
+#define TRACE_SCOPE(name)
+#define TRACE_PHASE(scope, name)
+#define TRACE_END(scope)
+#else
+#define TRACE_NAME_JOIN(a, b) a##b
+#define TRACE_NAME(line) TRACE_NAME_JOIN(traceScope, line)
+#define TRACE_SCOPE(name) TraceScope TRACE_NAME(__LINE__)(name)
+#define TRACE_PHASE(scope, name) TraceScope scope(name)
+#define TRACE_END(scope) scope.End()
+#endif
+
+#endif // TRACE_H